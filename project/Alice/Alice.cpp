@@ -2,27 +2,399 @@
 #include <cstdlib>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
+#include <fcntl.h>
 #include <arpa/inet.h>
 #include <sodium.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <vector>
 #include "curve25519_donna.h"
+#include "curve25519_async.h"
+#include "curve25519_runtime.h"
+#include "curve25519_profile.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include "curve25519_probe.h"
+#include "curve25519_log.h"
+#include "curve25519_metrics.h"
+#include "curve25519_aead.h"
+#include "curve25519_bulk.h"
+#include "curve25519_stream.h"
+#include "curve25519_session.h"
+#include "curve25519_keypool.h"
+#include "curve25519_numa.h"
 
 #define MESSAGE_LEN 1024   //加密数据大小
 const uint8_t BASE_POINT[32] = {9};  //curve25519曲线上的基点x坐标
 
-int main()
+//进程启动至今的毫秒数
+//优先使用启动脚本写入的 CURVE25519_LAUNCH_NS(CLOCK_REALTIME纳秒), 否则读取/proc/self/stat中的启动时间
+static double ms_since_launch()
+{
+    struct timespec now;
+    if(const char *launch = getenv("CURVE25519_LAUNCH_NS")) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        return (now.tv_sec * 1e9 + now.tv_nsec - strtod(launch, nullptr)) / 1e6;
+    }
+    std::ifstream stat("/proc/self/stat");
+    std::string line;
+    std::getline(stat, line);
+    //进程名可能含空格, 从最后一个')'之后开始数, starttime是第22个字段
+    std::istringstream fields(line.substr(line.rfind(')') + 2));
+    std::string field;
+    for (int i = 3; i <= 22 && fields >> field; ++i) {}
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return (now.tv_sec + now.tv_nsec / 1e9 - strtod(field.c_str(), nullptr) / sysconf(_SC_CLK_TCK)) * 1e3;
+}
+
+//握手指标, 由指标端口以Prometheus文本格式抓取
+static int m_handshakes, m_failures, m_in_flight, m_keypool_empty;
+static int m_keygen, m_shared_secret, m_encrypt, m_handshake, m_bulk_encrypt, m_stream;
+
+static void register_metrics()
+{
+    m_handshakes = curve25519_metrics_counter("alice_handshakes_total", "Completed handshakes");
+    m_failures = curve25519_metrics_counter("alice_handshake_failures_total", "Handshakes aborted by an error");
+    m_in_flight = curve25519_metrics_gauge("alice_connections_in_flight", "Connections currently being served");
+    m_keypool_empty = curve25519_metrics_counter("alice_keypool_empty_total", "Connections that found the keypair pool empty");
+    m_keygen = curve25519_metrics_histogram("alice_keygen_seconds", "Ephemeral public key computation");
+    m_shared_secret = curve25519_metrics_histogram("alice_shared_secret_seconds", "Shared secret computation");
+    m_encrypt = curve25519_metrics_histogram("alice_encrypt_seconds", "crypto_box_easy_afternm");
+    m_handshake = curve25519_metrics_histogram("alice_handshake_seconds", "Accept to ciphertext sent");
+    m_bulk_encrypt = curve25519_metrics_histogram("alice_bulk_encrypt_seconds", "Chunked parallel payload encryption");
+    m_stream = curve25519_metrics_histogram("alice_stream_seconds", "Streaming encryption and send of a file");
+}
+
+//一个连接使用的临时密钥对, 公钥在等待连接期间计算
+struct client_keys {
+    uint8_t local_private_key[crypto_scalarmult_curve25519_SCALARBYTES];
+    uint8_t local_public_key[crypto_scalarmult_curve25519_BYTES];
+    std::future<int> keygen;
+    curve25519_perf_sample phase;
+    ~client_keys() { sodium_memzero(local_private_key, sizeof(local_private_key)); }
+};
+
+//一次握手中的共享密钥和由它派生的crypto_box密钥, 无论握手成功与否, 离开作用域时都擦除
+struct handshake_secrets {
+    curve25519_session_keys keys;
+    ~handshake_secrets() { sodium_memzero(&keys, sizeof(keys)); }
+};
+
+static std::once_flag first_handshake;
+
+//会话密钥缓存: 同一对公钥再次握手时跳过标量乘法
+//只在使用长期密钥时创建; 临时密钥的共享密钥不缓存, 握手结束即擦除, 以保持前向安全
+static curve25519_session_cache *sessions = nullptr;
+//长期密钥对, 通过CURVE25519_STATIC_KEY=私钥文件开启, 所有连接共用; 否则每个连接使用临时密钥对
+static bool static_key = false;
+static uint8_t static_private_key[crypto_scalarmult_curve25519_SCALARBYTES];
+static uint8_t static_public_key[crypto_scalarmult_curve25519_BYTES];
+//预先生成的临时密钥对, 接受连接后直接取出, 不在关键路径上计算公钥
+static curve25519_keypool *keypool = nullptr;
+
+//已就绪的keygen结果, 密钥对不需要再计算时使用
+static std::future<int> keygen_ready()
+{
+    std::promise<int> ready;
+    ready.set_value(0);
+    return ready.get_future();
+}
+
+//握手后发送的大数据, 启动时从文件读入, 为空表示不发送
+static std::vector<uint8_t> bulk_payload;
+static bool bulk_enabled = false;
+//流式模式发送的文件, 每个连接重新打开, 不整体读入内存
+static const char *stream_path = nullptr;
+
+//接收len字节, 对端提前断开或出错时返回-1
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+    while(len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return -1;
+        buf += n;
+        len -= size_t(n);
+    }
+    return 0;
+}
+
+//发送全部数据, 对端断开时返回-1而不是触发SIGPIPE
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+    while(len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return -1;
+        buf += n;
+        len -= size_t(n);
+    }
+    return 0;
+}
+
+//分块并行加密大数据并发送, 密钥由共享密钥派生, 成功返回0
+static int send_bulk(int cfd, const uint8_t *shared_secret)
+{
+    uint8_t key[CURVE25519_AEAD_KEYBYTES];
+    if(curve25519_aead_key(key, shared_secret) != 0) return -1;
+    std::vector<uint8_t> sealed(curve25519_bulk_sealed_len(bulk_payload.size(), 0));
+    uint64_t span = curve25519_trace_now();
+    int ret = curve25519_bulk_encrypt(nullptr, sealed.data(), bulk_payload.data(), bulk_payload.size(), 0, key);
+    sodium_memzero(key, sizeof(key));
+    if(ret != 0) {
+        curve25519_log(C25519_LOG_ERROR, "分块加密失败。");
+        return -1;
+    }
+    const uint64_t elapsed = curve25519_trace_now() - span;
+    curve25519_metrics_observe(m_bulk_encrypt, elapsed);
+    curve25519_trace_span("bulk_encrypt", "handshake", span);
+    curve25519_probe_phase("alice", "bulk_encrypt", span, bulk_payload.size());
+    curve25519_log(C25519_LOG_INFO, "分块加密{}字节: {}ms, {}MB/s", bulk_payload.size(), elapsed / 1e6,
+                   bulk_payload.size() * 1e3 / (elapsed > 0 ? elapsed : 1));
+
+    span = curve25519_trace_now();
+    if(send_all(cfd, sealed.data(), sealed.size()) != 0) {
+        curve25519_log(C25519_LOG_ERROR, "send: {}", strerror(errno));
+        return -1;
+    }
+    curve25519_trace_span("bulk_send", "handshake", span);
+    curve25519_probe_phase("alice", "bulk_send", span, sealed.size());
+    return 0;
+}
+
+//流式加密文件并边加密边发送, 内存占用只与帧长有关, 成功返回0
+static int send_stream(int cfd, const uint8_t *shared_secret)
+{
+    int fd = open(stream_path, O_RDONLY);
+    if(fd == -1) {
+        curve25519_log(C25519_LOG_ERROR, "打开文件失败: {}: {}", stream_path, strerror(errno));
+        return -1;
+    }
+    uint8_t key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if(curve25519_stream_key(key, shared_secret) != 0) {
+        close(fd);
+        return -1;
+    }
+    const uint64_t span = curve25519_trace_now();
+    uint64_t sent = 0;
+    int ret = curve25519_stream_encrypt_fd(fd, 0, key, [cfd](const uint8_t *buf, size_t len) {
+        return send_all(cfd, buf, len);
+    }, &sent);
+    sodium_memzero(key, sizeof(key));
+    close(fd);
+    if(ret != 0) {
+        curve25519_log(C25519_LOG_ERROR, "流式发送失败。");
+        return -1;
+    }
+    const uint64_t elapsed = curve25519_trace_now() - span;
+    curve25519_metrics_observe(m_stream, elapsed);
+    curve25519_trace_span("stream", "handshake", span);
+    curve25519_probe_phase("alice", "stream", span, sent);
+    curve25519_log(C25519_LOG_INFO, "流式发送{}字节: {}ms, {}MB/s", sent, elapsed / 1e6, sent * 1e3 / (elapsed > 0 ? elapsed : 1));
+    return 0;
+}
+
+//与一个客户端交换公钥、交换确认值确认共享密钥一致并发送加密信息, 成功返回0
+static int handshake(int cfd, client_keys *keys)
+{
+    uint8_t *local_public_key = keys->local_public_key;
+    uint8_t *local_private_key = keys->local_private_key;
+    uint8_t remote_public_key[crypto_scalarmult_curve25519_BYTES];
+    handshake_secrets secrets;
+    uint8_t *shared_secret1 = secrets.keys.shared;
+    uint8_t *box_key = secrets.keys.box;   //由共享密钥派生的crypto_box密钥
+    uint8_t confirm1[CURVE25519_CONFIRM_BYTES];   //Alice发出的确认值
+    uint8_t confirm2[CURVE25519_CONFIRM_BYTES];   //收到的Bob的确认值
+    uint8_t expect2[CURVE25519_CONFIRM_BYTES];    //按本端共享密钥算出的Bob的确认值
+    curve25519_perf_sample &phase = keys->phase;
+
+    //和客户端通信
+    uint64_t span = curve25519_trace_now();
+    if(keys->keygen.get()!=0){
+       curve25519_log(C25519_LOG_ERROR, "计算本地公钥失败");
+       return -1;
+    }
+    if (curve25519_perf_enabled()) curve25519_perf_record("alice_keygen", &phase, 1);
+    curve25519_trace_span("keygen", "handshake", span);
+    curve25519_probe_phase("alice", "keygen", span, crypto_scalarmult_curve25519_BYTES);
+    //打印密钥对, 私钥默认隐藏
+    curve25519_log(C25519_LOG_INFO, "Alice私钥: {}",
+                   curve25519_secret(local_private_key, crypto_scalarmult_curve25519_SCALARBYTES));
+    curve25519_log(C25519_LOG_INFO, "Alice公钥: {}", curve25519_hex(local_public_key, crypto_scalarmult_curve25519_BYTES));
+
+    //接收客户端数据
+    span = curve25519_trace_now();
+    if(recv_all(cfd, remote_public_key, sizeof(remote_public_key)) != 0)
+    {
+         curve25519_log(C25519_LOG_WARN, "接收Bob公钥失败, Bob端断开了连接...");
+         return -1;
+    }
+    curve25519_log(C25519_LOG_INFO, "Bob公钥: {}", curve25519_hex(remote_public_key, crypto_scalarmult_curve25519_BYTES));
+    if(send_all(cfd, local_public_key, crypto_scalarmult_curve25519_BYTES) != 0)   //发送公钥数据
+    {
+         curve25519_log(C25519_LOG_ERROR, "send: {}", strerror(errno));
+         return -1;
+    }
+    curve25519_trace_span("exchange", "handshake", span);
+    curve25519_probe_phase("alice", "exchange", span, 2 * crypto_scalarmult_curve25519_BYTES);
+
+    //计算共享密钥
+    span = curve25519_trace_now();
+    if (curve25519_perf_enabled()) curve25519_perf_read(&phase);
+    bool hit = false;
+    int ret;
+    if(sessions != nullptr) {
+       ret = curve25519_session_get(sessions, &secrets.keys, local_public_key, local_private_key, remote_public_key, &hit);
+    } else {
+       ret = curve25519_donna(shared_secret1, local_private_key, remote_public_key) != 0 ||
+             curve25519_box_beforenm(box_key, shared_secret1) != 0 ? -1 : 0;
+    }
+    if(ret!=0){
+       curve25519_log(C25519_LOG_ERROR, "计算共享密钥失败");
+       return -1;
+    }
+    if(hit) curve25519_log(C25519_LOG_DEBUG, "会话密钥缓存命中");
+    if (curve25519_perf_enabled()) curve25519_perf_record("alice_shared_secret", &phase, 1);
+    curve25519_metrics_observe(m_shared_secret, curve25519_trace_now() - span);
+    curve25519_trace_span("shared_secret", "handshake", span);
+    curve25519_probe_phase("alice", "shared_secret", span, crypto_scalarmult_curve25519_BYTES);
+    // 打印共享密钥
+    curve25519_log(C25519_LOG_INFO, "共享密钥: {}", curve25519_secret(shared_secret1, crypto_scalarmult_curve25519_BYTES));
+    //只交换由共享密钥和双方公钥算出的确认值, 共享密钥不出现在网络上
+    span = curve25519_trace_now();
+    curve25519_session_confirm(confirm1, shared_secret1, local_public_key, remote_public_key, true);
+    curve25519_session_confirm(expect2, shared_secret1, local_public_key, remote_public_key, false);
+    if(recv_all(cfd, confirm2, sizeof(confirm2)) != 0)
+    {
+         curve25519_log(C25519_LOG_WARN, "接收确认值失败, Bob端断开了连接...");
+         return -1;
+    }
+    //比较Bob的确认值
+    if (sodium_memcmp(confirm2, expect2, sizeof(confirm2)) != 0) {
+         curve25519_log(C25519_LOG_ERROR, "共享密钥不匹配。");
+         return -1;
+    }
+    curve25519_log(C25519_LOG_INFO, "共享密钥匹配");
+    std::call_once(first_handshake, [] {
+        curve25519_log(C25519_LOG_INFO, "进程启动到首次握手完成: {}ms", ms_since_launch());
+        if (curve25519_profile_enabled()) curve25519_profile_dump(stderr);
+    });
+    if(send_all(cfd, confirm1, sizeof(confirm1)) != 0)   //发送确认值
+    {
+         curve25519_log(C25519_LOG_ERROR, "send: {}", strerror(errno));
+         return -1;
+    }
+     curve25519_trace_span("confirm", "handshake", span);
+     curve25519_probe_phase("alice", "confirm", span, 2 * CURVE25519_CONFIRM_BYTES);
+
+     //随机生成一个nonce
+     uint8_t nonce[crypto_box_NONCEBYTES];
+     randombytes_buf(nonce, sizeof nonce);
+
+     unsigned char message[MESSAGE_LEN] = "hello Welcome to DPC++!";  //加密信息
+     unsigned char cipher_text[MESSAGE_LEN + crypto_box_MACBYTES];   //储存加密后的信息		
+     curve25519_log(C25519_LOG_INFO, "加密的message: {}", reinterpret_cast<const char*>(message));
+     
+     span = curve25519_trace_now();
+     if (curve25519_perf_enabled()) curve25519_perf_read(&phase);
+     if(crypto_box_easy_afternm(cipher_text, message, sizeof(message), nonce, box_key)!=0){
+        curve25519_log(C25519_LOG_ERROR, "加密信息失败。");
+        return -1;
+     }
+     if (curve25519_perf_enabled()) curve25519_perf_record("alice_encrypt", &phase, 1);
+     curve25519_metrics_observe(m_encrypt, curve25519_trace_now() - span);
+     curve25519_trace_span("encrypt", "handshake", span);
+     curve25519_probe_phase("alice", "encrypt", span, sizeof(message));
+     //发送数据
+     span = curve25519_trace_now();
+     if(send_all(cfd, cipher_text, sizeof(cipher_text)) != 0 || send_all(cfd, nonce, sizeof(nonce)) != 0) {
+        curve25519_log(C25519_LOG_ERROR, "send: {}", strerror(errno));
+        return -1;
+     }
+     curve25519_trace_span("send", "handshake", span);
+     curve25519_probe_phase("alice", "send", span, sizeof(cipher_text) + sizeof(nonce));
+     
+     curve25519_log(C25519_LOG_DEBUG, "加密后的message: {}", curve25519_hex(cipher_text, sizeof(cipher_text)));
+     //大数据模式: Bob也需要指定输出文件
+     if(bulk_enabled && send_bulk(cfd, box_key) != 0) return -1;
+     if(stream_path != nullptr && send_stream(cfd, box_key) != 0) return -1;
+     return 0;
+}
+
+//用法: Alice [服务的连接数, 0表示一直运行] [指标端口, 0表示关闭] [握手后分块加密发送的文件] [stream: 改为流式发送]
+int main(int argc, char *argv[])
 {     
+    int connections = argc > 1 ? atoi(argv[1]) : 1;
+    int metrics_port = argc > 2 ? atoi(argv[2]) : 10001;
     //初始化libsodium
     if(sodium_init() != 0) {
-      std::cerr << "初始化libsodium失败" << std::endl;
+      curve25519_log(C25519_LOG_ERROR, "初始化libsodium失败");
       return -1;
     }
+    if(argc > 4 && strcmp(argv[4], "stream") == 0) {
+      stream_path = argv[3];
+      curve25519_log(C25519_LOG_INFO, "握手后流式发送文件: {}", stream_path);
+    } else if(argc > 3) {
+      std::ifstream file(argv[3], std::ios::binary);
+      if(!file) {
+        curve25519_log(C25519_LOG_ERROR, "打开文件失败: {}", argv[3]);
+        return -1;
+      }
+      bulk_payload.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      if(bulk_payload.size() > CURVE25519_BULK_MAX_LENGTH) {
+        curve25519_log(C25519_LOG_ERROR, "文件超过{}字节, 请改用stream模式: {}", CURVE25519_BULK_MAX_LENGTH, argv[3]);
+        return -1;
+      }
+      bulk_enabled = true;
+      curve25519_log(C25519_LOG_INFO, "握手后发送文件: {}, {}字节", argv[3], bulk_payload.size());
+    }
+    //开始监听前构建全部内核, 首次握手不再等待运行时初始化和即时编译
+    double warm = curve25519_prewarm();
+    if(warm < 0) {
+      curve25519_log(C25519_LOG_ERROR, "预热SYCL内核失败");
+      return -1;
+    }
+    curve25519_log(C25519_LOG_INFO, "预热SYCL内核耗时: {}ms", warm);
+    curve25519_profile_reset();   //内核剖析只统计握手过程
+    //CURVE25519_NUMA=affinity按NUMA亲和域划分CPU设备, =份数时均分; 之后批量标量乘法(如密钥对池补充)在本地子设备上执行
+    if(const char *numa_env = getenv("CURVE25519_NUMA")) {
+      const bool affinity = strcmp(numa_env, "affinity") == 0;
+      const size_t parts = affinity ? 2 : strtoul(numa_env, nullptr, 10);
+      const int domains = curve25519_numa_init(affinity ? NUMA_PARTITION_AFFINITY : NUMA_PARTITION_EQUALLY, parts, 16 << 20);
+      if(domains < 0) {
+        curve25519_log(C25519_LOG_ERROR, "划分NUMA子设备失败: {}", numa_env);
+        return -1;
+      }
+      curve25519_log(C25519_LOG_INFO, "NUMA子设备: {}个", domains);
+    }
+    if(const char *key_path = getenv("CURVE25519_STATIC_KEY")) {
+      if(curve25519_session_load_key(key_path, static_private_key) != 0 ||
+         curve25519_donna(static_public_key, static_private_key, BASE_POINT) != 0) {
+        sodium_memzero(static_private_key, sizeof(static_private_key));
+        curve25519_log(C25519_LOG_ERROR, "加载长期密钥失败: {}", key_path);
+        return -1;
+      }
+      static_key = true;
+    }
+    if(static_key) sessions = curve25519_session_cache_create(4096, 0);
+    //临时密钥对池的容量, 通过CURVE25519_KEYPOOL设置, 0表示每个连接单独计算
+    const char *keypool_env = getenv("CURVE25519_KEYPOOL");
+    const size_t keypool_size = keypool_env != nullptr ? strtoul(keypool_env, nullptr, 10) : 64;
+    if(!static_key && keypool_size > 0) keypool = curve25519_keypool_create(keypool_size, 0);
    
     //创建监听的套接字
     int lfd = socket(AF_INET, SOCK_STREAM, 0); //支持IPv4协议、面向流（TCP）传输的套接字
     if(lfd == -1)
     {
-        perror("socket");
+        curve25519_log(C25519_LOG_ERROR, "socket: {}", strerror(errno));
         exit(0);
     }
 
@@ -32,128 +404,111 @@ int main()
     saddr.sin_port = htons(10000);     //端口，将主机字节序的端口号转换为网络字节序
     //INADDR_ANY宏的值为0 == 0.0.0.0,可以代表任意一个IP地址，自动寻找符合IP地址绑定
     saddr.sin_addr.s_addr = INADDR_ANY;  
+    int on = 1;   //重启时不必等待上一次运行遗留的TIME_WAIT连接超时
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
     int ret = bind(lfd, reinterpret_cast<struct sockaddr*>(&saddr), sizeof(saddr));
     if(ret == -1)
     {
-        perror("bind");
+        curve25519_log(C25519_LOG_ERROR, "bind: {}", strerror(errno));
         exit(0);
     }
     //设置套接字为监听状态，以便接受客户端的连接请求
     ret = listen(lfd, 128);
     if(ret == -1)
     {
-        perror("listen");
-        exit(0);
-    }
-    //阻塞等待并接受客户端连接
-    struct sockaddr_in cliaddr;        //传出参数
-    socklen_t clilen = sizeof(cliaddr);
-    int cfd = accept(lfd, reinterpret_cast<struct sockaddr*>(&cliaddr), &clilen); 
-    if(cfd == -1)
-    {
-        perror("accept");
+        curve25519_log(C25519_LOG_ERROR, "listen: {}", strerror(errno));
         exit(0);
     }
-    //打印客户端的地址信息
-    char ip[24] = {0};
-    printf("客户端的IP地址: %s, 端口: %d\n",
-           inet_ntop(AF_INET, &cliaddr.sin_addr.s_addr, ip, sizeof(ip)),   //将IP地址转换为点分十进制格式
-           ntohs(cliaddr.sin_port));              //将网络字节序的端口号转换为主机字节序的端口号
 
-    //和客户端通信
-    uint8_t local_public_key[crypto_scalarmult_curve25519_BYTES];
-    uint8_t remote_public_key[crypto_scalarmult_curve25519_BYTES];
-    uint8_t local_private_key[crypto_scalarmult_curve25519_SCALARBYTES];
-    uint8_t shared_secret1[crypto_scalarmult_curve25519_BYTES];
-    uint8_t shared_secret2[crypto_scalarmult_curve25519_BYTES];
-    randombytes_buf(local_private_key, sizeof(local_private_key));    //随机生成私钥
-
-    if(curve25519_donna(local_public_key,local_private_key,BASE_POINT)!=0){
-       std::cerr << "计算本地公钥失败" << std::endl;
-       return -1;
-    }
-    //打印密钥对
-    std::cout << "Alice私钥: ";
-    for (size_t i = 0; i < crypto_scalarmult_curve25519_SCALARBYTES; ++i) {
-      std::printf("%02x", local_private_key[i]);
+    register_metrics();
+    if(metrics_port > 0 && curve25519_metrics_serve(metrics_port) == 0) {
+      curve25519_log(C25519_LOG_INFO, "指标地址: http://127.0.0.1:{}/metrics", metrics_port);
     }
-    std::cout << std::endl;
-    std::cout << "Alice公钥: ";
-    for (size_t i = 0; i < crypto_scalarmult_curve25519_BYTES; ++i) {
-      std::printf("%02x", local_public_key[i]);
-    }
-    std::cout << std::endl;
 
-    //接收客户端数据
-    int len = recv(cfd, remote_public_key, sizeof(remote_public_key),0);
-    if(len > 0)
+    std::vector<std::thread> workers;
+    for(int served = 0; connections == 0 || served < connections; ++served)
     {
-        std::cout << "Bob公钥: ";
-        for (size_t i = 0; i < crypto_scalarmult_curve25519_BYTES; ++i) {
-           std::printf("%02x", remote_public_key[i]);
+        auto keys = std::make_unique<client_keys>();
+        //握手各阶段的硬件计数, 通过CURVE25519_PERF=1开启, 退出时输出
+        if (curve25519_perf_enabled()) curve25519_perf_read(&keys->phase);
+        if(static_key) {
+            memcpy(keys->local_private_key, static_private_key, sizeof(static_private_key));
+            memcpy(keys->local_public_key, static_public_key, sizeof(static_public_key));
+            keys->keygen = keygen_ready();
+        } else if(keypool != nullptr &&
+                  curve25519_keypool_pop(keypool, keys->local_private_key, keys->local_public_key) == 0) {
+            keys->keygen = keygen_ready();
+        } else {
+            if(keypool != nullptr) curve25519_metrics_add(m_keypool_empty, 1);
+            randombytes_buf(keys->local_private_key, sizeof(keys->local_private_key));    //随机生成私钥
+            //计算公钥的内核提交后立即返回, 与等待连接并行进行; 完成回调里记录计算耗时
+            const uint64_t keygen_begin = curve25519_trace_now();
+            keys->keygen = curve25519_donna_async(keys->local_public_key, keys->local_private_key, BASE_POINT,
+                                                  [keygen_begin](int ret) {
+                if (ret == 0) curve25519_metrics_observe(m_keygen, curve25519_trace_now() - keygen_begin);
+            });
         }
-        std::cout << std::endl;
-        send(cfd, local_public_key, crypto_scalarmult_curve25519_BYTES,0);   //发送公钥数据
-    }
-    else if(len  == 0)
-    {
-         printf("Bob端断开了连接...\n");
-    }
-     else { perror("read"); }
 
-    //计算共享密钥
-    if(curve25519_donna(shared_secret1,local_private_key,remote_public_key)!=0){
-       std::cerr << "计算本地公钥失败" << std::endl;
-       return -1;
+        //阻塞等待并接受客户端连接
+        //握手各阶段的时间线, 通过CURVE25519_TRACE=文件名开启
+        uint64_t span = curve25519_trace_now();
+        struct sockaddr_in cliaddr;        //传出参数
+        socklen_t clilen = sizeof(cliaddr);
+        int cfd = accept(lfd, reinterpret_cast<struct sockaddr*>(&cliaddr), &clilen); 
+        if(cfd == -1)
+        {
+            curve25519_log(C25519_LOG_ERROR, "accept: {}", strerror(errno));
+            keys->keygen.wait();   //回调引用的密钥对在计算完成前不能释放
+            break;
+        }
+        curve25519_trace_span("accept", "handshake", span);
+        curve25519_probe_phase("alice", "accept", span, 0);
+        //打印客户端的地址信息
+        char ip[24] = {0};
+        curve25519_log(C25519_LOG_INFO, "客户端的IP地址: {}, 端口: {}",
+                       inet_ntop(AF_INET, &cliaddr.sin_addr.s_addr, ip, sizeof(ip)),   //将IP地址转换为点分十进制格式
+                       ntohs(cliaddr.sin_port));              //将网络字节序的端口号转换为主机字节序的端口号
+
+        //每个连接一个线程, 慢客户端不阻塞后续连接
+        curve25519_metrics_add(m_in_flight, 1);
+        std::thread worker([cfd, keys = std::move(keys)] {
+            const uint64_t begin = curve25519_trace_now();
+            if(handshake(cfd, keys.get()) == 0) {
+                curve25519_metrics_observe(m_handshake, curve25519_trace_now() - begin);
+                curve25519_probe_phase("alice", "handshake", begin, 0);
+                curve25519_metrics_add(m_handshakes, 1);
+            } else {
+                curve25519_metrics_add(m_failures, 1);
+            }
+            close(cfd);
+            curve25519_metrics_add(m_in_flight, -1);
+        });
+        if(connections == 0) {
+            worker.detach();
+        } else {
+            workers.push_back(std::move(worker));
+        }
     }
-    // 打印共享密钥
-    std::cout << "共享密钥: ";
-    for (size_t i = 0; i < crypto_scalarmult_curve25519_BYTES; ++i) {
-         std::printf("%02x", shared_secret1[i]);
+    for(std::thread &t : workers) t.join();
+    curve25519_log(C25519_LOG_INFO, "握手耗时 p50: {}ms, p99: {}ms", curve25519_metrics_quantile(m_handshake, 0.5) / 1e6,
+                   curve25519_metrics_quantile(m_handshake, 0.99) / 1e6);
+    if(sessions != nullptr) {
+      curve25519_session_stats session_stats;
+      curve25519_session_cache_stats(sessions, &session_stats);
+      curve25519_log(C25519_LOG_INFO, "会话密钥缓存 命中: {}, 未命中: {}, 淘汰: {}", session_stats.hits, session_stats.misses,
+                     session_stats.evictions);
+      curve25519_session_cache_destroy(sessions);
+      sodium_memzero(static_private_key, sizeof(static_private_key));
     }
-    std::cout << std::endl;
-    //接收客户端数据
-    len = recv(cfd, shared_secret2, sizeof(shared_secret2),0);
-    if(len > 0)
-    {
-        //比较两个共享密钥是否相同
-        if (memcmp(shared_secret1, shared_secret2, crypto_scalarmult_curve25519_BYTES)!= 0) {
-             std::cerr << "共享密钥不匹配。" << std::endl;
-             return -1;
-         }else {
-            std::cout<<"共享密钥匹配"<<std::endl;
-         }
-        send(cfd, shared_secret1, crypto_scalarmult_curve25519_BYTES,0); //发送共享密钥
-    }
-    else if(len  == 0)
-    {
-         printf("Bob端断开了连接...\n");
+    if(keypool != nullptr) {
+      curve25519_keypool_stats keypool_stats;
+      curve25519_keypool_get_stats(keypool, &keypool_stats);
+      curve25519_log(C25519_LOG_INFO, "临时密钥对池 取出: {}, 池为空: {}, 生成批次: {}", keypool_stats.popped,
+                     keypool_stats.empty, keypool_stats.batches);
+      curve25519_keypool_destroy(keypool);
     }
-     else { perror("read"); }
-
-     //随机生成一个nonce
-     uint8_t nonce[crypto_box_NONCEBYTES];
-     randombytes_buf(nonce, sizeof(crypto_box_NONCEBYTES));
-
-     unsigned char message[MESSAGE_LEN] = "hello Welcome to DPC++!";  //加密信息
-     unsigned char cipher_text[MESSAGE_LEN + crypto_box_MACBYTES];   //储存加密后的信息		
-     std::cout << "加密的message: " << message << std::endl;
-     
-     if(crypto_box_easy_afternm(cipher_text, message, sizeof(message), nonce, shared_secret1)!=0){
-        std::cerr << "加密信息失败。" << std::endl;
-        return -1;
-     }
-     //发送数据
-     send(cfd, cipher_text,MESSAGE_LEN + crypto_box_MACBYTES,0);
-     send(cfd, nonce,crypto_box_NONCEBYTES,0);
-     
-     std::cout << "加密后的message: ";
-     for (int i = 0; i < sizeof(cipher_text); i++) {
-       std::cout << std::hex << static_cast<int>(cipher_text[i]);
-     }
-     std::cout << std::endl;
+    curve25519_numa_release();
     //关闭套接字 
-    close(cfd);
     close(lfd);
     return 0;
 }
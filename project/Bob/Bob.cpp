@@ -2,25 +2,193 @@
 #include <cstdlib>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
+#include <fcntl.h>
 #include <arpa/inet.h>
 #include <iostream>
+#include <vector>
 #include <sodium.h>
 #include "curve25519_donna.h"
+#include "curve25519_async.h"
+#include "curve25519_trace.h"
+#include "curve25519_probe.h"
+#include "curve25519_log.h"
+#include "curve25519_aead.h"
+#include "curve25519_bulk.h"
+#include "curve25519_stream.h"
+#include "curve25519_session.h"
 
 #define MESSAGE_LEN 1024
 const uint8_t BASE_POINT[32] = {9};  //curve25519曲线上的基点x坐标
 
-int main()
+//Bob的私钥、共享密钥和由它派生的crypto_box密钥, 无论从哪里返回, 离开作用域时都擦除
+struct handshake_secrets {
+    uint8_t private_key[crypto_scalarmult_curve25519_SCALARBYTES];
+    curve25519_session_keys keys;
+    ~handshake_secrets() {
+        sodium_memzero(private_key, sizeof(private_key));
+        sodium_memzero(&keys, sizeof(keys));
+    }
+};
+
+//接收len字节, 对端提前断开时返回-1
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+    while(len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return -1;
+        buf += n;
+        len -= size_t(n);
+    }
+    return 0;
+}
+
+//发送全部数据, 对端断开时返回-1而不是触发SIGPIPE
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+    while(len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return -1;
+        buf += n;
+        len -= size_t(n);
+    }
+    return 0;
+}
+
+//接收分块加密的大数据, 并行解密后按顺序写入path, 成功返回0
+static int recv_bulk(int fd, const uint8_t *shared_secret, const char *path)
+{
+    uint64_t span = curve25519_trace_now();
+    std::vector<uint8_t> sealed(CURVE25519_BULK_HEADER_BYTES);
+    curve25519_bulk_header header;
+    size_t total;
+    if(recv_all(fd, sealed.data(), sealed.size()) != 0 ||
+       curve25519_bulk_parse_header(&header, &total, sealed.data(), sealed.size()) != 0) {
+        curve25519_log(C25519_LOG_ERROR, "接收分块数据头部失败");
+        return -1;
+    }
+    //头部尚未验证, 先检查长度再按它分配内存
+    if(header.length > CURVE25519_BULK_MAX_LENGTH) {
+        curve25519_log(C25519_LOG_ERROR, "分块数据长度{}超过上限{}, 请改用stream模式", header.length,
+                       CURVE25519_BULK_MAX_LENGTH);
+        return -1;
+    }
+    sealed.resize(total);
+    if(recv_all(fd, sealed.data() + CURVE25519_BULK_HEADER_BYTES, total - CURVE25519_BULK_HEADER_BYTES) != 0) {
+        curve25519_log(C25519_LOG_ERROR, "传输失败");
+        return -1;
+    }
+    curve25519_trace_span("bulk_receive", "handshake", span);
+    curve25519_probe_phase("bob", "bulk_receive", span, total);
+
+    span = curve25519_trace_now();
+    uint8_t key[CURVE25519_AEAD_KEYBYTES];
+    if(curve25519_aead_key(key, shared_secret) != 0) return -1;
+    std::vector<uint8_t> plain(header.length);
+    size_t plain_len = 0;
+    int ret = curve25519_bulk_decrypt(nullptr, plain.data(), &plain_len, sealed.data(), sealed.size(), key);
+    sodium_memzero(key, sizeof(key));
+    if(ret != 0) {
+        curve25519_log(C25519_LOG_ERROR, "分块解密失败。");
+        return -1;
+    }
+    const uint64_t elapsed = curve25519_trace_now() - span;
+    curve25519_trace_span("bulk_decrypt", "handshake", span);
+    curve25519_probe_phase("bob", "bulk_decrypt", span, plain_len);
+    curve25519_log(C25519_LOG_INFO, "分块解密{}字节({}块): {}ms, {}MB/s", plain_len, header.count, elapsed / 1e6,
+                   plain_len * 1e3 / (elapsed > 0 ? elapsed : 1));
+
+    FILE *out = fopen(path, "wb");
+    if(out == nullptr || fwrite(plain.data(), 1, plain_len, out) != plain_len) {
+        curve25519_log(C25519_LOG_ERROR, "写入文件失败: {}", path);
+        if(out != nullptr) fclose(out);
+        return -1;
+    }
+    fclose(out);
+    return 0;
+}
+
+//逐帧接收并解密流式数据, 边解密边写入path("-"表示标准输出), 失败时删除不完整的文件, 成功返回0
+static int recv_stream(int fd, const uint8_t *shared_secret, const char *path)
+{
+    const bool to_stdout = strcmp(path, "-") == 0;
+    int out = to_stdout ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out == -1) {
+        curve25519_log(C25519_LOG_ERROR, "打开文件失败: {}: {}", path, strerror(errno));
+        return -1;
+    }
+    uint8_t key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    if(curve25519_stream_key(key, shared_secret) != 0) {
+        if(!to_stdout) close(out);
+        return -1;
+    }
+    const uint64_t span = curve25519_trace_now();
+    uint64_t received = 0;
+    int ret = curve25519_stream_decrypt([fd](uint8_t *buf, size_t len) { return recv_all(fd, buf, len); }, key,
+                                        [out](const uint8_t *buf, size_t len) {
+        while(len > 0) {
+            ssize_t n = write(out, buf, len);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return -1;
+            buf += n;
+            len -= size_t(n);
+        }
+        return 0;
+    }, &received);
+    sodium_memzero(key, sizeof(key));
+    if(!to_stdout) close(out);
+    if(ret != 0) {
+        curve25519_log(C25519_LOG_ERROR, "流式解密失败。");
+        if(!to_stdout) unlink(path);
+        return -1;
+    }
+    const uint64_t elapsed = curve25519_trace_now() - span;
+    curve25519_trace_span("stream", "handshake", span);
+    curve25519_probe_phase("bob", "stream", span, received);
+    curve25519_log(C25519_LOG_INFO, "流式接收{}字节: {}ms, {}MB/s", received, elapsed / 1e6,
+                   received * 1e3 / (elapsed > 0 ? elapsed : 1));
+    return 0;
+}
+
+//用法: Bob [Alice的IP地址] [连接重试次数] [握手后接收的大数据写入的文件] [stream: 改为流式接收]
+int main(int argc, char *argv[])
 {    
+    const char *server_ip = argc > 1 ? argv[1] : "172.17.139.170";
+    int retries = argc > 2 ? atoi(argv[2]) : 0;   //Alice尚未开始监听时每10ms重试一次
+    const char *bulk_path = argc > 3 ? argv[3] : nullptr;   //Alice也需要指定发送的文件
+    const bool stream = argc > 4 && strcmp(argv[4], "stream") == 0;   //与Alice的模式一致
     //初始化libsodium
     if (sodium_init() != 0) {
-      std::cerr << "初始化libsodium失败" << std::endl;
+      curve25519_log(C25519_LOG_ERROR, "初始化libsodium失败");
     }
+    uint8_t remote_public_key[crypto_scalarmult_curve25519_BYTES];
+    uint8_t local_public_key[crypto_scalarmult_curve25519_BYTES];
+    handshake_secrets secrets;
+    uint8_t *remote_private_key = secrets.private_key;
+    uint8_t *shared_secret2 = secrets.keys.shared;
+    uint8_t confirm1[CURVE25519_CONFIRM_BYTES];   //收到的Alice的确认值
+    uint8_t confirm2[CURVE25519_CONFIRM_BYTES];   //Bob发出的确认值
+    uint8_t expect1[CURVE25519_CONFIRM_BYTES];    //按本端共享密钥算出的Alice的确认值
+    uint8_t *box_key = secrets.keys.box;   //由共享密钥派生的crypto_box密钥
+    //CURVE25519_STATIC_KEY=私钥文件时重连使用同一私钥, Alice的会话密钥缓存可以命中
+    if(const char *key_path = getenv("CURVE25519_STATIC_KEY")) {
+      if(curve25519_session_load_key(key_path, remote_private_key) != 0) {
+        curve25519_log(C25519_LOG_ERROR, "加载长期密钥失败: {}", key_path);
+        return -1;
+      }
+    } else {
+      randombytes_buf(remote_private_key, sizeof secrets.private_key);  //随机私钥
+    }
+    //计算公钥的内核提交后立即返回, 与建立连接并行进行
+    std::future<int> keygen = curve25519_donna_async(remote_public_key,remote_private_key,BASE_POINT);
+
     //创建通信的套接字
     int fd = socket(AF_INET, SOCK_STREAM, 0);  //ipv4 ; TCP协议
     if(fd == -1)
     {
-       perror("socket");
+       curve25519_log(C25519_LOG_ERROR, "socket: {}", strerror(errno));
        exit(0);
     }
 
@@ -28,100 +196,119 @@ int main()
     struct sockaddr_in addr;
     addr.sin_family = AF_INET;
     addr.sin_port = htons(10000);    //大端端口
-    inet_pton(AF_INET, "172.17.139.170", &addr.sin_addr.s_addr);  //将ipv4地址转换成大端序
+    inet_pton(AF_INET, server_ip, &addr.sin_addr.s_addr);  //将ipv4地址转换成大端序
     //向指定的服务器地址和端口号发起连接请求。
+    //握手各阶段的时间线, 通过CURVE25519_TRACE=文件名开启
+    uint64_t span = curve25519_trace_now();
     int ret = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    while(ret == -1 && errno == ECONNREFUSED && retries-- > 0)
+    {
+        usleep(10000);
+        close(fd);    //连接失败后套接字状态不确定, 重新创建
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        ret = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    }
     if(ret == -1)
     {
-        perror("connect");
+        curve25519_log(C25519_LOG_ERROR, "connect: {}", strerror(errno));
         exit(0);
     }
-    
-    uint8_t remote_public_key[crypto_scalarmult_curve25519_BYTES];
-    uint8_t local_public_key[crypto_scalarmult_curve25519_BYTES];
-    uint8_t remote_private_key[crypto_scalarmult_curve25519_SCALARBYTES];
-    uint8_t shared_secret2[crypto_scalarmult_curve25519_BYTES];
-    uint8_t shared_secret1[crypto_scalarmult_curve25519_BYTES];
-    randombytes_buf(remote_private_key, sizeof remote_private_key);  //随机私钥
+    curve25519_trace_span("connect", "handshake", span);
+    curve25519_probe_phase("bob", "connect", span, 0);
 
-    if(curve25519_donna(remote_public_key,remote_private_key,BASE_POINT)!=0){
-       std::cerr << "计算本地公钥失败" << std::endl;
+    span = curve25519_trace_now();
+    if(keygen.get()!=0){
+       curve25519_log(C25519_LOG_ERROR, "计算本地公钥失败");
        return -1;
     }
+    curve25519_trace_span("keygen", "handshake", span);
+    curve25519_probe_phase("bob", "keygen", span, crypto_scalarmult_curve25519_BYTES);
    
-    std::cout << "Bob私钥: ";
-    for (size_t i = 0; i < crypto_scalarmult_curve25519_SCALARBYTES; ++i) {
-      std::printf("%02x", remote_private_key[i]);
-    }
-    std::cout << std::endl;
-    std::cout << "Bob公钥: ";
-    for (size_t i = 0; i < crypto_scalarmult_curve25519_BYTES; ++i) {
-      std::printf("%02x", remote_public_key[i]);
-    }
-    std::cout << std::endl;
+    //私钥默认隐藏
+    curve25519_log(C25519_LOG_INFO, "Bob私钥: {}",
+                   curve25519_secret(remote_private_key, crypto_scalarmult_curve25519_SCALARBYTES));
+    curve25519_log(C25519_LOG_INFO, "Bob公钥: {}", curve25519_hex(remote_public_key, crypto_scalarmult_curve25519_BYTES));
     //和服务器端通信
       //向Alice发送公钥数据
-      send(fd, remote_public_key, crypto_scalarmult_curve25519_BYTES,0);
+      span = curve25519_trace_now();
+      if(send_all(fd, remote_public_key, crypto_scalarmult_curve25519_BYTES) != 0){
+        curve25519_log(C25519_LOG_ERROR, "send: {}", strerror(errno));
+        close(fd);
+        return -1;
+      }
         
       //接收服务器公钥数据
-      int len = recv(fd, local_public_key, sizeof(local_public_key),0);
-      if(len > 0){   
-          std::cout <<"Alice公钥: ";
-          for(size_t i = 0; i < crypto_scalarmult_curve25519_BYTES; ++i) {
-              std::printf("%02x", local_public_key[i]);
-          }
-          std::cout << std::endl;
-      }
-      else if(len  == 0)
-      {
-        printf("Alice端断开了连接...\n");
+      if(recv_all(fd, local_public_key, sizeof(local_public_key)) != 0){
+        curve25519_log(C25519_LOG_WARN, "接收Alice公钥失败, Alice端断开了连接...");
+        close(fd);
+        return -1;
       }
-      else { perror("recv");}
+      curve25519_log(C25519_LOG_INFO, "Alice公钥: {}", curve25519_hex(local_public_key, crypto_scalarmult_curve25519_BYTES));
+      curve25519_trace_span("exchange", "handshake", span);
+      curve25519_probe_phase("bob", "exchange", span, 2 * crypto_scalarmult_curve25519_BYTES);
 
     //计算共享密钥
-    if(curve25519_donna(shared_secret2,remote_private_key,local_public_key)!=0){
-       std::cerr << "计算远程公钥失败" << std::endl;
+    span = curve25519_trace_now();
+    if(curve25519_donna(shared_secret2,remote_private_key,local_public_key)!=0 ||
+       curve25519_box_beforenm(box_key, shared_secret2)!=0){
+       curve25519_log(C25519_LOG_ERROR, "计算共享密钥失败");
        return -1;
     }
+    curve25519_trace_span("shared_secret", "handshake", span);
+    curve25519_probe_phase("bob", "shared_secret", span, crypto_scalarmult_curve25519_BYTES);
     //打印共享密钥
-    std::cout << "共享密钥: ";
-    for (size_t i = 0; i < crypto_scalarmult_curve25519_BYTES; ++i) {
-         std::printf("%02x", shared_secret2[i]);
-    }
-    std::cout << std::endl;
-      //发送共享密钥
-      send(fd, shared_secret2, crypto_scalarmult_curve25519_BYTES,0);  
-      //接收共享密钥
-      len = recv(fd, shared_secret1, sizeof(shared_secret1),0);
-      if(len > 0)
-      {   
-        // 比较两个共享密钥是否相同
-        if (memcmp(shared_secret1, shared_secret2, crypto_scalarmult_curve25519_BYTES)!= 0) {
-             std::cerr << "共享密钥不匹配。" << std::endl;
-             return -1;
-         }else {
-             std::cout<<"共享密钥匹配"<<std::endl;
-         }
+    curve25519_log(C25519_LOG_INFO, "共享密钥: {}", curve25519_secret(shared_secret2, crypto_scalarmult_curve25519_BYTES));
+      //发送确认值, 共享密钥不出现在网络上
+      span = curve25519_trace_now();
+      curve25519_session_confirm(confirm2, shared_secret2, local_public_key, remote_public_key, false);
+      curve25519_session_confirm(expect1, shared_secret2, local_public_key, remote_public_key, true);
+      if(send_all(fd, confirm2, sizeof(confirm2)) != 0){
+        curve25519_log(C25519_LOG_ERROR, "send: {}", strerror(errno));
+        close(fd);
+        return -1;
       }
-      else if(len  == 0)
-      {
-        printf("Alice端断开了连接...\n");
+      //接收Alice的确认值
+      if(recv_all(fd, confirm1, sizeof(confirm1)) != 0){
+        curve25519_log(C25519_LOG_WARN, "接收确认值失败, Alice端断开了连接...");
+        close(fd);
+        return -1;
       }
-      else { perror("recv"); }
+      // 比较Alice的确认值
+      if (sodium_memcmp(confirm1, expect1, sizeof(confirm1)) != 0) {
+        curve25519_log(C25519_LOG_ERROR, "共享密钥不匹配。");
+        close(fd);
+        return -1;
+      }
+      curve25519_log(C25519_LOG_INFO, "共享密钥匹配");
+      curve25519_trace_span("confirm", "handshake", span);
+      curve25519_probe_phase("bob", "confirm", span, 2 * CURVE25519_CONFIRM_BYTES);
      uint8_t nonce[crypto_box_NONCEBYTES];
      unsigned char decrypted_text[MESSAGE_LEN];      
      unsigned char cipher_text[MESSAGE_LEN + crypto_box_MACBYTES];
 
-     len=recv(fd,cipher_text,MESSAGE_LEN + crypto_box_MACBYTES,0);
-     if(len<=0){ std::cout<<"传输失败"<<std::endl; }
-     len=recv(fd,nonce,crypto_box_NONCEBYTES,0);
-     if(len<=0){ std::cout<<"传输失败"<<std::endl; }
+     span = curve25519_trace_now();
+     if(recv_all(fd, cipher_text, sizeof(cipher_text)) != 0 || recv_all(fd, nonce, sizeof(nonce)) != 0){
+      curve25519_log(C25519_LOG_ERROR, "传输失败");
+      close(fd);
+      return -1;
+     }
+     curve25519_trace_span("receive", "handshake", span);
+     curve25519_probe_phase("bob", "receive", span, sizeof(cipher_text) + sizeof(nonce));
      //解密信息
-     if(crypto_box_open_easy_afternm(decrypted_text, cipher_text, sizeof(cipher_text), nonce,shared_secret2)!=0){
-      std::cerr << "解密信息失败。" << std::endl;
+     span = curve25519_trace_now();
+     if(crypto_box_open_easy_afternm(decrypted_text, cipher_text, sizeof(cipher_text), nonce,box_key)!=0){
+      curve25519_log(C25519_LOG_ERROR, "解密信息失败。");
+      close(fd);
       return -1;
      }
-    std::cout << "解密后的message: " << decrypted_text << std::endl;
+     curve25519_trace_span("decrypt", "handshake", span);
+     curve25519_probe_phase("bob", "decrypt", span, sizeof(cipher_text));
+    curve25519_log(C25519_LOG_INFO, "解密后的message: {}", reinterpret_cast<const char*>(decrypted_text));
+    if(bulk_path != nullptr &&
+       (stream ? recv_stream(fd, box_key, bulk_path) : recv_bulk(fd, box_key, bulk_path)) != 0) {
+      close(fd);
+      return -1;
+    }
     
     close(fd);
     return 0;
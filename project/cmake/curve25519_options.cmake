@@ -0,0 +1,59 @@
+# curve25519库、Alice和Bob共用的构建选项, 各CMakeLists.txt包含本文件后对自己的目标调用
+# curve25519_options(<目标>)
+
+# AOT编译: 构建时生成CPU设备镜像, 运行时不再即时编译内核(需要编译器带有opencl-aot)
+option(CURVE25519_AOT "为CPU设备预先编译SYCL内核" OFF)
+set(CURVE25519_AOT_ARCH "avx2" CACHE STRING "AOT编译的目标指令集: sse4.2/avx/avx2/avx512")
+
+# 关闭运算和内存分配计数器, 计数语句在编译时全部移除
+option(CURVE25519_NO_STATS "关闭curve25519运算计数" OFF)
+
+# 系统有<sys/sdt.h>(systemtap-sdt-dev)时自动编入USDT探针, 未挂载时只是nop
+option(CURVE25519_NO_PROBES "不编入curve25519的USDT探针" OFF)
+
+# 发布构建: LTO由预设中的CMAKE_INTERPROCEDURAL_OPTIMIZATION开启
+# PGO分两步: GEN构建插桩版本并运行训练负载, 合并剖析数据后以USE重新构建(见pgo.sh)
+set(CURVE25519_PGO "" CACHE STRING "基于剖析的优化阶段: 留空/GEN/USE")
+set(CURVE25519_PGO_DIR "${CMAKE_SOURCE_DIR}/build/pgo" CACHE PATH "剖析数据目录")
+
+function(curve25519_options _TARGET)
+  if (CURVE25519_NO_STATS)
+    target_compile_definitions(${_TARGET} PRIVATE CURVE25519_NO_STATS)
+  endif()
+  if (CURVE25519_NO_PROBES)
+    target_compile_definitions(${_TARGET} PRIVATE CURVE25519_NO_PROBES)
+  endif()
+
+  if (CURVE25519_PGO STREQUAL "GEN")
+    message("PGO插桩构建, 剖析数据写入 ${CURVE25519_PGO_DIR}")
+    target_compile_options(${_TARGET}
+      PRIVATE "-fprofile-generate=${CURVE25519_PGO_DIR}"
+    )
+    target_link_options(${_TARGET}
+      PRIVATE "-fprofile-generate=${CURVE25519_PGO_DIR}"
+    )
+  elseif (CURVE25519_PGO STREQUAL "USE")
+    message("PGO优化构建, 使用 ${CURVE25519_PGO_DIR}/curve25519.profdata")
+    # 训练负载覆盖不到的函数(如出错路径)没有剖析数据, 不作为警告
+    target_compile_options(${_TARGET}
+      PRIVATE "-fprofile-use=${CURVE25519_PGO_DIR}/curve25519.profdata"
+      "-Wno-profile-instr-unprofiled" "-Wno-profile-instr-out-of-date"
+    )
+    target_link_options(${_TARGET}
+      PRIVATE "-fprofile-use=${CURVE25519_PGO_DIR}/curve25519.profdata"
+    )
+  endif()
+
+  # AOT只用于普通版本, cuda版本的设备镜像本来就是预先编译的
+  if (DEFINED ENV{DPCPP_CPDIR} AND CURVE25519_AOT)
+    message("AOT编译CPU设备镜像: ${CURVE25519_AOT_ARCH}")
+    # 保留spir64镜像, 在其他设备上仍可即时编译
+    target_compile_options(${_TARGET}
+      PRIVATE "-fsycl-targets=spir64_x86_64,spir64"
+    )
+    target_link_options(${_TARGET}
+      PRIVATE "-fsycl-targets=spir64_x86_64,spir64"
+      "SHELL:-Xsycl-target-backend=spir64_x86_64 \"-march=${CURVE25519_AOT_ARCH}\""
+    )
+  endif()
+endfunction()
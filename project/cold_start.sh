@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# 冷启动测试: 统计Alice从进程启动到完成首次握手的时间
+# $1 传入的第一个参数,即使用./cold_start.sh simple 或 ./cold_start.sh cuda调用不同版本
+# $2 重复次数,默认5次
+if [ "$1" == "simple" ]
+then
+    export PATH=$DPCPP_CPDIR/build/bin:$PATH
+    export LD_LIBRARY_PATH=$DPCPP_CPDIR/build/lib:$LD_LIBRARY_PATH
+    BUILD=./build/build/Linux-DPCplusplus-clang
+elif [ "$1" == "cuda" ]
+then
+    export PATH=$DPCPP_CUDA_CPDIR/build/bin:$PATH
+    export LD_LIBRARY_PATH=$DPCPP_CUDA_CPDIR/build/lib:$LD_LIBRARY_PATH
+    BUILD=./build/build/Linux-DPCplusplus-clang-cuda
+else
+    exit 1
+fi
+
+RUNS=${2:-5}
+for ((i = 0; i < RUNS; i++))
+do
+    # Bob先启动并完成初始化, 等待Alice开始监听, 只统计Alice一侧的冷启动
+    $BUILD/Bob/Bob 127.0.0.1 1000 > /dev/null &
+    BOB=$!
+    CURVE25519_LAUNCH_NS=$(date +%s%N) $BUILD/Alice/Alice | grep -E "预热|首次握手"
+    wait $BOB
+done
+exit 0
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# $1 传入的第一个参数,即使用./curve25519_dudect.sh simple 或 ./curve25519_dudect.sh cuda调用不同版本
+# 其余参数传给常数时间检验程序, 如 --json result.json --cpu 2 --raw ./dudect
+if [ "$1" == "simple" ]
+then
+    echo "普通版本"
+    export PATH=$DPCPP_CPDIR/build/bin:$PATH
+    export LD_LIBRARY_PATH=$DPCPP_CPDIR/build/lib:$LD_LIBRARY_PATH
+    ./build/build/Linux-DPCplusplus-clang/deps/curve25519/curve25519_dudect "${@:2}"
+elif [ "$1" == "cuda" ]
+then
+    echo "cuda版本"
+    export PATH=$DPCPP_CUDA_CPDIR/build/bin:$PATH
+    export LD_LIBRARY_PATH=$DPCPP_CUDA_CPDIR/build/lib:$LD_LIBRARY_PATH
+    ./build/build/Linux-DPCplusplus-clang-cuda/deps/curve25519/curve25519_dudect "${@:2}"
+else
+    exit 1
+fi
+# 发现泄漏时检验程序返回2, 原样作为脚本的退出码
+exit $?
@@ -0,0 +1,617 @@
+#if defined(__GNUC__) && !defined(__clang__)
+//向量类型只在本文件的静态函数之间传递, 不受向量参数ABI变化的影响
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+#include "curve25519_aead.h"
+#include "curve25519_secretbox.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+//加密时每次先加密这么多字节再计算MAC, Poly1305读到的密文还在缓存里
+#define AEAD_CHUNK 8192
+//Poly1305多路计算至少需要的块数, 更短的数据逐块计算
+#define AEAD_POLY_MIN_BLOCKS 64
+//Poly1305最多的并行路数
+#define AEAD_POLY_MAX_LANES 8
+//未指定实现时, 项目内的实现至少比libsodium快这么多倍才使用
+#define AEAD_MIN_SPEEDUP 1.1
+//选择实现时测量的消息长度和次数
+#define AEAD_MEASURE_BYTES 65536
+#define AEAD_MEASURE_ROUNDS 5
+
+typedef uint32_t chacha_v4 __attribute__((vector_size(16)));
+typedef uint32_t chacha_v8 __attribute__((vector_size(32)));
+typedef uint32_t chacha_v16 __attribute__((vector_size(64)));
+
+//向量都按引用传递, 只在 target 函数里展开
+template <typename V>
+static inline void chacha_rotl(V &x, int c) {
+  x = (x << c) | (x >> (32 - c));
+}
+
+//循环左移R(8的倍数)位用字节重排完成, AVX2上是一条vpshufb
+template <int R, typename V, size_t... I>
+static inline void chacha_rotl_bytes(V &x, std::index_sequence<I...>) {
+  typedef u8 bytes __attribute__((vector_size(sizeof(V))));
+  x = (V)__builtin_shufflevector((bytes)x, (bytes)x, ((I & ~size_t(3)) | ((I + 4 - R / 8) & 3))...);
+}
+
+// ByteRot: 16位和8位的循环移位用字节重排; AVX-512有vprold, 不需要
+template <typename V, bool ByteRot>
+static inline void chacha_quarter(V &a, V &b, V &c, V &d) {
+  a += b; d ^= a;
+  if constexpr (ByteRot) chacha_rotl_bytes<16>(d, std::make_index_sequence<sizeof(V)>());
+  else chacha_rotl(d, 16);
+  c += d; b ^= c; chacha_rotl(b, 12);
+  a += b; d ^= a;
+  if constexpr (ByteRot) chacha_rotl_bytes<8>(d, std::make_index_sequence<sizeof(V)>());
+  else chacha_rotl(d, 8);
+  c += d; b ^= c; chacha_rotl(b, 7);
+}
+
+// lo为a、b前半部分的交错, hi为后半部分的交错
+template <typename V, size_t... K>
+static inline void chacha_zip(const V &a, const V &b, V &lo, V &hi, std::index_sequence<K...>) {
+  constexpr size_t L = sizeof...(K);
+  lo = __builtin_shufflevector(a, b, (K % 2 == 0 ? K / 2 : L + K / 2)...);
+  hi = __builtin_shufflevector(a, b, (K % 2 == 0 ? L / 2 + K / 2 : L + L / 2 + K / 2)...);
+}
+
+// L个向量组成的矩阵转置, 交错log2(L)轮: 第i个向量的第j个字 -> 第j个向量的第i个字
+template <typename V, int L>
+static inline void chacha_transpose(V *v) {
+  V out[L];
+  for (int round = 1; round < L; round *= 2) {
+    for (int i = 0; i < L / 2; ++i) {
+      chacha_zip(v[i], v[i + L / 2], out[2 * i], out[2 * i + 1], std::make_index_sequence<L>());
+    }
+    for (int i = 0; i < L; ++i) v[i] = out[i];
+  }
+}
+
+/* 从计数器 state[12] 开始的 blocks 个块的密钥流与 in 异或后写入 out(可以相同)
+ * 每次同时计算L个块, x[i]的第j个元素为第j块的第i个字; 算完后每L个字转置一次,
+ * x[g*L + j]就是第j块的第g段, 可以整段异或 */
+template <typename V, int L, bool ByteRot>
+static inline void chacha_xor_lanes(u8 *out, const u8 *in, size_t blocks, const uint32_t state[16]) {
+  V init[16], x[16], data;
+  for (size_t first = 0; first < blocks; first += L) {
+    for (int i = 0; i < 16; ++i) init[i] = V{} + state[i];
+    for (int j = 0; j < L; ++j) init[12][j] = state[12] + uint32_t(first + j);
+    for (int i = 0; i < 16; ++i) x[i] = init[i];
+    for (int round = 0; round < 10; ++round) {
+      chacha_quarter<V, ByteRot>(x[0], x[4], x[8], x[12]);
+      chacha_quarter<V, ByteRot>(x[1], x[5], x[9], x[13]);
+      chacha_quarter<V, ByteRot>(x[2], x[6], x[10], x[14]);
+      chacha_quarter<V, ByteRot>(x[3], x[7], x[11], x[15]);
+      chacha_quarter<V, ByteRot>(x[0], x[5], x[10], x[15]);
+      chacha_quarter<V, ByteRot>(x[1], x[6], x[11], x[12]);
+      chacha_quarter<V, ByteRot>(x[2], x[7], x[8], x[13]);
+      chacha_quarter<V, ByteRot>(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) x[i] += init[i];
+    for (int g = 0; g < 16; g += L) chacha_transpose<V, L>(x + g);
+    const size_t count = std::min<size_t>(L, blocks - first);
+    for (size_t j = 0; j < count; ++j) {
+      const u8 *src = in + 64 * (first + j);
+      u8 *dst = out + 64 * (first + j);
+      for (int g = 0; g < 16; g += L) {
+        memcpy(&data, src + 4 * g, sizeof(V));
+        data ^= x[g + j];
+        memcpy(dst + 4 * g, &data, sizeof(V));
+      }
+    }
+  }
+  sodium_memzero(x, sizeof(x));
+}
+
+// out = a * b mod 2^130-5, 5个26位limb
+static void poly_mul(uint32_t out[5], const uint32_t a[5], const uint32_t b[5]) {
+  const uint64_t s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+  uint64_t d0 = uint64_t(a[0]) * b[0] + a[1] * s4 + a[2] * s3 + a[3] * s2 + a[4] * s1;
+  uint64_t d1 = uint64_t(a[0]) * b[1] + uint64_t(a[1]) * b[0] + a[2] * s4 + a[3] * s3 + a[4] * s2;
+  uint64_t d2 = uint64_t(a[0]) * b[2] + uint64_t(a[1]) * b[1] + uint64_t(a[2]) * b[0] + a[3] * s4 + a[4] * s3;
+  uint64_t d3 = uint64_t(a[0]) * b[3] + uint64_t(a[1]) * b[2] + uint64_t(a[2]) * b[1] + uint64_t(a[3]) * b[0] +
+                a[4] * s4;
+  uint64_t d4 = uint64_t(a[0]) * b[4] + uint64_t(a[1]) * b[3] + uint64_t(a[2]) * b[2] + uint64_t(a[3]) * b[1] +
+                uint64_t(a[4]) * b[0];
+  uint64_t c;
+                c = d0 >> 26; out[0] = uint32_t(d0) & 0x3ffffff;
+  d1 += c;      c = d1 >> 26; out[1] = uint32_t(d1) & 0x3ffffff;
+  d2 += c;      c = d2 >> 26; out[2] = uint32_t(d2) & 0x3ffffff;
+  d3 += c;      c = d3 >> 26; out[3] = uint32_t(d3) & 0x3ffffff;
+  d4 += c;      c = d4 >> 26; out[4] = uint32_t(d4) & 0x3ffffff;
+  out[0] += uint32_t(c * 5); c = out[0] >> 26; out[0] &= 0x3ffffff;
+  out[1] += uint32_t(c);
+}
+
+#if defined(__x86_64__)
+typedef uint64_t poly_v4 __attribute__((vector_size(32)));
+typedef uint64_t poly_v8 __attribute__((vector_size(64)));
+
+//各元素低32位相乘得到64位积
+__attribute__((target("avx2"))) static inline poly_v4 poly_mul32(const poly_v4 &a, const poly_v4 &b) {
+  return (poly_v4)_mm256_mul_epu32((__m256i)a, (__m256i)b);
+}
+
+//不用 _mm512_mul_epu32: GCC 12对其中未初始化的寄存器参数误报 -Wmaybe-uninitialized
+__attribute__((target("avx512f"))) static inline poly_v8 poly_mul32(const poly_v8 &a, const poly_v8 &b) {
+  return (poly_v8)_mm512_maskz_mul_epu32(0xff, (__m512i)a, (__m512i)b);
+}
+
+/* L路并行的Poly1305: 第j路累加第 j, j+L, j+2L, ... 块, 每步乘r^L, 最后一步第j路乘r^(L-j),
+ * 各路相加就是逐块计算的结果。rpow[k]为r^(k+1), blocks为L的整数倍 */
+template <typename V, int L>
+static inline void poly_lanes(poly1305_state *st, const uint32_t (*rpow)[5], const u8 *m, size_t blocks) {
+  const V mask = V{} + 0x3ffffff;
+  V r[5], s[5], rl[5], sl[5], h[5], t[5];
+  for (int i = 0; i < 5; ++i) {
+    r[i] = V{} + rpow[L - 1][i];
+    s[i] = r[i] + (r[i] << 2);
+    for (int j = 0; j < L; ++j) rl[i][j] = rpow[L - 1 - j][i];
+    sl[i] = rl[i] + (rl[i] << 2);
+    h[i] = V{};
+    h[i][0] = st->h[i];
+  }
+  for (size_t k = 0; k < blocks; k += L) {
+    //L个块的前8字节和后8字节分别放进lo和hi, 再切成5个26位limb
+    V a, b, lo, hi;
+    memcpy(&a, m + 16 * k, sizeof(V));
+    memcpy(&b, m + 16 * k + sizeof(V), sizeof(V));
+    if constexpr (L == 4) {
+      lo = __builtin_shufflevector(a, b, 0, 2, 4, 6);
+      hi = __builtin_shufflevector(a, b, 1, 3, 5, 7);
+    } else {
+      lo = __builtin_shufflevector(a, b, 0, 2, 4, 6, 8, 10, 12, 14);
+      hi = __builtin_shufflevector(a, b, 1, 3, 5, 7, 9, 11, 13, 15);
+    }
+    t[0] = lo & mask;
+    t[1] = (lo >> 26) & mask;
+    t[2] = ((lo >> 52) | (hi << 12)) & mask;
+    t[3] = (hi >> 14) & mask;
+    t[4] = (hi >> 40) | (1u << 24);
+    for (int i = 0; i < 5; ++i) h[i] += t[i];
+    const V *R = k + L == blocks ? rl : r, *S = k + L == blocks ? sl : s;
+    V d0 = poly_mul32(h[0], R[0]) + poly_mul32(h[1], S[4]) + poly_mul32(h[2], S[3]) + poly_mul32(h[3], S[2]) +
+           poly_mul32(h[4], S[1]);
+    V d1 = poly_mul32(h[0], R[1]) + poly_mul32(h[1], R[0]) + poly_mul32(h[2], S[4]) + poly_mul32(h[3], S[3]) +
+           poly_mul32(h[4], S[2]);
+    V d2 = poly_mul32(h[0], R[2]) + poly_mul32(h[1], R[1]) + poly_mul32(h[2], R[0]) + poly_mul32(h[3], S[4]) +
+           poly_mul32(h[4], S[3]);
+    V d3 = poly_mul32(h[0], R[3]) + poly_mul32(h[1], R[2]) + poly_mul32(h[2], R[1]) + poly_mul32(h[3], R[0]) +
+           poly_mul32(h[4], S[4]);
+    V d4 = poly_mul32(h[0], R[4]) + poly_mul32(h[1], R[3]) + poly_mul32(h[2], R[2]) + poly_mul32(h[3], R[1]) +
+           poly_mul32(h[4], R[0]);
+    V c;
+                     c = d0 >> 26; h[0] = d0 & mask;
+    d1 += c;         c = d1 >> 26; h[1] = d1 & mask;
+    d2 += c;         c = d2 >> 26; h[2] = d2 & mask;
+    d3 += c;         c = d3 >> 26; h[3] = d3 & mask;
+    d4 += c;         c = d4 >> 26; h[4] = d4 & mask;
+    h[0] += c + (c << 2); c = h[0] >> 26; h[0] &= mask;
+    h[1] += c;
+  }
+
+  //各路相加后进位
+  uint64_t sum[5], c;
+  for (int i = 0; i < 5; ++i) {
+    sum[i] = 0;
+    for (int j = 0; j < L; ++j) sum[i] += uint64_t(h[i][j]);
+  }
+                c = sum[0] >> 26; sum[0] &= 0x3ffffff;
+  sum[1] += c;  c = sum[1] >> 26; sum[1] &= 0x3ffffff;
+  sum[2] += c;  c = sum[2] >> 26; sum[2] &= 0x3ffffff;
+  sum[3] += c;  c = sum[3] >> 26; sum[3] &= 0x3ffffff;
+  sum[4] += c;  c = sum[4] >> 26; sum[4] &= 0x3ffffff;
+  sum[0] += c * 5; c = sum[0] >> 26; sum[0] &= 0x3ffffff;
+  sum[1] += c;
+  for (int i = 0; i < 5; ++i) st->h[i] = uint32_t(sum[i]);
+}
+
+__attribute__((target("avx512f"), flatten)) static void chacha_xor_avx512(u8 *out, const u8 *in, size_t blocks,
+                                                                          const uint32_t state[16]) {
+  chacha_xor_lanes<chacha_v16, 16, false>(out, in, blocks, state);
+}
+
+__attribute__((target("avx2"), flatten)) static void chacha_xor_avx2(u8 *out, const u8 *in, size_t blocks,
+                                                                     const uint32_t state[16]) {
+  chacha_xor_lanes<chacha_v8, 8, true>(out, in, blocks, state);
+}
+
+__attribute__((target("avx512f"), flatten)) static void poly_avx512(poly1305_state *st, const uint32_t (*rpow)[5],
+                                                                    const u8 *m, size_t blocks) {
+  poly_lanes<poly_v8, 8>(st, rpow, m, blocks);
+}
+
+__attribute__((target("avx2"), flatten)) static void poly_avx2(poly1305_state *st, const uint32_t (*rpow)[5],
+                                                               const u8 *m, size_t blocks) {
+  poly_lanes<poly_v4, 4>(st, rpow, m, blocks);
+}
+#endif
+
+static void chacha_xor_generic(u8 *out, const u8 *in, size_t blocks, const uint32_t state[16]) {
+  chacha_xor_lanes<chacha_v4, 4, false>(out, in, blocks, state);
+}
+
+//由状态中的密钥、计数器和nonce调用libsodium
+static void chacha_xor_sodium(u8 *out, const u8 *in, size_t blocks, const uint32_t state[16]) {
+  u8 key[32], nonce[12];
+  for (int i = 0; i < 8; ++i) sb_store32(key + 4 * i, state[4 + i]);
+  for (int i = 0; i < 3; ++i) sb_store32(nonce + 4 * i, state[13 + i]);
+  crypto_stream_chacha20_ietf_xor_ic(out, in, 64 * blocks, nonce, state[12], key);
+  sodium_memzero(key, sizeof(key));
+}
+
+//一种实现: ChaCha20多块函数和Poly1305多路函数(poly_lanes为0时逐块计算)
+struct aead_engine {
+  const char *name;
+  void (*xor_blocks)(u8 *out, const u8 *in, size_t blocks, const uint32_t state[16]);
+  void (*poly_blocks)(poly1305_state *st, const uint32_t (*rpow)[5], const u8 *m, size_t blocks);
+  int poly_lanes;
+  bool (*supported)();   //空指针表示任何CPU都可用
+  bool sodium;           //Poly1305和连续数据的加密直接调用libsodium
+};
+
+//libsodium放在最后, 是未指定实现且项目内的实现不够快时的默认选择
+static const aead_engine aead_engines[] = {
+#if defined(__x86_64__)
+  {"avx512", chacha_xor_avx512, poly_avx512, 8, [] { return bool(__builtin_cpu_supports("avx512f")); }, false},
+  {"avx2", chacha_xor_avx2, poly_avx2, 4, [] { return bool(__builtin_cpu_supports("avx2")); }, false},
+#endif
+  {"generic", chacha_xor_generic, nullptr, 0, nullptr, false},
+  {"libsodium", chacha_xor_sodium, nullptr, 0, nullptr, true},
+};
+
+//test15逐个测试各实现时使用
+static const aead_engine *aead_override = nullptr;
+
+static int aead_seal(const aead_engine *e, const curve25519_iovec *iov, size_t iovcnt, const u8 *src, u8 *mac,
+                     const u8 *ad, size_t adlen, const u8 *nonce, const u8 *key);
+
+//加密 AEAD_MEASURE_BYTES 字节的最短耗时(纳秒)
+static double aead_measure(const aead_engine *e) {
+  static const u8 key[CURVE25519_AEAD_KEYBYTES] = {0}, nonce[CURVE25519_AEAD_NONCEBYTES] = {0};
+  std::vector<u8> buf(AEAD_MEASURE_BYTES);
+  u8 mac[CURVE25519_AEAD_ABYTES];
+  const curve25519_iovec iov = {buf.data(), buf.size()};
+  double best = 0;
+  for (int i = 0; i <= AEAD_MEASURE_ROUNDS; ++i) {
+    const auto begin = std::chrono::steady_clock::now();
+    aead_seal(e, &iov, 1, nullptr, mac, nullptr, 0, nonce, key);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+    if (i == 1 || (i > 1 && ns < best)) best = ns;   //第0次预热
+  }
+  return best;
+}
+
+//环境变量CURVE25519_AEAD指定实现; 否则测量后只在项目内的实现明显快于libsodium时使用它
+static const aead_engine *aead_select() {
+  const char *want = getenv("CURVE25519_AEAD");
+  const aead_engine *fallback = &aead_engines[sizeof(aead_engines) / sizeof(aead_engines[0]) - 1];
+  if (want != nullptr && want[0] != '\0') {
+    for (const aead_engine &e : aead_engines) {
+      if ((e.supported == nullptr || e.supported()) && strcmp(want, e.name) == 0) return &e;
+    }
+    fprintf(stderr, "CURVE25519_AEAD=%s 在此CPU上不可用, 自动选择\n", want);
+  }
+  const aead_engine *best = fallback;
+  double best_ns = aead_measure(fallback) / AEAD_MIN_SPEEDUP;
+  for (const aead_engine &e : aead_engines) {
+    if (&e == fallback || (e.supported != nullptr && !e.supported())) continue;
+    const double ns = aead_measure(&e);
+    if (ns < best_ns) {
+      best = &e;
+      best_ns = ns;
+    }
+  }
+  return best;
+}
+
+static const aead_engine *aead_get() {
+  static const aead_engine *selected = aead_select();
+  return aead_override != nullptr ? aead_override : selected;
+}
+
+//ChaCha20密钥流, ks保存最后一个不完整块剩余的密钥流
+struct aead_stream {
+  const aead_engine *engine;
+  uint32_t state[16];
+  u8 ks[64];
+  size_t ks_pos;         //ks中已用掉的字节数
+};
+
+// Poly1305, buf保存不足16字节的输入
+struct aead_mac {
+  const aead_engine *engine;
+  poly1305_state st;
+  crypto_onetimeauth_poly1305_state sodium_st;   //engine->sodium 时代替st
+  uint32_t rpow[AEAD_POLY_MAX_LANES][5];
+  bool powers;           //rpow已经计算
+  u8 buf[16];
+  size_t buf_len;
+};
+
+static void stream_xor(aead_stream *s, u8 *out, const u8 *in, size_t len) {
+  while (len > 0 && s->ks_pos < 64) {
+    *out++ = *in++ ^ s->ks[s->ks_pos++];
+    --len;
+  }
+  const size_t blocks = len / 64;
+  if (blocks > 0) {
+    s->engine->xor_blocks(out, in, blocks, s->state);
+    s->state[12] += uint32_t(blocks);
+    out += 64 * blocks;
+    in += 64 * blocks;
+    len -= 64 * blocks;
+  }
+  if (len > 0) {
+    memset(s->ks, 0, sizeof(s->ks));
+    s->engine->xor_blocks(s->ks, s->ks, 1, s->state);
+    s->state[12] += 1;
+    for (size_t i = 0; i < len; ++i) out[i] = in[i] ^ s->ks[i];
+    s->ks_pos = len;
+  }
+}
+
+static void mac_blocks(aead_mac *p, const u8 *m, size_t blocks) {
+  if (p->engine->sodium) {
+    crypto_onetimeauth_poly1305_update(&p->sodium_st, m, 16 * blocks);
+    return;
+  }
+  const int lanes = p->engine->poly_lanes;
+  if (lanes > 0 && blocks >= AEAD_POLY_MIN_BLOCKS) {
+    if (!p->powers) {
+      memcpy(p->rpow[0], p->st.r, sizeof(p->rpow[0]));
+      for (int k = 1; k < lanes; ++k) poly_mul(p->rpow[k], p->rpow[k - 1], p->st.r);
+      p->powers = true;
+    }
+    const size_t vec = blocks - blocks % lanes;
+    p->engine->poly_blocks(&p->st, p->rpow, m, vec);
+    m += 16 * vec;
+    blocks -= vec;
+  }
+  if (blocks > 0) poly1305_blocks(&p->st, m, 16 * blocks, 1u << 24);
+}
+
+static void mac_update(aead_mac *p, const u8 *m, size_t len) {
+  if (p->buf_len > 0) {
+    const size_t take = std::min(len, 16 - p->buf_len);
+    memcpy(p->buf + p->buf_len, m, take);
+    p->buf_len += take;
+    m += take;
+    len -= take;
+    if (p->buf_len < 16) return;
+    mac_blocks(p, p->buf, 1);
+    p->buf_len = 0;
+  }
+  mac_blocks(p, m, len / 16);
+  memcpy(p->buf, m + (len & ~size_t(15)), len & 15);
+  p->buf_len = len & 15;
+}
+
+//补0到16字节的整数倍
+static void mac_pad(aead_mac *p) {
+  if (p->buf_len == 0) return;
+  memset(p->buf + p->buf_len, 0, 16 - p->buf_len);
+  mac_blocks(p, p->buf, 1);
+  p->buf_len = 0;
+}
+
+//最后一块为附加数据和密文的长度(各8字节小端)
+static void mac_final(aead_mac *p, u8 *mac, size_t adlen, size_t mlen) {
+  mac_pad(p);
+  u8 lens[16];
+  for (int i = 0; i < 8; ++i) {
+    lens[i] = u8(uint64_t(adlen) >> (8 * i));
+    lens[8 + i] = u8(uint64_t(mlen) >> (8 * i));
+  }
+  mac_blocks(p, lens, 1);
+  if (p->engine->sodium) {
+    crypto_onetimeauth_poly1305_final(&p->sodium_st, mac);
+  } else {
+    poly1305_finish(&p->st, mac, nullptr, 0);
+  }
+  sodium_memzero(p, sizeof(*p));
+}
+
+//计数器为0的块的前32字节作为Poly1305密钥, 数据从计数器1开始加密; 先计算附加数据的MAC
+static void aead_begin(const aead_engine *e, aead_stream *s, aead_mac *p, const u8 *ad, size_t adlen,
+                       const u8 *nonce, const u8 *key) {
+  s->engine = e;
+  s->state[0] = 0x61707865;
+  s->state[1] = 0x3320646e;
+  s->state[2] = 0x79622d32;
+  s->state[3] = 0x6b206574;
+  for (int i = 0; i < 8; ++i) s->state[4 + i] = sb_load32(key + 4 * i);
+  s->state[12] = 0;
+  for (int i = 0; i < 3; ++i) s->state[13 + i] = sb_load32(nonce + 4 * i);
+  s->ks_pos = 64;
+  u8 block0[64];
+  memset(block0, 0, sizeof(block0));
+  e->xor_blocks(block0, block0, 1, s->state);
+  s->state[12] = 1;
+
+  p->engine = e;
+  if (e->sodium) {
+    crypto_onetimeauth_poly1305_init(&p->sodium_st, block0);
+  } else {
+    poly1305_init(&p->st, block0);
+  }
+  p->powers = false;
+  p->buf_len = 0;
+  sodium_memzero(block0, sizeof(block0));
+  if (adlen > 0) mac_update(p, ad, adlen);
+  mac_pad(p);
+}
+
+//32位块计数器从1开始, 一条消息最多 2^32-1 块
+static int aead_check_len(const curve25519_iovec *iov, size_t iovcnt, size_t *total) {
+  *total = 0;
+  for (size_t i = 0; i < iovcnt; ++i) *total += iov[i].len;
+  if (uint64_t(*total) > 64 * uint64_t(0xffffffff)) {
+    fprintf(stderr, "消息过长: %zu字节\n", *total);
+    return -1;
+  }
+  return 0;
+}
+
+//加密iov的各段; src不为空时只有一段, 从src读入明文
+static int aead_seal(const aead_engine *e, const curve25519_iovec *iov, size_t iovcnt, const u8 *src, u8 *mac,
+                     const u8 *ad, size_t adlen, const u8 *nonce, const u8 *key) {
+  size_t total;
+  if (aead_check_len(iov, iovcnt, &total) != 0) return -1;
+  if (e->sodium && iovcnt == 1) {
+    return crypto_aead_chacha20poly1305_ietf_encrypt_detached(iov[0].base, mac, nullptr,
+                                                              src != nullptr ? src : iov[0].base, total, ad, adlen,
+                                                              nullptr, nonce, key);
+  }
+  aead_stream s;
+  aead_mac p;
+  aead_begin(e, &s, &p, ad, adlen, nonce, key);
+  for (size_t i = 0; i < iovcnt; ++i) {
+    u8 *out = iov[i].base;
+    const u8 *in = src != nullptr ? src : out;
+    for (size_t done = 0; done < iov[i].len; done += AEAD_CHUNK) {
+      const size_t len = std::min<size_t>(AEAD_CHUNK, iov[i].len - done);
+      stream_xor(&s, out + done, in + done, len);
+      mac_update(&p, out + done, len);
+    }
+  }
+  mac_final(&p, mac, adlen, total);
+  sodium_memzero(&s, sizeof(s));
+  return 0;
+}
+
+/* 先验证MAC, 通过后解密iov的各段; src不为空时只有一段, 从src读入密文
+ * libsodium的解密接口在验证失败时会清零输出, 所以libsodium实现也走这里, 只替换ChaCha20和Poly1305 */
+static int aead_open(const aead_engine *e, const curve25519_iovec *iov, size_t iovcnt, const u8 *src,
+                     const u8 *mac, const u8 *ad, size_t adlen, const u8 *nonce, const u8 *key) {
+  size_t total;
+  if (aead_check_len(iov, iovcnt, &total) != 0) return -1;
+  aead_stream s;
+  aead_mac p;
+  u8 expect[CURVE25519_AEAD_ABYTES];
+  aead_begin(e, &s, &p, ad, adlen, nonce, key);
+  for (size_t i = 0; i < iovcnt; ++i) mac_update(&p, src != nullptr ? src : iov[i].base, iov[i].len);
+  mac_final(&p, expect, adlen, total);
+  if (!secretbox_mac_equal(expect, mac)) {
+    sodium_memzero(&s, sizeof(s));
+    return -1;
+  }
+  for (size_t i = 0; i < iovcnt; ++i) {
+    stream_xor(&s, iov[i].base, src != nullptr ? src : iov[i].base, iov[i].len);
+  }
+  sodium_memzero(&s, sizeof(s));
+  return 0;
+}
+
+int curve25519_aead_key(u8 *key, const u8 *shared) {
+  static const char label[] = "curve25519 bulk chacha20poly1305";
+  if (crypto_generichash(key, CURVE25519_AEAD_KEYBYTES, reinterpret_cast<const u8 *>(label), sizeof(label) - 1,
+                         shared, 32) != 0) {
+    fprintf(stderr, "批量通道密钥派生失败\n");
+    return -1;
+  }
+  return 0;
+}
+
+const char *curve25519_aead_engine() {
+  return aead_get()->name;
+}
+
+int curve25519_aead_encrypt(u8 *c, const u8 *m, size_t mlen, const u8 *ad, size_t adlen, const u8 *nonce,
+                            const u8 *key) {
+  curve25519_perf_scope perf("curve25519_aead_encrypt");
+  CURVE25519_TRACE_SCOPE("curve25519_aead_encrypt");
+  const curve25519_iovec iov = {c, mlen};
+  return aead_seal(aead_get(), &iov, 1, m, c + mlen, ad, adlen, nonce, key);
+}
+
+int curve25519_aead_decrypt(u8 *m, const u8 *c, size_t clen, const u8 *ad, size_t adlen, const u8 *nonce,
+                            const u8 *key) {
+  if (clen < CURVE25519_AEAD_ABYTES) return -1;
+  curve25519_perf_scope perf("curve25519_aead_decrypt");
+  CURVE25519_TRACE_SCOPE("curve25519_aead_decrypt");
+  const size_t mlen = clen - CURVE25519_AEAD_ABYTES;
+  const curve25519_iovec iov = {m, mlen};
+  return aead_open(aead_get(), &iov, 1, c, c + mlen, ad, adlen, nonce, key);
+}
+
+int curve25519_aead_encrypt_iov(const curve25519_iovec *iov, size_t iovcnt, u8 *mac, const u8 *ad, size_t adlen,
+                                const u8 *nonce, const u8 *key) {
+  curve25519_perf_scope perf("curve25519_aead_encrypt");
+  CURVE25519_TRACE_SCOPE("curve25519_aead_encrypt_iov");
+  return aead_seal(aead_get(), iov, iovcnt, nullptr, mac, ad, adlen, nonce, key);
+}
+
+int curve25519_aead_decrypt_iov(const curve25519_iovec *iov, size_t iovcnt, const u8 *mac, const u8 *ad,
+                                size_t adlen, const u8 *nonce, const u8 *key) {
+  curve25519_perf_scope perf("curve25519_aead_decrypt");
+  CURVE25519_TRACE_SCOPE("curve25519_aead_decrypt_iov");
+  return aead_open(aead_get(), iov, iovcnt, nullptr, mac, ad, adlen, nonce, key);
+}
+
+//测试样例15: 各实现的输出与libsodium的ChaCha20-Poly1305(IETF)逐字节一致, 分散/聚集与连续接口一致
+int test15() {
+  const size_t lens[] = {0, 1, 15, 16, 17, 63, 64, 65, 255, 256, 1000, 4103, 16417, 65549, 200003};
+  const size_t max_len = 200003;
+  std::vector<u8> m(max_len), c(max_len + 16), expect(max_len + 16), buf(max_len + 16);
+  u8 key[32], nonce[12], ad[13], shared[32], mac[16];
+  for (size_t i = 0; i < max_len; ++i) m[i] = static_cast<u8>(i * 131 + 7);
+  for (int i = 0; i < 32; ++i) shared[i] = static_cast<u8>(i * 5 + 1);
+  for (int i = 0; i < 12; ++i) nonce[i] = static_cast<u8>(i * 9 + 2);
+  for (int i = 0; i < 13; ++i) ad[i] = static_cast<u8>(i * 3 + 4);
+  bool ok = curve25519_aead_key(key, shared) == 0;
+
+  for (const aead_engine &e : aead_engines) {
+    if (e.supported != nullptr && !e.supported()) continue;
+    aead_override = &e;
+    for (size_t k = 0; k < sizeof(lens) / sizeof(lens[0]) && ok; ++k) {
+      const size_t len = lens[k], adlen = k % 2 == 0 ? 0 : sizeof(ad);
+      unsigned long long clen;
+      crypto_aead_chacha20poly1305_ietf_encrypt(expect.data(), &clen, m.data(), len, ad, adlen, nullptr, nonce, key);
+      ok = ok && curve25519_aead_encrypt(c.data(), m.data(), len, ad, adlen, nonce, key) == 0 &&
+           memcmp(c.data(), expect.data(), len + 16) == 0;
+
+      //就地加密
+      memcpy(buf.data(), m.data(), len);
+      ok = ok && curve25519_aead_encrypt(buf.data(), buf.data(), len, ad, adlen, nonce, key) == 0 &&
+           memcmp(buf.data(), expect.data(), len + 16) == 0;
+      ok = ok && curve25519_aead_decrypt(buf.data(), buf.data(), len + 16, ad, adlen, nonce, key) == 0 &&
+           memcmp(buf.data(), m.data(), len) == 0;
+
+      //分散/聚集: 各段长度不是块长的整数倍
+      std::vector<curve25519_iovec> iov;
+      memcpy(buf.data(), m.data(), len);
+      for (size_t pos = 0, step = 1; pos < len; pos += step, step = step * 3 + 5) {
+        iov.push_back({buf.data() + pos, std::min(step, len - pos)});
+      }
+      ok = ok && curve25519_aead_encrypt_iov(iov.data(), iov.size(), mac, ad, adlen, nonce, key) == 0 &&
+           memcmp(buf.data(), expect.data(), len) == 0 && memcmp(mac, expect.data() + len, 16) == 0;
+      ok = ok && curve25519_aead_decrypt_iov(iov.data(), iov.size(), mac, ad, adlen, nonce, key) == 0 &&
+           memcmp(buf.data(), m.data(), len) == 0;
+
+      //篡改密文或tag后验证失败, 不写入明文
+      c[len / 2] ^= 0x10;
+      buf[0] = 0x5a;
+      ok = ok && curve25519_aead_decrypt(buf.data(), c.data(), len + 16, ad, adlen, nonce, key) == -1 &&
+           buf[0] == 0x5a;
+    }
+    if (!ok) fprintf(stderr, "批量通道加密(%s)结果有误\n", e.name);
+  }
+  aead_override = nullptr;
+  if (!ok) return 1;
+  fprintf(stderr, "批量通道加密结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+typedef uint8_t u8;
+
+/* 握手之后的批量数据通道: ChaCha20-Poly1305(RFC 8439, 12字节nonce, 32位块计数器),
+ * 输出与libsodium的 crypto_aead_chacha20poly1305_ietf_* 相同。
+ * 项目内的实现中ChaCha20一次计算多个块, Poly1305在长数据上用多路并行的Horner法:
+ * AVX-512(16块/8路), AVX2(8块/4路), 通用实现(4块/逐块)。首次使用时测量64KiB消息的加密耗时,
+ * 只有比libsodium快10%以上的实现才会被选中, 否则直接使用libsodium;
+ * 设置环境变量 CURVE25519_AEAD=avx512/avx2/generic/libsodium 可以指定实现。         */
+
+#define CURVE25519_AEAD_KEYBYTES 32
+#define CURVE25519_AEAD_NONCEBYTES 12
+#define CURVE25519_AEAD_ABYTES 16
+
+//一段数据, 分散/聚集接口的各段按顺序拼成一条消息
+struct curve25519_iovec {
+  u8 *base;
+  size_t len;
+};
+
+//由crypto_box_beforenm得到的32字节共享密钥派生批量通道的密钥, 成功返回0
+int curve25519_aead_key(u8 *key, const u8 *shared);
+
+//当前使用的实现: "avx512" / "avx2" / "generic" / "libsodium"
+const char *curve25519_aead_engine();
+
+/* 加密: c = 密文 || 16字节tag, c可以等于m(就地加密); ad为附加数据, adlen为0时可以为空
+ * 成功返回0, 消息超过ChaCha20计数器的范围(256GiB)时返回-1 */
+int curve25519_aead_encrypt(u8 *c, const u8 *m, size_t mlen, const u8 *ad, size_t adlen, const u8 *nonce,
+                            const u8 *key);
+
+/* 解密: c(长度clen, 含tag)验证通过后把明文写入m, 长度 clen - 16, m可以等于c
+ * 验证失败返回-1, 不写入明文 */
+int curve25519_aead_decrypt(u8 *m, const u8 *c, size_t clen, const u8 *ad, size_t adlen, const u8 *nonce,
+                            const u8 *key);
+
+//分散/聚集: 就地加密iov的各段, tag写入mac; 结果与把各段拼接后调用 curve25519_aead_encrypt 相同
+int curve25519_aead_encrypt_iov(const curve25519_iovec *iov, size_t iovcnt, u8 *mac, const u8 *ad, size_t adlen,
+                                const u8 *nonce, const u8 *key);
+
+//分散/聚集: 验证通过后就地解密iov的各段, 验证失败返回-1, 数据不变
+int curve25519_aead_decrypt_iov(const curve25519_iovec *iov, size_t iovcnt, const u8 *mac, const u8 *ad,
+                                size_t adlen, const u8 *nonce, const u8 *key);
+
+int test15();
@@ -0,0 +1,211 @@
+#include "curve25519_async.h"
+#include "curve25519_runtime.h"
+#include "curve25519_field.h"
+#include "curve25519_numa.h"
+#include "curve25519_profile.h"
+#include "curve25519_stats.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include "curve25519_probe.h"
+#include "curve25519_tune.h"
+#include <cstdio>
+#include <memory>
+
+using namespace sycl;
+
+//一次异步请求占用的USM内存: [输出 | 私钥 | 基点], 每段 n*32 字节
+struct async_job {
+  u8 *usm = nullptr;
+  size_t n = 0;
+  u8 *mypublic;
+  std::promise<int> done;
+  curve25519_callback cb;
+  uint64_t begin = 0;   //开启时间线追踪或挂载了async_return探针时记录提交时刻
+};
+
+//指定子组大小的nd_range内核, 子组大小必须在编译期确定
+template <int SG>
+static event submit_sub_group(queue &exec_q, u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                              size_t n, size_t wg) {
+  const size_t global = (n + wg - 1) / wg * wg;
+  return exec_q.submit([&](handler &h) {
+    h.parallel_for(nd_range<1>{range<1>{global}, range<1>{wg}},
+                   [=](nd_item<1> it) [[sycl::reqd_sub_group_size(SG)]] {
+      const size_t i = it.get_global_id(0);
+      if (i < n) curve25519_scalarmult_item(mypublic + 32 * i, secret + 32 * i, basepoint + 32 * i);
+    });
+  });
+}
+
+static event submit_batch(queue &exec_q, u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n,
+                          size_t work_group, size_t sub_group) {
+  if (sub_group != 0 && work_group == 0) work_group = sub_group;
+  switch (sub_group) {
+    case 8: return submit_sub_group<8>(exec_q, mypublic, secret, basepoint, n, work_group);
+    case 16: return submit_sub_group<16>(exec_q, mypublic, secret, basepoint, n, work_group);
+    default: break;
+  }
+  if (work_group != 0) {
+    const size_t global = (n + work_group - 1) / work_group * work_group;
+    return exec_q.submit([&](handler &h) {
+      h.parallel_for(nd_range<1>{range<1>{global}, range<1>{work_group}}, [=](nd_item<1> it) {
+        const size_t i = it.get_global_id(0);
+        if (i < n) curve25519_scalarmult_item(mypublic + 32 * i, secret + 32 * i, basepoint + 32 * i);
+      });
+    });
+  }
+  return exec_q.submit([&](handler &h) {
+    //每个work-item独立完成一次标量乘法
+    h.parallel_for(range<1>{n}, [=](id<1> i) {
+      curve25519_scalarmult_item(mypublic + 32 * i, secret + 32 * i, basepoint + 32 * i);
+    });
+  });
+}
+
+event curve25519_donna_batch_submit(queue &exec_q, u8 *mypublic, const u8 *secret,
+                                    const u8 *basepoint, size_t n, size_t work_group, size_t sub_group) {
+  event e = submit_batch(exec_q, mypublic, secret, basepoint, n, work_group, sub_group);
+  CURVE25519_COUNT(C25519_SUBMIT, 1);
+  return e;
+}
+
+//把输入复制到USM, 提交内核, 并用依赖内核事件的host_task完成结果回写和通知
+static std::future<int> submit_job(u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                                   size_t n, curve25519_callback cb) {
+  queue &q = curve25519_queue();
+  auto job = std::make_shared<async_job>();
+  job->n = n;
+  job->mypublic = mypublic;
+  job->cb = std::move(cb);
+  CURVE25519_PROBE(async_entry, mypublic, n);
+  if (curve25519_trace_enabled() || CURVE25519_PROBE_ENABLED(async_return)) job->begin = curve25519_trace_now();
+  std::future<int> result = job->done.get_future();
+
+  try {
+    job->usm = malloc_shared<u8>(3 * 32 * n, q);
+    CURVE25519_COUNT_USM(3 * 32 * n);
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "分配USM内存失败: %s\n", ex.what());
+  }
+  if (job->usm == nullptr) {
+    CURVE25519_PROBE(async_return, mypublic, n, -1, 0);
+    if (job->cb) job->cb(-1);
+    job->done.set_value(-1);
+    return result;
+  }
+
+  event e;
+  bool submitted = false;   //标量乘法内核已提交, 出错时要等它结束才能释放USM
+  try {
+    memcpy(job->usm + 32 * n, secret, 32 * n);
+    memcpy(job->usm + 64 * n, basepoint, 32 * n);
+
+    const curve25519_tuning tuning = curve25519_tuning_current();
+    e = curve25519_donna_batch_submit(q, job->usm, job->usm + 32 * n, job->usm + 64 * n, n,
+                                      tuning.work_group, tuning.sub_group);
+    submitted = true;
+    curve25519_profile_scalarmult(n, 0);
+    CURVE25519_COUNT(C25519_SCALARMULT, n);
+    q.submit([&](handler &h) {
+      h.depends_on(e);
+      //内核已经完成, 在这里读取剖析时间戳不会阻塞提交线程
+      h.host_task([job, e]() {
+        curve25519_profile_kernel_done("scalarmult_batch", e);
+        memcpy(job->mypublic, job->usm, 32 * job->n);
+        memset(job->usm + 32 * job->n, 0, 32 * job->n);   //清除私钥副本
+        free(job->usm, curve25519_queue());
+        if (job->begin != 0) {
+          curve25519_trace_span("curve25519_donna_async", "curve25519", job->begin);
+          CURVE25519_PROBE(async_return, job->mypublic, job->n, 0, curve25519_trace_now() - job->begin);
+        }
+        //先回调再就绪future, 保证get()返回时回调已经执行完
+        if (job->cb) job->cb(0);
+        job->done.set_value(0);
+      });
+    });
+    CURVE25519_COUNT(C25519_SUBMIT, 1);
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "提交异步标量乘法失败: %s\n", ex.what());
+    if (submitted) {
+      try {
+        e.wait();
+      } catch (const sycl::exception &) {
+        //内核本身出错时结果已经无用, 只需确认它不再访问USM
+      }
+    }
+    memset(job->usm + 32 * n, 0, 32 * n);   //清除私钥副本
+    free(job->usm, q);
+    CURVE25519_PROBE(async_return, mypublic, n, -1, 0);
+    if (job->cb) job->cb(-1);
+    job->done.set_value(-1);
+  }
+  return result;
+}
+
+std::future<int> curve25519_donna_async(u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                                        curve25519_callback cb) {
+  return submit_job(mypublic, secret, basepoint, 1, std::move(cb));
+}
+
+std::future<int> curve25519_donna_batch_async(u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                                              size_t n, curve25519_callback cb) {
+  return submit_job(mypublic, secret, basepoint, n, std::move(cb));
+}
+
+int curve25519_donna_batch_sycl(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n) {
+  if (n == 0) return 0;
+  curve25519_perf_scope perf("curve25519_donna_batch_sycl", n);
+  CURVE25519_TRACE_SCOPE("curve25519_donna_batch_sycl");
+  CURVE25519_PROBE(batch_entry, n);
+  const uint64_t begin = CURVE25519_PROBE_ENABLED(batch_return) ? curve25519_trace_now() : 0;
+  //划分了NUMA子设备时送到调用线程本地的子设备上执行
+  const int ret = curve25519_numa_count() > 0 ? curve25519_donna_batch_local(mypublic, secret, basepoint, n)
+                                              : curve25519_donna_batch_async(mypublic, secret, basepoint, n).get();
+  if (begin != 0) CURVE25519_PROBE(batch_return, n, ret, curve25519_trace_now() - begin);
+  return ret;
+}
+
+int curve25519_donna_batch(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n) {
+  return curve25519_donna_dispatch(mypublic, secret, basepoint, n);
+}
+
+//测试样例4: 批量接口和异步接口的结果与curve25519_donna一致
+int test4() {
+  const size_t n = 8;
+  u8 secret[n * 32], basepoint[n * 32], expect[n * 32], out[n * 32], single[32];
+
+  for (size_t i = 0; i < n * 32; ++i) {
+    secret[i] = static_cast<u8>(i * 7 + 3);
+    basepoint[i] = static_cast<u8>(i * 13 + 9);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    curve25519_donna(expect + 32 * i, secret + 32 * i, basepoint + 32 * i);
+  }
+
+  if (curve25519_donna_batch_sycl(out, secret, basepoint, n) != 0 ||
+      memcmp(out, expect, sizeof(out)) != 0) {
+    fprintf(stderr, "批量标量乘法结果有误\n");
+    return 1;
+  }
+
+  //划分子设备后批量任务走本地子设备, 结果应一致
+  if (curve25519_numa_init(NUMA_PARTITION_EQUALLY, 2, 1 << 20) > 0) {
+    memset(out, 0, sizeof(out));
+    int ret = curve25519_donna_batch_sycl(out, secret, basepoint, n);
+    curve25519_numa_release();
+    if (ret != 0 || memcmp(out, expect, sizeof(out)) != 0) {
+      fprintf(stderr, "子设备批量标量乘法结果有误\n");
+      return 1;
+    }
+  }
+
+  int called = -1;
+  std::future<int> f = curve25519_donna_async(single, secret, basepoint,
+                                              [&called](int ret) { called = ret; });
+  if (f.get() != 0 || called != 0 || memcmp(single, expect, 32) != 0) {
+    fprintf(stderr, "异步标量乘法结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "批量及异步标量乘法结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <sycl/sycl.hpp>
+#include "curve25519_donna.h"
+
+//异步完成回调, 参数为返回码(0表示成功), 在SYCL运行时的host_task线程中执行
+typedef std::function<void(int)> curve25519_callback;
+
+/* 批量标量乘法内核: mypublic[i] = secret[i] * basepoint[i], i < n
+ * 三个数组都是按32字节连续存放的n个元素, 必须是queue可访问的USM内存。
+ * work_group/sub_group 为0时由运行时决定, sub_group 只支持8和16。
+ * 函数只提交内核不等待, 返回的事件完成后结果才可读。                 */
+sycl::event curve25519_donna_batch_submit(sycl::queue &exec_q, u8 *mypublic,
+                                          const u8 *secret, const u8 *basepoint, size_t n,
+                                          size_t work_group = 0, size_t sub_group = 0);
+
+//SYCL批量内核的同步接口, 参数可以是普通主机内存; 调用过curve25519_numa_init时在本地子设备上执行
+int curve25519_donna_batch_sycl(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n);
+
+/* 同步批量接口, 参数可以是普通主机内存: 按自动调优的分界点选择主机单线程、主机线程池
+ * 或SYCL批量内核(见curve25519_donna_dispatch), 尚未调优时先调优                    */
+int curve25519_donna_batch(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n);
+
+/* 非阻塞接口: 输入在函数返回前已被复制, 调用者只需保证 mypublic 在完成前有效。
+ * 返回的future在结果写入 mypublic 后就绪, 若给定cb则同时调用cb。           */
+std::future<int> curve25519_donna_async(u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                                        curve25519_callback cb = nullptr);
+std::future<int> curve25519_donna_batch_async(u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                                              size_t n, curve25519_callback cb = nullptr);
+
+int test4();
@@ -0,0 +1,456 @@
+#include "curve25519_donna.h"
+#include "curve25519_runtime.h"
+#include "curve25519_async.h"
+#include "curve25519_host.h"
+#include "curve25519_ed25519.h"
+#include "curve25519_box.h"
+#include "curve25519_aead.h"
+#include "curve25519_profile.h"
+#include "curve25519_stats.h"
+#include <sodium.h>
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* curve25519基准测试
+ *   用法: curve25519_bench [--json 文件] [--cpu 编号] [--samples 次数] [--quick] [--rfc1m] [--profile] [--stats]
+ * 每个测试项先预热, 再逐次计时, 统计中位数、p99、均值、标准差和吞吐量。
+ * 标量乘法与libsodium的crypto_scalarmult对比, 并用RFC 7748的迭代向量校验结果;
+ * Ed25519密钥生成、签名和验证与libsodium的crypto_sign对比;
+ * 批量认证加密与crypto_box_easy_afternm对比, 批量数据通道与crypto_aead_chacha20poly1305_ietf对比。
+ * 人类可读的结果写到stderr, JSON写到stdout或--json指定的文件。              */
+
+struct bench_options {
+  const char *json = nullptr;
+  int cpu = -1;             //-1表示绑定到启动时所在的CPU
+  size_t samples = 100;
+  bool quick = false;       //只做少量采样, 用于PGO训练和冒烟测试
+  bool rfc1m = false;       //运行RFC 7748的一百万次迭代向量
+  bool profile = false;     //输出curve25519_donna的内核剖析
+  bool stats = false;       //输出curve25519_donna的运算和内存分配计数
+};
+
+struct bench_result {
+  std::string name;
+  size_t batch;             //一次计时包含的标量乘法个数, 单个运算为1
+  size_t samples;
+  double median_ns, p99_ns, mean_ns, stddev_ns, min_ns;
+  double ops_per_sec;
+  double vs_libsodium;      //相对libsodium对应单次运算的耗时比, 不适用时为0
+};
+
+static std::vector<bench_result> results;
+static double sodium_median_ns = 0;
+static double sodium_sign_median_ns = 0;
+static double sodium_verify_median_ns = 0;
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* 运行一个测试项: 先预热 warmup 次, 再计时 samples 次
+ * batch 为每次调用完成的运算个数, 统计结果折算到单个运算 */
+static bench_result &run(const char *name, size_t batch, size_t warmup, size_t samples,
+                         const std::function<void()> &op) {
+  for (size_t i = 0; i < warmup; ++i) op();
+  std::vector<double> t(samples);
+  for (size_t i = 0; i < samples; ++i) {
+    const uint64_t begin = now_ns();
+    op();
+    t[i] = double(now_ns() - begin) / batch;
+  }
+  std::sort(t.begin(), t.end());
+
+  bench_result r;
+  r.name = name;
+  r.batch = batch;
+  r.samples = samples;
+  r.min_ns = t.front();
+  r.median_ns = samples % 2 ? t[samples / 2] : (t[samples / 2 - 1] + t[samples / 2]) / 2;
+  r.p99_ns = t[std::min(samples - 1, size_t(std::ceil(samples * 0.99)) - 1)];
+  double sum = 0, sq = 0;
+  for (double x : t) sum += x;
+  r.mean_ns = sum / samples;
+  for (double x : t) sq += (x - r.mean_ns) * (x - r.mean_ns);
+  r.stddev_ns = samples > 1 ? std::sqrt(sq / (samples - 1)) : 0;
+  r.ops_per_sec = 1e9 / r.median_ns;
+  r.vs_libsodium = 0;
+  results.push_back(r);
+
+  fprintf(stderr, "%-32s %8zu %12.0f %12.0f %12.0f %10.1f%% %14.1f\n", name, batch, r.median_ns,
+          r.p99_ns, r.mean_ns, r.mean_ns > 0 ? 100 * r.stddev_ns / r.mean_ns : 0, r.ops_per_sec);
+  return results.back();
+}
+
+//标量乘法类的测试项, 记录相对libsodium的耗时比
+static void run_scalarmult(const char *name, size_t batch, size_t warmup, size_t samples,
+                           const std::function<void()> &op) {
+  bench_result &r = run(name, batch, warmup, samples, op);
+  if (sodium_median_ns > 0) r.vs_libsodium = r.median_ns / sodium_median_ns;
+}
+
+//签名和验证类的测试项, 记录相对libsodium对应运算(base_ns)的耗时比
+static void run_vs(double base_ns, const char *name, size_t batch, size_t warmup, size_t samples,
+                   const std::function<void()> &op) {
+  bench_result &r = run(name, batch, warmup, samples, op);
+  if (base_ns > 0) r.vs_libsodium = r.median_ns / base_ns;
+}
+
+/* 从进程的CPU集合中去掉测量用的CPU, 之后创建的SYCL运行时和主机线程池的线程都不在它上面运行;
+ * 只允许一个CPU时无法避开, 集合不变。返回测量用的CPU */
+static int reserve_cpu(int cpu) {
+  if (cpu < 0) cpu = sched_getcpu();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    perror("sched_getaffinity");
+    return -1;
+  }
+  if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &set)) {
+    fprintf(stderr, "CPU %d 不在本进程允许运行的集合中\n", cpu);
+    return -1;
+  }
+  if (CPU_COUNT(&set) > 1) {
+    CPU_CLR(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      perror("sched_setaffinity");
+      return -1;
+    }
+  }
+  return cpu;
+}
+
+static int pin_cpu(int cpu) {
+  if (cpu < 0) return -1;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    perror("sched_setaffinity");
+    return -1;
+  }
+  return cpu;
+}
+
+static int parse_hex(u8 *out, const char *hex) {
+  for (int i = 0; i < 32; ++i) {
+    unsigned v;
+    if (sscanf(hex + 2 * i, "%2x", &v) != 1) return -1;
+    out[i] = static_cast<u8>(v);
+  }
+  return 0;
+}
+
+/* RFC 7748 5.2节的迭代测试: k = u = 9, 每轮 k' = X25519(k, u), u = k
+ * 返回0表示 iterations 轮后的 k 与期望值一致 */
+typedef std::function<int(u8 *, const u8 *, const u8 *)> scalarmult_fn;
+static int rfc7748_iterate(const scalarmult_fn &f, size_t iterations, const char *expect_hex) {
+  u8 k[32] = {9}, u[32] = {9}, r[32], expect[32];
+  for (size_t i = 0; i < iterations; ++i) {
+    f(r, k, u);
+    memcpy(u, k, 32);
+    memcpy(k, r, 32);
+  }
+  parse_hex(expect, expect_hex);
+  return memcmp(k, expect, 32) == 0 ? 0 : -1;
+}
+
+struct rfc_result {
+  std::string engine;
+  size_t iterations;
+  bool passed;
+  double seconds;
+};
+static std::vector<rfc_result> rfc_results;
+
+static void rfc7748(const char *engine, const scalarmult_fn &f, size_t iterations) {
+  static const char *expect_1 = "422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079";
+  static const char *expect_1k = "684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51";
+  static const char *expect_1m = "7c3911e0ab2586fd864497297e575e6f3bc601c0883c30df5f4dd2d24f543424";
+  const char *expect = iterations == 1 ? expect_1 : iterations == 1000 ? expect_1k : expect_1m;
+  const uint64_t begin = now_ns();
+  const bool passed = rfc7748_iterate(f, iterations, expect) == 0;
+  const double seconds = (now_ns() - begin) / 1e9;
+  rfc_results.push_back({engine, iterations, passed, seconds});
+  fprintf(stderr, "RFC 7748 %-20s %8zu次迭代: %s (%.2fs)\n", engine, iterations,
+          passed ? "通过" : "失败", seconds);
+}
+
+static void write_json(FILE *f, int cpu) {
+  fprintf(f, "{\n  \"cpu\": %d,\n  \"libsodium\": \"%s\",\n  \"results\": [\n", cpu,
+          sodium_version_string());
+  for (size_t i = 0; i < results.size(); ++i) {
+    const bench_result &r = results[i];
+    fprintf(f,
+            "    {\"name\": \"%s\", \"batch\": %zu, \"samples\": %zu, \"median_ns\": %.1f, "
+            "\"p99_ns\": %.1f, \"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"min_ns\": %.1f, "
+            "\"ops_per_sec\": %.1f, \"vs_libsodium\": %.3f}%s\n",
+            r.name.c_str(), r.batch, r.samples, r.median_ns, r.p99_ns, r.mean_ns, r.stddev_ns,
+            r.min_ns, r.ops_per_sec, r.vs_libsodium, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ],\n  \"rfc7748\": [\n");
+  for (size_t i = 0; i < rfc_results.size(); ++i) {
+    const rfc_result &r = rfc_results[i];
+    fprintf(f, "    {\"engine\": \"%s\", \"iterations\": %zu, \"passed\": %s, \"seconds\": %.3f}%s\n",
+            r.engine.c_str(), r.iterations, r.passed ? "true" : "false", r.seconds,
+            i + 1 < rfc_results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  bench_options opt;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--json" && i + 1 < argc) opt.json = argv[++i];
+    else if (a == "--cpu" && i + 1 < argc) opt.cpu = atoi(argv[++i]);
+    else if (a == "--samples" && i + 1 < argc) opt.samples = strtoul(argv[++i], nullptr, 10);
+    else if (a == "--quick") opt.quick = true;
+    else if (a == "--rfc1m") opt.rfc1m = true;
+    else if (a == "--profile") opt.profile = true;
+    else if (a == "--stats") opt.stats = true;
+    else {
+      fprintf(stderr, "用法: %s [--json 文件] [--cpu 编号] [--samples 次数] [--quick] [--rfc1m] [--profile] [--stats]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (opt.quick) opt.samples = std::min<size_t>(opt.samples, 5);
+  if (opt.samples == 0) opt.samples = 1;
+  if (sodium_init() < 0) {
+    fprintf(stderr, "libsodium初始化失败\n");
+    return -1;
+  }
+
+  //剖析必须在首次使用全局队列之前开启
+  if (opt.profile && curve25519_profile_enable() != 0) return -1;
+
+  //先把测量用的CPU留出来, 再创建SYCL运行时和主机线程池的工作线程, 最后把主线程绑定到留出的CPU:
+  //工作线程不和主线程争用同一个CPU, 也不会继承单个CPU的亲和性
+  const int reserved = reserve_cpu(opt.cpu);
+  if (curve25519_prewarm() < 0) return -1;
+  curve25519_host_pool();
+  const int cpu = pin_cpu(reserved);
+
+  const size_t samples = opt.samples;
+  const size_t warmup = std::max<size_t>(1, samples / 10);
+  //SYCL逐运算实现的一次标量乘法要提交上万次内核, 采样次数单独限制
+  const size_t slow_samples = std::min<size_t>(samples, opt.quick ? 2 : 10);
+
+  u8 secret[32], basepoint[32] = {9}, out[32];
+  randombytes_buf(secret, 32);
+  const curve25519_primitives *p = curve25519_get_primitives();
+  felem a, b, r;
+  u8 bytes[32];
+  randombytes_buf(bytes, 32);
+  p->fexpand(a, bytes);
+  randombytes_buf(bytes, 32);
+  p->fexpand(b, bytes);
+
+  fprintf(stderr, "%-32s %8s %12s %12s %12s %11s %14s\n", "测试项", "批量", "中位数ns",
+          "p99 ns", "均值ns", "标准差", "每秒次数");
+
+  //有限域和阶梯运算
+  run("fmul", 1, warmup, samples, [&] { p->fmul(r, a, b); });
+  run("fsquare_times(1)", 1, warmup, samples, [&] { p->fsquare_times(r, a, 1); });
+  run("fsquare_times(50)", 1, warmup, samples, [&] { p->fsquare_times(r, a, 50); });
+  run("crecip", 1, 1, slow_samples, [&] { p->crecip(r, a); });
+  run("fmonty", 1, warmup, samples, [&] {
+    //fmonty会修改输入, 每次从相同的输入开始
+    limb x[5], z[5], xp[5], zp[5], x2[5], z2[5], x3[5], z3[5];
+    memcpy(x, a, sizeof(x)); memcpy(z, b, sizeof(z));
+    memcpy(xp, b, sizeof(xp)); memcpy(zp, a, sizeof(zp));
+    p->fmonty(x2, z2, x3, z3, x, z, xp, zp, a);
+  });
+
+  //单次标量乘法, libsodium作为基准
+  sodium_median_ns = run("crypto_scalarmult(libsodium)", 1, warmup, samples,
+                         [&] { crypto_scalarmult(out, secret, basepoint); }).median_ns;
+  results.back().vs_libsodium = 1;
+  run_scalarmult("curve25519_donna_host", 1, warmup, samples,
+                 [&] { curve25519_donna_host(out, secret, basepoint); });
+  curve25519_profile_reset();
+  curve25519_stats_reset();
+  run_scalarmult("curve25519_donna", 1, 1, slow_samples,
+                 [&] { curve25519_donna(out, secret, basepoint); });
+  if (opt.profile) curve25519_profile_dump(stderr);
+  if (opt.stats) curve25519_stats_print(stderr);
+
+  //批量引擎, 每个规模单独统计
+  const size_t sizes[] = {1, 64, 1024, 16384};
+  const size_t max_n = opt.quick ? 64 : sizes[3];
+  std::vector<u8> bs(32 * max_n), bb(32 * max_n), bo(32 * max_n);
+  randombytes_buf(bs.data(), bs.size());
+  for (size_t i = 0; i < max_n; ++i) bb[32 * i] = 9;
+  char name[64];
+  for (size_t n : sizes) {
+    if (n > max_n) break;
+    //大规模批量的单次耗时较长, 采样次数按规模减少
+    const size_t s = std::max<size_t>(3, std::min(samples, samples * 64 / n));
+    snprintf(name, sizeof(name), "curve25519_donna_batch/%zu", n);
+    run_scalarmult(name, n, 1, s, [&] { curve25519_donna_batch(bo.data(), bs.data(), bb.data(), n); });
+    snprintf(name, sizeof(name), "curve25519_donna_batch_sycl/%zu", n);
+    run_scalarmult(name, n, 1, s, [&] { curve25519_donna_batch_sycl(bo.data(), bs.data(), bb.data(), n); });
+    snprintf(name, sizeof(name), "curve25519_donna_host_batch/%zu", n);
+    run_scalarmult(name, n, 1, s,
+                   [&] { curve25519_donna_host_batch(nullptr, bo.data(), bs.data(), bb.data(), n); });
+    snprintf(name, sizeof(name), "crypto_scalarmult_loop/%zu", n);
+    run_scalarmult(name, n, 1, s, [&] {
+      for (size_t i = 0; i < n; ++i) crypto_scalarmult(&bo[32 * i], &bs[32 * i], &bb[32 * i]);
+    });
+  }
+
+  //Ed25519: 单次签名和密钥生成, 以及同一私钥的批量签名, 消息为握手记录大小的64字节
+  u8 seed[32], sign_pk[32], sign_sk[64], sig[64];
+  unsigned long long siglen;
+  randombytes_buf(seed, 32);
+  crypto_sign_seed_keypair(sign_pk, sign_sk, seed);
+  std::vector<u8> msgs(64 * max_n), sigs(64 * max_n);
+  std::vector<const u8 *> msg_ptr(max_n);
+  std::vector<size_t> msg_len(max_n, 64);
+  randombytes_buf(msgs.data(), msgs.size());
+  for (size_t i = 0; i < max_n; ++i) msg_ptr[i] = &msgs[64 * i];
+  sodium_sign_median_ns = run("crypto_sign_detached(libsodium)", 1, warmup, samples, [&] {
+    crypto_sign_detached(sig, &siglen, msgs.data(), 64, sign_sk);
+  }).median_ns;
+  results.back().vs_libsodium = 1;
+  run_vs(sodium_sign_median_ns, "curve25519_ed25519_sign", 1, warmup, samples,
+           [&] { curve25519_ed25519_sign(sig, msgs.data(), 64, sign_sk); });
+  run_vs(sodium_sign_median_ns, "crypto_sign_seed_keypair", 1, warmup, samples,
+           [&] { crypto_sign_seed_keypair(sign_pk, sign_sk, seed); });
+  run_vs(sodium_sign_median_ns, "curve25519_ed25519_keypair", 1, warmup, samples,
+           [&] { curve25519_ed25519_keypair(sign_pk, sign_sk, seed); });
+  for (size_t n : sizes) {
+    if (n > max_n) break;
+    const size_t s = std::max<size_t>(3, std::min(samples, samples * 64 / n));
+    snprintf(name, sizeof(name), "curve25519_ed25519_sign_batch/%zu", n);
+    run_vs(sodium_sign_median_ns, name, n, 1, s, [&] {
+      curve25519_ed25519_sign_batch(nullptr, sigs.data(), msg_ptr.data(), msg_len.data(), sign_sk, 0, n);
+    });
+    snprintf(name, sizeof(name), "crypto_sign_detached_loop/%zu", n);
+    run_vs(sodium_sign_median_ns, name, n, 1, s, [&] {
+      for (size_t i = 0; i < n; ++i) crypto_sign_detached(&sigs[64 * i], &siglen, msg_ptr[i], 64, sign_sk);
+    });
+  }
+
+  //Ed25519验证: 批量验证分别用线程池和SYCL完成多标量乘法
+  sodium_verify_median_ns = run("crypto_sign_verify_detached(libsodium)", 1, warmup, samples, [&] {
+    crypto_sign_verify_detached(sigs.data(), msgs.data(), 64, sign_pk);
+  }).median_ns;
+  results.back().vs_libsodium = 1;
+  run_vs(sodium_verify_median_ns, "curve25519_ed25519_verify", 1, warmup, samples,
+         [&] { curve25519_ed25519_verify(sigs.data(), msgs.data(), 64, sign_pk); });
+  for (size_t n : sizes) {
+    if (n > max_n) break;
+    const size_t s = std::max<size_t>(3, std::min(samples, samples * 64 / n));
+    snprintf(name, sizeof(name), "curve25519_ed25519_verify_batch/%zu", n);
+    run_vs(sodium_verify_median_ns, name, n, 1, s, [&] {
+      curve25519_ed25519_verify_batch(nullptr, sigs.data(), msg_ptr.data(), msg_len.data(), sign_pk, 0, n,
+                                      nullptr, false);
+    });
+    snprintf(name, sizeof(name), "curve25519_ed25519_verify_batch_sycl/%zu", n);
+    run_vs(sodium_verify_median_ns, name, n, 1, s, [&] {
+      curve25519_ed25519_verify_batch(nullptr, sigs.data(), msg_ptr.data(), msg_len.data(), sign_pk, 0, n,
+                                      nullptr, true);
+    });
+    snprintf(name, sizeof(name), "crypto_sign_verify_detached_loop/%zu", n);
+    run_vs(sodium_verify_median_ns, name, n, 1, s, [&] {
+      for (size_t i = 0; i < n; ++i) crypto_sign_verify_detached(&sigs[64 * i], msg_ptr[i], 64, sign_pk);
+    });
+  }
+
+  //批量认证加密: 每条记录独立的共享密钥和nonce, 消息为64字节的握手记录和1KiB的数据记录
+  std::vector<u8> box_keys(32 * max_n), box_nonces(24 * max_n);
+  randombytes_buf(box_keys.data(), box_keys.size());
+  randombytes_buf(box_nonces.data(), box_nonces.size());
+  for (size_t len : {size_t(64), size_t(1024)}) {
+    std::vector<u8> box_m(len * max_n), box_c((len + 16) * max_n);
+    std::vector<const u8 *> m_ptr(max_n);
+    std::vector<u8 *> c_ptr(max_n);
+    std::vector<size_t> m_len(max_n, len);
+    randombytes_buf(box_m.data(), box_m.size());
+    for (size_t i = 0; i < max_n; ++i) {
+      m_ptr[i] = &box_m[len * i];
+      c_ptr[i] = &box_c[(len + 16) * i];
+    }
+    snprintf(name, sizeof(name), "crypto_box_easy_afternm(libsodium)/%zuB", len);
+    const double box_ns = run(name, 1, warmup, samples, [&] {
+      crypto_box_easy_afternm(c_ptr[0], m_ptr[0], len, box_nonces.data(), box_keys.data());
+    }).median_ns;
+    results.back().vs_libsodium = 1;
+    for (size_t n : sizes) {
+      if (n > max_n) break;
+      const size_t s = std::max<size_t>(3, std::min(samples, samples * 64 / n));
+      snprintf(name, sizeof(name), "curve25519_box_encrypt_batch/%zuB/%zu", len, n);
+      run_vs(box_ns, name, n, 1, s, [&] {
+        curve25519_box_encrypt_batch(nullptr, c_ptr.data(), m_ptr.data(), m_len.data(), box_nonces.data(),
+                                     box_keys.data(), 32, n, false);
+      });
+      snprintf(name, sizeof(name), "curve25519_box_encrypt_batch_sycl/%zuB/%zu", len, n);
+      run_vs(box_ns, name, n, 1, s, [&] {
+        curve25519_box_encrypt_batch(nullptr, c_ptr.data(), m_ptr.data(), m_len.data(), box_nonces.data(),
+                                     box_keys.data(), 32, n, true);
+      });
+      snprintf(name, sizeof(name), "crypto_box_easy_afternm_loop/%zuB/%zu", len, n);
+      run_vs(box_ns, name, n, 1, s, [&] {
+        for (size_t i = 0; i < n; ++i) {
+          crypto_box_easy_afternm(c_ptr[i], m_ptr[i], len, &box_nonces[24 * i], &box_keys[32 * i]);
+        }
+      });
+    }
+  }
+
+  //批量数据通道: ChaCha20-Poly1305与libsodium的IETF版本对比, 大记录的采样次数按长度减少
+  u8 aead_key[32], aead_nonce[12];
+  randombytes_buf(aead_key, sizeof(aead_key));
+  randombytes_buf(aead_nonce, sizeof(aead_nonce));
+  for (size_t len : {size_t(1024), size_t(65536), size_t(1) << 20}) {
+    std::vector<u8> am(len), ac(len + 16);
+    unsigned long long aclen;
+    randombytes_buf(am.data(), len);
+    const size_t s = std::max<size_t>(3, std::min(samples, samples * 65536 / len));
+    snprintf(name, sizeof(name), "crypto_aead_chacha20poly1305_ietf_encrypt/%zuB", len);
+    const double aead_ns = run(name, 1, 1, s, [&] {
+      crypto_aead_chacha20poly1305_ietf_encrypt(ac.data(), &aclen, am.data(), len, nullptr, 0, nullptr, aead_nonce,
+                                                aead_key);
+    }).median_ns;
+    results.back().vs_libsodium = 1;
+    snprintf(name, sizeof(name), "curve25519_aead_encrypt(%s)/%zuB", curve25519_aead_engine(), len);
+    run_vs(aead_ns, name, 1, 1, s,
+           [&] { curve25519_aead_encrypt(ac.data(), am.data(), len, nullptr, 0, aead_nonce, aead_key); });
+    snprintf(name, sizeof(name), "curve25519_aead_decrypt(%s)/%zuB", curve25519_aead_engine(), len);
+    run_vs(aead_ns, name, 1, 1, s,
+           [&] { curve25519_aead_decrypt(am.data(), ac.data(), len + 16, nullptr, 0, aead_nonce, aead_key); });
+  }
+
+  //RFC 7748迭代向量: 逐运算的SYCL实现太慢, 只验证第1轮; 其余引擎验证1000轮
+  const scalarmult_fn sodium = [](u8 *q, const u8 *n, const u8 *pt) { return crypto_scalarmult(q, n, pt); };
+  const scalarmult_fn host = curve25519_donna_host;
+  const scalarmult_fn donna = curve25519_donna;
+  rfc7748("curve25519_donna", donna, 1);
+  rfc7748("curve25519_donna_host", host, opt.quick ? 1 : 1000);
+  rfc7748("crypto_scalarmult", sodium, opt.quick ? 1 : 1000);
+  if (opt.rfc1m) {
+    rfc7748("curve25519_donna_host", host, 1000000);
+    rfc7748("crypto_scalarmult", sodium, 1000000);
+  }
+
+  FILE *f = stdout;
+  if (opt.json != nullptr && (f = fopen(opt.json, "w")) == nullptr) {
+    perror("fopen");
+    return -1;
+  }
+  write_json(f, cpu);
+  if (f != stdout) fclose(f);
+
+  for (const rfc_result &r : rfc_results) {
+    if (!r.passed) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,511 @@
+#if defined(__GNUC__) && !defined(__clang__)
+//box_vec只在本文件的静态函数之间传递, 不受向量参数ABI变化的影响
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+#include "curve25519_box.h"
+#include "curve25519_secretbox.h"
+#include "curve25519_host.h"
+#include "curve25519_runtime.h"
+#include "curve25519_stats.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+//主机端一组同时计算的记录数, 即向量的元素个数
+#define BOX_LANES 8
+//每个任务块的组数上限
+#define BOX_CHUNK 16
+//不超过这个数的记录不值得补满一组, 逐条计算
+#define BOX_SCALAR_LANES 2
+//总长度小于这个字节数的批次在调用线程上完成, 分发到线程池的开销比计算还大
+#define BOX_INLINE_BYTES 16384
+
+using namespace sycl;
+
+//BOX_LANES个uint32_t组成的向量; 主机代码没有指定-march, x86-64上按两个128位SSE2寄存器计算
+typedef uint32_t box_vec __attribute__((vector_size(4 * BOX_LANES)));
+
+//一组记录的子密钥和nonce后8字节, 每个lane对应一条记录
+struct box_lanes {
+  size_t count;         //有效的lane数, 其余lane重复第0条记录, 结果丢弃
+  box_vec subkey[8];
+  box_vec nonce2[2];
+};
+
+//8条记录的HSalsa20同时计算
+static void lanes_setup(box_lanes *g, const u8 *const *nonces, const u8 *const *keys, size_t count) {
+  box_vec k[8], in[4];
+  g->count = count;
+  for (size_t lane = 0; lane < BOX_LANES; ++lane) {
+    const size_t l = lane < count ? lane : 0;
+    for (int i = 0; i < 8; ++i) k[i][lane] = sb_load32(keys[l] + 4 * i);
+    for (int i = 0; i < 4; ++i) in[i][lane] = sb_load32(nonces[l] + 4 * i);
+    for (int i = 0; i < 2; ++i) g->nonce2[i][lane] = sb_load32(nonces[l] + 16 + 4 * i);
+  }
+  hsalsa20<box_vec>(g->subkey, k, in);
+  sodium_memzero(k, sizeof(k));
+}
+
+//各lane密钥流的第counter个64字节块, x[i][lane]为第lane条记录的第i个字
+static void lanes_block(const box_lanes *g, uint64_t counter, box_vec x[16]) {
+  const box_vec in[4] = {g->nonce2[0], g->nonce2[1], box_vec{} + uint32_t(counter),
+                         box_vec{} + uint32_t(counter >> 32)};
+  salsa20_block<box_vec>(x, g->subkey, in);
+}
+
+//第0块的前32字节为第lane条记录的Poly1305密钥
+static void lanes_poly_key(const box_vec block0[16], size_t lane, u8 key[32]) {
+  for (int i = 0; i < 8; ++i) sb_store32(key + 4 * i, block0[i][lane]);
+}
+
+/* 密钥流跳过前32字节(Poly1305密钥)后与 in[lane] 异或写入 out[lane], out为空指针的lane跳过
+ * 下面的 s 是密钥流中的位置, 对应记录中的第 s - 32 字节
+ * block0 为已经算出的第0块; 按字异或, 只有记录末尾不足4字节的部分逐字节处理 */
+static void lanes_xor(const box_lanes *g, u8 *const out[], const u8 *const in[], const size_t len[],
+                      const box_vec block0[16]) {
+  size_t max_len = 0;
+  for (size_t lane = 0; lane < g->count; ++lane) {
+    if (out[lane] != nullptr) max_len = std::max(max_len, len[lane]);
+  }
+  box_vec ks[16];
+  for (uint64_t counter = 0; 64 * counter < max_len + 32; ++counter) {
+    if (counter > 0) lanes_block(g, counter, ks);
+    const box_vec *block = counter == 0 ? block0 : ks;
+    const size_t begin = 64 * counter;   //本块在密钥流中的位置
+    for (size_t lane = 0; lane < g->count; ++lane) {
+      if (out[lane] == nullptr) continue;
+      const u8 *src = in[lane];
+      u8 *dst = out[lane];
+      const size_t to = std::min(begin + 64, len[lane] + 32);
+      size_t s = std::max<size_t>(begin, 32);
+      for (; s + 4 <= to; s += 4) sb_store32(dst + (s - 32), sb_load32(src + (s - 32)) ^ block[(s - begin) / 4][lane]);
+      for (; s < to; ++s) dst[s - 32] = src[s - 32] ^ u8(block[(s - begin) / 4][lane] >> (8 * (s % 4)));
+    }
+  }
+  sodium_memzero(ks, sizeof(ks));
+}
+
+/* 主机端的Poly1305: 44/44/42位三个limb, 乘法用128位整数, 每16字节的乘法次数比
+ * curve25519_secretbox.h 中内核可用的26位limb实现少一半以上 */
+static inline uint64_t box_load64(const u8 *p) {
+  return uint64_t(sb_load32(p)) | (uint64_t(sb_load32(p + 4)) << 32);
+}
+
+static void poly1305_auth64(u8 *mac, const u8 *m, size_t len, const u8 *key) {
+  typedef unsigned __int128 u128;
+  const uint64_t m44 = 0xfffffffffff, m42 = 0x3ffffffffff;
+  const uint64_t t0 = box_load64(key), t1 = box_load64(key + 8);
+  const uint64_t r0 = t0 & 0xffc0fffffff, r1 = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffff,
+                 r2 = (t1 >> 24) & 0x00ffffffc0f;
+  const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+  uint64_t h0 = 0, h1 = 0, h2 = 0;
+  u8 last[16];
+  while (len > 0) {
+    const u8 *block = m;
+    uint64_t hibit = uint64_t(1) << 40;
+    if (len < 16) {   //最后不足16字节的块补1和0
+      memset(last, 0, sizeof(last));
+      memcpy(last, m, len);
+      last[len] = 1;
+      block = last;
+      hibit = 0;
+    }
+    const uint64_t b0 = box_load64(block), b1 = box_load64(block + 8);
+    h0 += b0 & m44;
+    h1 += ((b0 >> 44) | (b1 << 20)) & m44;
+    h2 += ((b1 >> 24) & m42) | hibit;
+    const u128 d0 = u128(h0) * r0 + u128(h1) * s2 + u128(h2) * s1;
+    u128 d1 = u128(h0) * r1 + u128(h1) * r0 + u128(h2) * s2;
+    u128 d2 = u128(h0) * r2 + u128(h1) * r1 + u128(h2) * r0;
+    uint64_t c = uint64_t(d0 >> 44);
+    h0 = uint64_t(d0) & m44;
+    d1 += c;
+    c = uint64_t(d1 >> 44);
+    h1 = uint64_t(d1) & m44;
+    d2 += c;
+    c = uint64_t(d2 >> 42);
+    h2 = uint64_t(d2) & m42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= m44;
+    h1 += c;
+    const size_t step = len < 16 ? len : 16;
+    m += step;
+    len -= step;
+  }
+
+  //完全进位, 再减去p = 2^130 - 5(如果不小于p)
+  uint64_t c = h1 >> 44;
+  h1 &= m44;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= m42;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= m44;
+  h1 += c;
+  c = h1 >> 44;
+  h1 &= m44;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= m42;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= m44;
+  h1 += c;
+  uint64_t g0 = h0 + 5;
+  c = g0 >> 44;
+  g0 &= m44;
+  uint64_t g1 = h1 + c;
+  c = g1 >> 44;
+  g1 &= m44;
+  uint64_t g2 = h2 + c - (uint64_t(1) << 42);
+  uint64_t mask = (g2 >> 63) - 1;
+  h0 = (h0 & ~mask) | (g0 & mask);
+  h1 = (h1 & ~mask) | (g1 & mask);
+  h2 = (h2 & ~mask) | (g2 & mask);
+
+  //加上s
+  const uint64_t p0 = box_load64(key + 16), p1 = box_load64(key + 24);
+  h0 += p0 & m44;
+  c = h0 >> 44;
+  h0 &= m44;
+  h1 += (((p0 >> 44) | (p1 << 20)) & m44) + c;
+  c = h1 >> 44;
+  h1 &= m44;
+  h2 += ((p1 >> 24) & m42) + c;
+  h2 &= m42;
+  const uint64_t out0 = h0 | (h1 << 44), out1 = (h1 >> 20) | (h2 << 24);
+  for (int i = 0; i < 8; ++i) {
+    mac[i] = u8(out0 >> (8 * i));
+    mac[8 + i] = u8(out1 >> (8 * i));
+  }
+  sodium_memzero(last, sizeof(last));
+}
+
+//逐条加密一条记录, 与 secretbox_item 相同, 只是换用64位limb的Poly1305
+static void encrypt_one(u8 *c, const u8 *m, size_t mlen, const u8 *n, const u8 *k) {
+  uint32_t subkey[8];
+  u8 poly_key[32];
+  secretbox_keys(subkey, poly_key, n, k);
+  xsalsa20_xor(c + SECRETBOX_MACBYTES, m, mlen, subkey, n + 16, 32);
+  poly1305_auth64(c, c + SECRETBOX_MACBYTES, mlen, poly_key);
+  sodium_memzero(subkey, sizeof(subkey));
+  sodium_memzero(poly_key, sizeof(poly_key));
+}
+
+//逐条解密一条记录, 验证通过返回1
+static int decrypt_one(u8 *m, const u8 *c, size_t clen, const u8 *n, const u8 *k) {
+  uint32_t subkey[8];
+  u8 poly_key[32], mac[SECRETBOX_MACBYTES];
+  secretbox_keys(subkey, poly_key, n, k);
+  poly1305_auth64(mac, c + SECRETBOX_MACBYTES, clen - SECRETBOX_MACBYTES, poly_key);
+  const int ok = secretbox_mac_equal(mac, c);
+  if (ok) xsalsa20_xor(m, c + SECRETBOX_MACBYTES, clen - SECRETBOX_MACBYTES, subkey, n + 16, 32);
+  sodium_memzero(subkey, sizeof(subkey));
+  sodium_memzero(poly_key, sizeof(poly_key));
+  return ok;
+}
+
+//加密一组记录, idx为这组记录的下标
+static void encrypt_group(u8 *const *c, const u8 *const *m, const size_t *mlen, const u8 *nonce, const u8 *key,
+                          size_t key_stride, const size_t *idx, size_t count) {
+  if (count <= BOX_SCALAR_LANES) {
+    for (size_t lane = 0; lane < count; ++lane) {
+      const size_t i = idx[lane];
+      encrypt_one(c[i], m[i], mlen[i], nonce + 24 * i, key + key_stride * i);
+    }
+    return;
+  }
+  const u8 *np[BOX_LANES], *kp[BOX_LANES], *in[BOX_LANES];
+  u8 *out[BOX_LANES];
+  size_t len[BOX_LANES];
+  for (size_t lane = 0; lane < count; ++lane) {
+    const size_t i = idx[lane];
+    np[lane] = nonce + 24 * i;
+    kp[lane] = key + key_stride * i;
+    in[lane] = m[i];
+    out[lane] = c[i] + SECRETBOX_MACBYTES;
+    len[lane] = mlen[i];
+  }
+  box_lanes g;
+  box_vec block0[16];
+  u8 poly_key[32];
+  lanes_setup(&g, np, kp, count);
+  lanes_block(&g, 0, block0);
+  lanes_xor(&g, out, in, len, block0);
+  for (size_t lane = 0; lane < count; ++lane) {
+    lanes_poly_key(block0, lane, poly_key);
+    poly1305_auth64(c[idx[lane]], out[lane], len[lane], poly_key);
+  }
+  sodium_memzero(block0, sizeof(block0));
+  sodium_memzero(poly_key, sizeof(poly_key));
+  sodium_memzero(&g, sizeof(g));
+}
+
+//解密一组记录: 先用第0块的前32字节验证MAC, 只解密通过的记录
+static void decrypt_group(u8 *const *m, const u8 *const *c, const size_t *clen, const u8 *nonce, const u8 *key,
+                          size_t key_stride, const size_t *idx, size_t count, int *result) {
+  if (count <= BOX_SCALAR_LANES) {
+    for (size_t lane = 0; lane < count; ++lane) {
+      const size_t i = idx[lane];
+      result[i] = decrypt_one(m[i], c[i], clen[i], nonce + 24 * i, key + key_stride * i);
+    }
+    return;
+  }
+  const u8 *np[BOX_LANES], *kp[BOX_LANES], *in[BOX_LANES];
+  u8 *out[BOX_LANES];
+  size_t len[BOX_LANES];
+  for (size_t lane = 0; lane < count; ++lane) {
+    const size_t i = idx[lane];
+    np[lane] = nonce + 24 * i;
+    kp[lane] = key + key_stride * i;
+    in[lane] = c[i] + SECRETBOX_MACBYTES;
+    len[lane] = clen[i] - SECRETBOX_MACBYTES;
+  }
+  box_lanes g;
+  box_vec block0[16];
+  u8 poly_key[32], mac[SECRETBOX_MACBYTES];
+  lanes_setup(&g, np, kp, count);
+  lanes_block(&g, 0, block0);
+  for (size_t lane = 0; lane < count; ++lane) {
+    lanes_poly_key(block0, lane, poly_key);
+    poly1305_auth64(mac, in[lane], len[lane], poly_key);
+    result[idx[lane]] = secretbox_mac_equal(mac, c[idx[lane]]);
+    out[lane] = result[idx[lane]] ? m[idx[lane]] : nullptr;
+  }
+  lanes_xor(&g, out, in, len, block0);
+  sodium_memzero(block0, sizeof(block0));
+  sodium_memzero(poly_key, sizeof(poly_key));
+  sodium_memzero(&g, sizeof(g));
+}
+
+/* 主机端: 按长度排序, 让同一组的记录需要的块数相近, 再把各组分到线程池上
+ * result 为空时加密, 否则解密并写入每条记录的结果 */
+static void box_host(host_pool *pool, u8 *const *out, const u8 *const *in, const size_t *len, const u8 *nonce,
+                     const u8 *key, size_t key_stride, size_t n, int *result) {
+  std::vector<size_t> order(n);
+  size_t total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    order[i] = i;
+    total += len[i] + 64;   //每条记录另有约一个块的HSalsa20和密钥计算
+  }
+  std::stable_sort(order.begin(), order.end(), [len](size_t a, size_t b) { return len[a] < len[b]; });
+
+  const size_t groups = (n + BOX_LANES - 1) / BOX_LANES;
+  const auto run_groups = [&](size_t begin, size_t end, size_t) {
+    for (size_t gi = begin; gi < end; ++gi) {
+      const size_t first = gi * BOX_LANES, count = std::min<size_t>(BOX_LANES, n - first);
+      if (result == nullptr) {
+        encrypt_group(out, in, len, nonce, key, key_stride, &order[first], count);
+      } else {
+        decrypt_group(out, in, len, nonce, key, key_stride, &order[first], count, result);
+      }
+    }
+  };
+  if (total < BOX_INLINE_BYTES) {
+    run_groups(0, groups, 0);
+    return;
+  }
+  size_t chunk = groups / (host_pool_size(pool) * 4);
+  if (chunk == 0) chunk = 1;
+  if (chunk > BOX_CHUNK) chunk = BOX_CHUNK;
+  host_pool_parallel_for(pool, groups, chunk, run_groups);
+}
+
+/* SYCL: 输入打包到USM, 每条记录一个work-item; 失败返回-1, 由调用者改用主机端
+ * result 为空时加密, 否则解密并写入每条记录的结果 */
+static int box_sycl(u8 *const *out, const u8 *const *in, const size_t *len, const u8 *nonce, const u8 *key,
+                    size_t key_stride, size_t n, int *result) {
+  const bool encrypt = result == nullptr;
+  const size_t keys = key_stride == 0 ? 1 : n;
+  //in_off[i], out_off[i], len[i], 各n个
+  std::vector<size_t> meta(3 * n);
+  size_t in_total = 0, out_total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const size_t out_len = encrypt ? len[i] + SECRETBOX_MACBYTES : len[i] - SECRETBOX_MACBYTES;
+    meta[i] = in_total;
+    meta[n + i] = out_total;
+    meta[2 * n + i] = len[i];
+    in_total += len[i];
+    out_total += out_len;
+  }
+  const size_t bytes = in_total + out_total + 24 * n + 32 * keys;
+
+  queue &q = curve25519_queue();
+  u8 *buf = nullptr;
+  size_t *dev_meta = nullptr;
+  int *dev_result = nullptr;
+  int ret = 0;
+  try {
+    buf = malloc_shared<u8>(bytes, q);
+    dev_meta = malloc_shared<size_t>(3 * n, q);
+    dev_result = malloc_shared<int>(n, q);
+    CURVE25519_COUNT_USM(bytes + 3 * n * sizeof(size_t) + n * sizeof(int));
+    if (buf == nullptr || dev_meta == nullptr || dev_result == nullptr) {
+      ret = -1;
+    } else {
+      u8 *in_buf = buf, *out_buf = buf + in_total, *nonces = out_buf + out_total, *keybuf = nonces + 24 * n;
+      for (size_t i = 0; i < n; ++i) memcpy(in_buf + meta[i], in[i], len[i]);
+      memcpy(nonces, nonce, 24 * n);
+      memcpy(keybuf, key, 32 * keys);
+      memcpy(dev_meta, meta.data(), 3 * n * sizeof(size_t));
+      const size_t stride = key_stride == 0 ? 0 : 32;
+      event e = q.parallel_for(range<1>{n}, [=](id<1> idx) {
+        const size_t i = idx[0];
+        const u8 *src = in_buf + dev_meta[i];
+        u8 *dst = out_buf + dev_meta[n + i];
+        if (encrypt) {
+          secretbox_item(dst, src, dev_meta[2 * n + i], nonces + 24 * i, keybuf + stride * i);
+          dev_result[i] = 1;
+        } else {
+          dev_result[i] = secretbox_open_item(dst, src, dev_meta[2 * n + i], nonces + 24 * i, keybuf + stride * i) == 0;
+        }
+      });
+      CURVE25519_COUNT(C25519_SUBMIT, 1);
+      e.wait();
+      CURVE25519_COUNT(C25519_WAIT, 1);
+      for (size_t i = 0; i < n; ++i) {
+        const size_t out_len = encrypt ? len[i] + SECRETBOX_MACBYTES : len[i] - SECRETBOX_MACBYTES;
+        if (dev_result[i]) memcpy(out[i], out_buf + meta[n + i], out_len);
+        if (!encrypt) result[i] = dev_result[i];
+      }
+    }
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "SYCL批量加解密失败: %s\n", ex.what());
+    ret = -1;
+  }
+  if (buf != nullptr) {
+    sodium_memzero(buf, bytes);   //清除密钥和明文副本
+    free(buf, q);
+  }
+  if (dev_meta != nullptr) free(dev_meta, q);
+  if (dev_result != nullptr) free(dev_result, q);
+  return ret;
+}
+
+int curve25519_box_encrypt_batch(host_pool *pool, u8 *const *c, const u8 *const *m, const size_t *mlen,
+                                 const u8 *nonce, const u8 *key, size_t key_stride, size_t n, bool sycl) {
+  if (n == 0) return 0;
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_perf_scope perf("curve25519_box_encrypt_batch", n);
+  CURVE25519_TRACE_SCOPE("curve25519_box_encrypt_batch");
+  if (!sycl || box_sycl(c, m, mlen, nonce, key, key_stride, n, nullptr) != 0) {
+    box_host(pool, c, m, mlen, nonce, key, key_stride, n, nullptr);
+  }
+  CURVE25519_COUNT(C25519_BOX, n);
+  return 0;
+}
+
+int curve25519_box_decrypt_batch(host_pool *pool, u8 *const *m, const u8 *const *c, const size_t *clen,
+                                 const u8 *nonce, const u8 *key, size_t key_stride, size_t n, int *valid,
+                                 bool sycl) {
+  if (n == 0) return 0;
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_perf_scope perf("curve25519_box_decrypt_batch", n);
+  CURVE25519_TRACE_SCOPE("curve25519_box_decrypt_batch");
+
+  //比MAC还短的记录直接判为无效, 其余记录参与批量计算
+  std::vector<int> result(n, 0);
+  std::vector<size_t> pos;
+  for (size_t i = 0; i < n; ++i) {
+    if (clen[i] >= SECRETBOX_MACBYTES) pos.push_back(i);
+  }
+  if (!pos.empty()) {
+    const size_t k = pos.size();
+    std::vector<u8 *> out(k);
+    std::vector<const u8 *> in(k);
+    std::vector<size_t> len(k);
+    std::vector<u8> nonces(24 * k), keys(key_stride == 0 ? 32 : 32 * k);
+    std::vector<int> sub(k);
+    for (size_t j = 0; j < k; ++j) {
+      out[j] = m[pos[j]];
+      in[j] = c[pos[j]];
+      len[j] = clen[pos[j]];
+      memcpy(&nonces[24 * j], nonce + 24 * pos[j], 24);
+      if (key_stride != 0) memcpy(&keys[32 * j], key + key_stride * pos[j], 32);
+    }
+    if (key_stride == 0) memcpy(keys.data(), key, 32);
+    const size_t stride = key_stride == 0 ? 0 : 32;
+    if (!sycl || box_sycl(out.data(), in.data(), len.data(), nonces.data(), keys.data(), stride, k, sub.data()) != 0) {
+      box_host(pool, out.data(), in.data(), len.data(), nonces.data(), keys.data(), stride, k, sub.data());
+    }
+    for (size_t j = 0; j < k; ++j) result[pos[j]] = sub[j];
+    sodium_memzero(keys.data(), keys.size());
+  }
+
+  int ret = 0;
+  size_t opened = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (!result[i]) ret = -1;
+    if (valid != nullptr) valid[i] = result[i];
+    opened += result[i];
+  }
+  CURVE25519_COUNT(C25519_BOX, opened);
+  return ret;
+}
+
+//测试样例14: 批量加密的输出与crypto_box_easy_afternm逐字节一致, 批量解密能拒绝被篡改的记录
+int test14() {
+  const size_t n = 53;
+  std::vector<std::vector<u8>> msg(n), cipher(n), plain(n);
+  std::vector<u8 *> c(n), p(n);
+  std::vector<const u8 *> m(n), cc(n);
+  std::vector<size_t> mlen(n), clen(n);
+  std::vector<u8> nonce(24 * n), key(32 * n);
+  std::vector<int> valid(n);
+  for (size_t i = 0; i < 24 * n; ++i) nonce[i] = static_cast<u8>(i * 17 + 1);
+  for (size_t i = 0; i < 32 * n; ++i) key[i] = static_cast<u8>(i * 29 + 3);
+  for (size_t i = 0; i < n; ++i) {
+    mlen[i] = (i * 37) % 300;    //包括空消息和跨多个块的消息
+    if (i + 3 >= n) mlen[i] = size_t(1024) << (i + 3 - n);   //总长度超过BOX_INLINE_BYTES, 走线程池
+    msg[i].resize(mlen[i] + 1);
+    for (size_t j = 0; j < mlen[i]; ++j) msg[i][j] = static_cast<u8>(i + j * 7);
+    cipher[i].resize(mlen[i] + SECRETBOX_MACBYTES);
+    plain[i].resize(mlen[i] + 1);
+    m[i] = msg[i].data();
+    c[i] = cipher[i].data();
+    cc[i] = cipher[i].data();
+    p[i] = plain[i].data();
+    clen[i] = mlen[i] + SECRETBOX_MACBYTES;
+  }
+
+  host_pool *pool = host_pool_create(3, 0, false);
+  bool ok = true;
+  std::vector<u8> expect(4096 + SECRETBOX_MACBYTES);
+  for (int use_sycl = 0; use_sycl < 2 && ok; ++use_sycl) {
+    //只有2条记录时主机端逐条计算
+    for (size_t batch : {n, size_t(2)}) {
+      for (size_t key_stride : {size_t(32), size_t(0)}) {
+        ok = ok && curve25519_box_encrypt_batch(pool, c.data(), m.data(), mlen.data(), nonce.data(), key.data(),
+                                                key_stride, batch, use_sycl) == 0;
+        for (size_t i = 0; i < batch && ok; ++i) {
+          crypto_box_easy_afternm(expect.data(), m[i], mlen[i], &nonce[24 * i], &key[key_stride * i]);
+          ok = memcmp(expect.data(), c[i], clen[i]) == 0;
+        }
+        ok = ok && curve25519_box_decrypt_batch(pool, p.data(), cc.data(), clen.data(), nonce.data(), key.data(),
+                                                key_stride, batch, valid.data(), use_sycl) == 0;
+        for (size_t i = 0; i < batch && ok; ++i) ok = valid[i] == 1 && memcmp(p[i], m[i], mlen[i]) == 0;
+      }
+    }
+    //篡改一条记录的MAC和另一条记录的密文
+    cipher[5][3] ^= 1;
+    cipher[40][SECRETBOX_MACBYTES + 1] ^= 0x80;
+    plain[5][0] = plain[40][0] = 0xaa;
+    ok = ok && curve25519_box_decrypt_batch(pool, p.data(), cc.data(), clen.data(), nonce.data(), key.data(), 0,
+                                            n, valid.data(), use_sycl) == -1;
+    for (size_t i = 0; i < n && ok; ++i) ok = valid[i] == (i != 5 && i != 40);
+    ok = ok && plain[5][0] == 0xaa && plain[40][0] == 0xaa;   //验证失败的记录不写入明文
+  }
+  host_pool_destroy(pool);
+  if (!ok) {
+    fprintf(stderr, "批量认证加密结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "批量认证加密结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "host_pool.h"
+
+typedef uint8_t u8;
+
+/* 批量认证加密: 一次调用处理N条独立的(密钥, nonce, 消息)记录, 算法为XSalsa20-Poly1305,
+ * 每条记录的输出与 crypto_box_easy_afternm / crypto_box_open_easy_afternm 相同。
+ * 密钥是crypto_box_beforenm得到的32字节共享密钥, nonce为24字节。
+ * sycl 为false时在线程池 pool(空指针为默认线程池)上计算, 记录按长度排序后每8条一组,
+ * 用向量指令同时生成8条记录的密钥流, 总长度较小的批次直接在调用线程上完成;
+ * 为true时每条记录由一个work-item完成, SYCL出错时改用主机端。                */
+
+/* 批量加密: 第i条记录用密钥 key + key_stride*i 和 nonce + 24*i 加密 m[i](长度 mlen[i]),
+ * 写入 c[i], 长度 mlen[i] + 16。所有记录用同一密钥时 key_stride 传0, 否则传32; 成功返回0 */
+int curve25519_box_encrypt_batch(host_pool *pool, u8 *const *c, const u8 *const *m, const size_t *mlen,
+                                 const u8 *nonce, const u8 *key, size_t key_stride, size_t n, bool sycl);
+
+/* 批量解密: c[i](长度 clen[i])解密后写入 m[i], 长度 clen[i] - 16; 验证失败的记录不写入明文
+ * 全部通过返回0, 否则返回-1; valid 不为空时写入每条记录的结果(1通过) */
+int curve25519_box_decrypt_batch(host_pool *pool, u8 *const *m, const u8 *const *c, const size_t *clen,
+                                 const u8 *nonce, const u8 *key, size_t key_stride, size_t n, int *valid,
+                                 bool sycl);
+
+int test14();
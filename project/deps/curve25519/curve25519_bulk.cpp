@@ -0,0 +1,180 @@
+#include "curve25519_bulk.h"
+#include "curve25519_aead.h"
+#include "curve25519_host.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static void store_le(u8 *p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; ++i) p[i] = u8(v >> (8 * i));
+}
+
+static uint64_t load_le(const u8 *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) v |= uint64_t(p[i]) << (8 * i);
+  return v;
+}
+
+static void header_store(u8 *out, const curve25519_bulk_header *h) {
+  memcpy(out, h->id, 8);
+  store_le(out + 8, h->length, 8);
+  store_le(out + 16, h->chunk, 4);
+  store_le(out + 20, h->count, 4);
+}
+
+//空数据也有一个空块
+static uint64_t chunk_count(uint64_t mlen, uint64_t chunk) {
+  return mlen == 0 ? 1 : (mlen + chunk - 1) / chunk;
+}
+
+//第i块的nonce: 编号 || i
+static void chunk_nonce(u8 *nonce, const u8 *id, uint32_t index) {
+  memcpy(nonce, id, 8);
+  store_le(nonce + 8, index, 4);
+}
+
+size_t curve25519_bulk_sealed_len(size_t mlen, size_t chunk) {
+  if (chunk == 0) chunk = CURVE25519_BULK_DEFAULT_CHUNK;
+  if (uint64_t(chunk) > 0xffffffff) return 0;
+  const uint64_t count = chunk_count(mlen, chunk);
+  if (count > 0xffffffff) return 0;
+  return CURVE25519_BULK_HEADER_BYTES + mlen + count * CURVE25519_AEAD_ABYTES;
+}
+
+int curve25519_bulk_encrypt(host_pool *pool, u8 *out, const u8 *m, size_t mlen, size_t chunk, const u8 *key) {
+  if (chunk == 0) chunk = CURVE25519_BULK_DEFAULT_CHUNK;
+  if (curve25519_bulk_sealed_len(mlen, chunk) == 0) {
+    fprintf(stderr, "分块加密的块数超出范围: %zu字节, 每块%zu字节\n", mlen, chunk);
+    return -1;
+  }
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_bulk_header h;
+  randombytes_buf(h.id, sizeof(h.id));
+  h.length = mlen;
+  h.chunk = uint32_t(chunk);
+  h.count = uint32_t(chunk_count(mlen, chunk));
+  curve25519_perf_scope perf("curve25519_bulk_encrypt", h.count);
+  CURVE25519_TRACE_SCOPE("curve25519_bulk_encrypt");
+  header_store(out, &h);
+
+  std::atomic<int> failed{0};
+  host_pool_parallel_for(pool, h.count, 1, [&](size_t begin, size_t end, size_t) {
+    u8 nonce[CURVE25519_AEAD_NONCEBYTES];
+    for (size_t i = begin; i < end; ++i) {
+      const size_t off = i * chunk, len = std::min(chunk, mlen - off);
+      chunk_nonce(nonce, h.id, uint32_t(i));
+      u8 *dst = out + CURVE25519_BULK_HEADER_BYTES + off + i * CURVE25519_AEAD_ABYTES;
+      if (curve25519_aead_encrypt(dst, mlen > 0 ? m + off : m, len, out, CURVE25519_BULK_HEADER_BYTES, nonce,
+                                  key) != 0) {
+        failed.store(1);
+      }
+    }
+  });
+  return failed.load() ? -1 : 0;
+}
+
+int curve25519_bulk_parse_header(curve25519_bulk_header *h, size_t *total, const u8 *in, size_t inlen) {
+  if (inlen < CURVE25519_BULK_HEADER_BYTES) return -1;
+  memcpy(h->id, in, 8);
+  h->length = load_le(in + 8, 8);
+  h->chunk = uint32_t(load_le(in + 16, 4));
+  h->count = uint32_t(load_le(in + 20, 4));
+  //长度上限只是防止下面的加法溢出
+  if (h->chunk == 0 || h->length > SIZE_MAX / 2 || h->count != chunk_count(h->length, h->chunk)) return -1;
+  *total = curve25519_bulk_sealed_len(size_t(h->length), h->chunk);
+  return *total == 0 ? -1 : 0;
+}
+
+int curve25519_bulk_decrypt(host_pool *pool, u8 *m, size_t *mlen, const u8 *in, size_t inlen, const u8 *key) {
+  curve25519_bulk_header h;
+  size_t total;
+  if (curve25519_bulk_parse_header(&h, &total, in, inlen) != 0 || total != inlen) {
+    fprintf(stderr, "分块数据的头部与长度不符\n");
+    return -1;
+  }
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_perf_scope perf("curve25519_bulk_decrypt", h.count);
+  CURVE25519_TRACE_SCOPE("curve25519_bulk_decrypt");
+
+  const size_t length = size_t(h.length), chunk = h.chunk;
+  std::atomic<int> failed{0};
+  host_pool_parallel_for(pool, h.count, 1, [&](size_t begin, size_t end, size_t) {
+    u8 nonce[CURVE25519_AEAD_NONCEBYTES];
+    for (size_t i = begin; i < end && !failed.load(std::memory_order_relaxed); ++i) {
+      const size_t off = i * chunk, len = std::min(chunk, length - off);
+      chunk_nonce(nonce, h.id, uint32_t(i));
+      const u8 *src = in + CURVE25519_BULK_HEADER_BYTES + off + i * CURVE25519_AEAD_ABYTES;
+      if (curve25519_aead_decrypt(length > 0 ? m + off : m, src, len + CURVE25519_AEAD_ABYTES, in,
+                                  CURVE25519_BULK_HEADER_BYTES, nonce, key) != 0) {
+        failed.store(1);
+      }
+    }
+  });
+  if (failed.load()) {
+    //其余块虽然通过了验证, 整条数据不完整, 不保留明文
+    if (length > 0) sodium_memzero(m, length);
+    fprintf(stderr, "分块数据验证失败\n");
+    return -1;
+  }
+  *mlen = length;
+  return 0;
+}
+
+//测试样例16: 分块加密能还原, 单块与curve25519_aead_encrypt一致, 交换、截断块或修改头部后解密失败
+int test16() {
+  const size_t chunk = 4096;
+  const size_t lens[] = {0, 1, chunk - 1, chunk, chunk + 1, 5 * chunk + 7};
+  u8 key[32], nonce[CURVE25519_AEAD_NONCEBYTES];
+  for (int i = 0; i < 32; ++i) key[i] = static_cast<u8>(i * 7 + 5);
+  host_pool *pool = host_pool_create(3, 0, false);
+  bool ok = true;
+  std::vector<u8> m, sealed, plain, expect;
+  for (size_t len : lens) {
+    m.resize(len);
+    for (size_t i = 0; i < len; ++i) m[i] = static_cast<u8>(i * 13 + len);
+    sealed.resize(curve25519_bulk_sealed_len(len, chunk));
+    plain.assign(len + 1, 0);
+    size_t out_len = 0;
+    ok = ok && sealed.size() == CURVE25519_BULK_HEADER_BYTES + len + 16 * std::max<size_t>(1, (len + chunk - 1) / chunk);
+    ok = ok && curve25519_bulk_encrypt(pool, sealed.data(), m.data(), len, chunk, key) == 0;
+    ok = ok && curve25519_bulk_decrypt(pool, plain.data(), &out_len, sealed.data(), sealed.size(), key) == 0 &&
+         out_len == len && memcmp(plain.data(), m.data(), len) == 0;
+
+    //第0块就是以头部为附加数据的ChaCha20-Poly1305
+    const size_t first = std::min(len, chunk);
+    expect.resize(first + 16);
+    chunk_nonce(nonce, sealed.data(), 0);
+    curve25519_aead_encrypt(expect.data(), m.data(), first, sealed.data(), CURVE25519_BULK_HEADER_BYTES, nonce, key);
+    ok = ok && memcmp(expect.data(), sealed.data() + CURVE25519_BULK_HEADER_BYTES, first + 16) == 0;
+  }
+
+  //交换第1、2块
+  const size_t len = 5 * chunk + 7, stride = chunk + 16;
+  std::vector<u8> bad = sealed;
+  std::swap_ranges(bad.begin() + CURVE25519_BULK_HEADER_BYTES + stride,
+                   bad.begin() + CURVE25519_BULK_HEADER_BYTES + 2 * stride,
+                   bad.begin() + CURVE25519_BULK_HEADER_BYTES + 2 * stride);
+  size_t out_len = 0;
+  ok = ok && curve25519_bulk_decrypt(pool, plain.data(), &out_len, bad.data(), bad.size(), key) == -1;
+  //去掉最后一块并相应修改头部
+  bad = sealed;
+  store_le(bad.data() + 8, 5 * chunk, 8);
+  store_le(bad.data() + 20, 5, 4);
+  ok = ok && curve25519_bulk_decrypt(pool, plain.data(), &out_len, bad.data(), bad.size() - 7 - 16, key) == -1;
+  //长度与头部不符
+  ok = ok && curve25519_bulk_decrypt(pool, plain.data(), &out_len, sealed.data(), sealed.size() - 1, key) == -1;
+  //验证失败时不保留明文
+  ok = ok && std::all_of(plain.begin(), plain.begin() + len, [](u8 b) { return b == 0; });
+  host_pool_destroy(pool);
+  if (!ok) {
+    fprintf(stderr, "分块并行加密结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "分块并行加密结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "host_pool.h"
+
+typedef uint8_t u8;
+
+/* 大数据分块并行加解密: 明文切成固定大小的块, 在线程池上用ChaCha20-Poly1305(curve25519_aead.h)
+ * 并行加密, 解密时并行验证并按顺序还原。
+ * 格式: 24字节头部, 之后依次为各块的 密文 || 16字节tag。
+ *   头部: 8字节随机编号 | 明文总长度(8字节小端) | 每块长度(4字节小端) | 块数(4字节小端)
+ * 第i块的nonce为 编号 || i(4字节小端), 附加数据为整个头部: 交换、删除或重复块,
+ * 以及修改总长度、块数都会导致验证失败。空数据也有一个空块, 不能被截断成空。  */
+
+#define CURVE25519_BULK_HEADER_BYTES 24
+#define CURVE25519_BULK_DEFAULT_CHUNK (1u << 20)
+//接收方按头部中(尚未验证)的长度一次性分配内存, 明文超过该长度时应改用流式模式(curve25519_stream.h)
+#define CURVE25519_BULK_MAX_LENGTH (1ull << 30)
+
+struct curve25519_bulk_header {
+  u8 id[8];
+  uint64_t length;    //明文总长度
+  uint32_t chunk;     //每块明文长度, 最后一块可以更短
+  uint32_t count;     //块数
+};
+
+//加密后的总长度(含头部), chunk为0时使用默认块长; 块数超出范围时返回0
+size_t curve25519_bulk_sealed_len(size_t mlen, size_t chunk);
+
+/* 分块并行加密: m(长度mlen)按chunk字节分块, 输出写入out(长度为curve25519_bulk_sealed_len)
+ * key为curve25519_aead_key派生的32字节密钥; pool为空指针时使用默认线程池; 成功返回0 */
+int curve25519_bulk_encrypt(host_pool *pool, u8 *out, const u8 *m, size_t mlen, size_t chunk, const u8 *key);
+
+//解析并检查头部, total 写入含头部的总长度; 头部不合法返回-1
+int curve25519_bulk_parse_header(curve25519_bulk_header *h, size_t *total, const u8 *in, size_t inlen);
+
+/* 分块并行解密: in(长度inlen)为curve25519_bulk_encrypt的输出, 明文写入m(容量至少为头部中的长度),
+ * 长度写入mlen; 头部与inlen不符或任何一块验证失败时返回-1 */
+int curve25519_bulk_decrypt(host_pool *pool, u8 *m, size_t *mlen, const u8 *in, size_t inlen, const u8 *key);
+
+int test16();
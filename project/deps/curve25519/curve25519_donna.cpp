@@ -1,6 +1,16 @@
 #include "curve25519_donna.h"
+#include "curve25519_runtime.h"
+#include "curve25519_async.h"
+#include "curve25519_profile.h"
+#include "curve25519_stats.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include "curve25519_probe.h"
+#include "curve25519_tune.h"
 #include <sycl/sycl.hpp>
+#include <sodium.h>
 #include <thread>
+#include <chrono>
 
 using namespace sycl;
 
@@ -9,31 +19,46 @@ using namespace sycl;
 typedef unsigned uint128_t __attribute__((mode(TI)));
 
 
-queue q {cpu_selector_v};
+//全局队列在首次使用时创建, 链接本文件的程序不会在静态初始化阶段加载SYCL运行时
+//开启内核剖析时队列带有 enable_profiling 属性
+queue &curve25519_queue() {
+  static queue q {cpu_selector_v, curve25519_profile_queue_properties()};
+  return q;
+}
+
+
 //两个大小为5的无符号64位整型数组相加: output += in 
 static inline void force_inline
 fsum(limb *output, const limb *in) {
+  CURVE25519_TRACE_SCOPE("fsum");
+  queue &q = curve25519_queue();
   buffer<limb, 1> output_buf{ output, range<1>{5} };
   buffer<const limb, 1> in_buf{ in, range<1>{5} };
+  CURVE25519_COUNT(C25519_BUFFER, 2);
   
-  q.submit([&](handler &h){
+  curve25519_profile_kernel("fsum", q.submit([&](handler &h){
     auto output_acc = output_buf.get_access<access::mode::read_write>(h);
     auto in_acc = in_buf.get_access<access::mode::read>(h);
     //对数组每个元素进行加法操作
     h.parallel_for(range<1>{5}, [=](id<1> i) {
       output_acc[i] += in_acc[i];
     });
-  }).wait();
+  })).wait();
+  CURVE25519_COUNT(C25519_SUBMIT, 1);
+  CURVE25519_COUNT(C25519_WAIT, 1);
 }
 
 /* 两个不同的数之间的差: output = in - output
    执行前 out[i] < 2^52；执行后 out[i] < 2^55 */
 static inline void force_inline
 fdifference_backwards(felem out, const felem in) {
+  CURVE25519_TRACE_SCOPE("fdifference_backwards");
+  queue &q = curve25519_queue();
   buffer<limb, 1> out_buf{ out, range<1>{5} };
   buffer<const limb, 1> in_buf{ in, range<1>{5} };
+  CURVE25519_COUNT(C25519_BUFFER, 2);
 
-  q.submit([&](handler &h){
+  curve25519_profile_kernel("fdifference_backwards", q.submit([&](handler &h){
     auto out_acc = out_buf.get_access<access::mode::read_write>(h);
     auto in_acc = in_buf.get_access<access::mode::read>(h);
     //确保结果的值域在 [0,2^55)之间
@@ -43,23 +68,29 @@ fdifference_backwards(felem out, const felem in) {
     h.parallel_for(range<1>{5}, [=](id<1> i) {
        out_acc[i] = in_acc[i] + ((i == 0) ? two54m152 : two54m8) - out_acc[i];
     });
-  }).wait();
+  })).wait();
+  CURVE25519_COUNT(C25519_SUBMIT, 1);
+  CURVE25519_COUNT(C25519_WAIT, 1);
 }
 
 //数组（in）乘以一个常量(scalar)，并将结果输出到output数组中: output = in * scalar 
 static inline void force_inline
 fscalar_product(felem output, const felem in, const limb scalar) {
+  CURVE25519_TRACE_SCOPE("fscalar_product");
+  queue &q = curve25519_queue();
   uint128_t a;
   uint64_t t[5][2];
 
   buffer<const limb, 1> inputBuf(in, range<1>{5});
   buffer<uint64_t, 2> t_Buf(reinterpret_cast<limb*>(t), range<2>{5,2});
+  CURVE25519_COUNT(C25519_BUFFER, 2);
   limb* scalar_shared=malloc_shared<limb>(sizeof(limb) ,q);
+  CURVE25519_COUNT_USM(sizeof(limb) * sizeof(limb));
   memcpy(scalar_shared,&scalar,sizeof(uint64_t));
   //1.计算输入数组 in 中对应元素和标量 scalar 的乘积，并将结果存储在数组a中。
   //2.取出 a 的低 51 位作为输出数组的当前元素。
   //3.更新 a 的高 77 位（实际上就是右移 51 位后的剩余部分）以备下次迭代使用。
-   q.submit([&](handler &h) {
+   curve25519_profile_kernel("fscalar_product", q.submit([&](handler &h) {
     accessor inputData(inputBuf, h, read_only);
     accessor tData(t_Buf,h,write_only);
     //与多项式与一个常量相乘类似
@@ -67,8 +98,11 @@ fscalar_product(felem output, const felem in, const limb scalar) {
        tData[i][0] =inputData[i]*(*scalar_shared);         //低64位
        tData[i][1]=mul_hi(inputData[i],*scalar_shared);    //高64位
     });
-   }).wait();
+   })).wait();
+   CURVE25519_COUNT(C25519_SUBMIT, 1);
+   CURVE25519_COUNT(C25519_WAIT, 1);
    host_accessor tData_host (t_Buf,read_only);
+   CURVE25519_COUNT(C25519_HOST_ACCESSOR, 1);
    free(scalar_shared,q);
    
    //规约处理，依次迭代(Barrett reduction规约方法)
@@ -89,6 +123,8 @@ fscalar_product(felem output, const felem in, const limb scalar) {
  * 执行后 output[i] < 2^52                           */
 static inline void force_inline
 fmul(felem output, const felem in2, const felem in) {
+  CURVE25519_TRACE_SCOPE("fmul");
+  queue &q = curve25519_queue();
   uint128_t t[5];
   //看做是多项式系数
   //A(x) = a + bx + cx^2 + dx^3 + ex^4
@@ -101,8 +137,9 @@ fmul(felem output, const felem in2, const felem in) {
   buffer<limb,3> a_buf(reinterpret_cast<limb*>(a),range<3>{5,5,2});
   buffer<const limb,1> in_buf(in,range<1>{5});
   buffer<const limb,1> in2_buf(in2,range<1>{5});
+  CURVE25519_COUNT(C25519_BUFFER, 3);
 
-  auto eA= q.submit([&](handler& h){
+  auto eA= curve25519_profile_kernel("fmul", q.submit([&](handler& h){
      auto a_acc = a_buf.get_access<access::mode::write>(h);
      auto in_acc = in_buf.get_access<access::mode::read>(h);
      auto in2_acc = in2_buf.get_access<access::mode::read>(h);
@@ -114,11 +151,12 @@ fmul(felem output, const felem in2, const felem in) {
             a_acc[i][j][1] = mul_hi(in_acc[i], in2_acc[j]);
         }
     });
-  });
+  }));
+  CURVE25519_COUNT(C25519_SUBMIT, 1);
  
  //19 是 Curve25519 算法中使用的固定值，用于将结果缩小到正确范围内 
  //多项式乘积的次方数大于4时要进行模运算（超出curv25519曲线规定的值)，结果缩小到正确的取模范围内
-  auto eB=q.submit([&](handler& h){
+  auto eB=curve25519_profile_kernel("fmul", q.submit([&](handler& h){
      h.depends_on(eA);
      auto a_acc = a_buf.get_access<access::mode::write>(h);
      auto in_acc = in_buf.get_access<access::mode::read>(h);
@@ -132,9 +170,12 @@ fmul(felem output, const felem in2, const felem in) {
             a_acc[i][j][1] = mul_hi(in_acc[i]*19, in2_acc[j]);
         }
     });
-  });
+  }));
+  CURVE25519_COUNT(C25519_SUBMIT, 1);
    eB.wait();
+   CURVE25519_COUNT(C25519_WAIT, 1);
    host_accessor aData(a_buf,read_only);
+   CURVE25519_COUNT(C25519_HOST_ACCESSOR, 1);
    //合并同类项
    t[0]=( ((uint128_t)aData[0][0][1]) <<64) | aData[0][0][0];
    t[1]=( (((uint128_t)aData[0][1][1]) <<64)| aData[0][1][0])+( (((uint128_t)aData[1][0][1]) <<64) | aData[1][0][0] );
@@ -167,6 +208,8 @@ fmul(felem output, const felem in2, const felem in) {
 //求in的平方的count次方的结果:（in^2)^count
 static inline void force_inline
 fsquare_times(felem output, const felem in, limb count) {
+  CURVE25519_TRACE_SCOPE("fsquare_times");
+  queue &q = curve25519_queue();
   uint128_t t[5];
   // 多项式乘积
   // (a + bx + cx^2 + dx^3 + ex^4)^2 = a^2 + 2abx + (2ac + b^2)x^2 + (2ad + 2bc)x^3 + (2ae + 2bd + c^2)x^4 
@@ -177,9 +220,10 @@ fsquare_times(felem output, const felem in, limb count) {
   memcpy(in_init, in, sizeof(limb) * 5);
   buffer<limb,3> a_buf(reinterpret_cast<limb*>(a),range<3>{5,5,2});
   buffer<limb,1> in_buf(in_init, range<1>{5});
+  CURVE25519_COUNT(C25519_BUFFER, 2);
 
   do {
-   auto eA= q.submit([&](handler& h){
+   auto eA= curve25519_profile_kernel("fsquare_times", q.submit([&](handler& h){
        auto a_acc = a_buf.get_access<access::mode::write>(h);
        auto in_acc = in_buf.get_access<access::mode::read>(h);
       
@@ -206,10 +250,14 @@ fsquare_times(felem output, const felem in, limb count) {
              }
            }
          });
-     });
+     }));
+     CURVE25519_COUNT(C25519_SUBMIT, 1);
      eA.wait();
+     CURVE25519_COUNT(C25519_WAIT, 1);
      host_accessor aData(a_buf,read_only);
+     CURVE25519_COUNT(C25519_HOST_ACCESSOR, 1);
      host_accessor inData(in_buf,read_write);
+     CURVE25519_COUNT(C25519_HOST_ACCESSOR, 1);
      //合并同类项
      t[0]=((((uint128_t)aData[0][0][1])<<64) |aData[0][0][0])+((((uint128_t)aData[1][4][1])<<64) |aData[1][4][0])+((((uint128_t)aData[2][3][1])<<64) |aData[2][3][0]);
      t[1]=((((uint128_t)aData[0][1][1])<<64) |aData[0][1][0])+((((uint128_t)aData[2][4][1])<<64) |aData[2][4][0])+((((uint128_t)aData[3][3][1])<<64) |aData[3][3][0]);
@@ -231,6 +279,7 @@ fsquare_times(felem output, const felem in, limb count) {
   } while(--count);
 
   host_accessor inData(in_buf,read_only);
+  CURVE25519_COUNT(C25519_HOST_ACCESSOR, 1);
 
   memcpy(output,inData.get_pointer(),sizeof(limb)*5);
 }
@@ -251,26 +300,36 @@ static limb load_limb(const u8 *in) {
 
 //将64位无符号整数存储到uint8_t数组中
 static void store_limb(u8 *out, limb in) {
+  CURVE25519_TRACE_SCOPE("store_limb");
+  queue &q = curve25519_queue();
     buffer<u8, 1> outBuf(out, range<1>(sizeof(limb)));
+    CURVE25519_COUNT(C25519_BUFFER, 1);
     limb * indata=malloc_shared<limb>(sizeof(limb),q);
+    CURVE25519_COUNT_USM(sizeof(limb) * sizeof(limb));
     memcpy(indata,&in,sizeof(limb));
 
-    q.submit([&](handler &h) {
+    curve25519_profile_kernel("store_limb", q.submit([&](handler &h) {
         accessor outData(outBuf, h, write_only);
       h.parallel_for(range<1>(8), [=](id<1> i) {
         outData[i] = static_cast<u8>(((*indata) >> (8 * i))) & 0xff;
       });
-    }).wait();
+    })).wait();
+    CURVE25519_COUNT(C25519_SUBMIT, 1);
+    CURVE25519_COUNT(C25519_WAIT, 1);
     free(indata,q);
 }
 
 //将大小为32的uint8_t数组转换成大小为5的uint64_t数组
 static void fexpand(limb *output, const u8 *in) {
+  CURVE25519_TRACE_SCOPE("fexpand");
+  queue &q = curve25519_queue();
    buffer<limb, 1> outBuf(output, range<1>(5));
+   CURVE25519_COUNT(C25519_BUFFER, 1);
    u8* indata=malloc_shared<u8>(32,q);
+   CURVE25519_COUNT_USM(32);
    memcpy(indata,in,sizeof(u8)*32);
 
-   q.submit([&](handler &h) {
+   curve25519_profile_kernel("fexpand", q.submit([&](handler &h) {
       accessor outData(outBuf, h, write_only);
       h.parallel_for(range<1>{5}, [=](id<1> idx){
          int i=idx[0];
@@ -283,7 +342,9 @@ static void fexpand(limb *output, const u8 *in) {
            case 4:outData[4] = (load_limb(indata+24) >> 12) & 0x7ffffffffffff;break;
         }
     });
-  }).wait();
+  })).wait();
+  CURVE25519_COUNT(C25519_SUBMIT, 1);
+  CURVE25519_COUNT(C25519_WAIT, 1);
   free(indata,q);
 }
 
@@ -292,6 +353,7 @@ static void fexpand(limb *output, const u8 *in) {
 // 总体而言，这段代码主要是对多项式数据进行压缩，以便于在数据传输中使用，同时保证了数据的归约和进位。
 static void
 fcontract(u8 *output, const felem input) {
+  CURVE25519_TRACE_SCOPE("fcontract");
   uint128_t t[5];
 
   t[0] = input[0];
@@ -399,8 +461,10 @@ fmonty(limb *x2, limb *z2,     //  2Q
        limb *xprime, limb *zprime, // Q' 
        const limb *qmqp        /* Q - Q' */
        ) {
+  CURVE25519_TRACE_SCOPE("fmonty");
   limb origx[5], origxprime[5], zzz[5], xx[5], zz[5], xxprime[5],
         zzprime[5], zzzprime[5];
+      CURVE25519_COUNT(C25519_THREAD, 5);
       //Q
       std::thread t1(fmonty_task1, x, z, origx);   // 启动 Task1 线程
       //Q'
@@ -423,12 +487,16 @@ fmonty(limb *x2, limb *z2,     //  2Q
 // 当且仅当 iswap 非零时才执行交换操作
 // 防止侧信道泄漏信息
 static void swap_conditional(limb a[5], limb b[5], limb iswap) {
+  CURVE25519_TRACE_SCOPE("swap_conditional");
+  queue &q = curve25519_queue();
    buffer<limb, 1> a_buf{a, range<1>{5}};
    buffer<limb, 1> b_buf{b, range<1>{5}};
+   CURVE25519_COUNT(C25519_BUFFER, 2);
    limb* iswap_usm = malloc_shared<limb>(1, q);
+   CURVE25519_COUNT_USM(sizeof(limb));
    memcpy(iswap_usm,&iswap,sizeof(limb));
    
-   q.submit([&](handler &h){
+   curve25519_profile_kernel("swap_conditional", q.submit([&](handler &h){
         accessor a_acc{a_buf, h};
         accessor b_acc{b_buf, h}; 
     h.parallel_for(range<1>(5), [=] (id<1> i) {
@@ -436,7 +504,9 @@ static void swap_conditional(limb a[5], limb b[5], limb iswap) {
        a_acc[i] ^= x;
        b_acc[i] ^= x;
    });
-  }).wait();
+  })).wait();
+   CURVE25519_COUNT(C25519_SUBMIT, 1);
+   CURVE25519_COUNT(C25519_WAIT, 1);
    free(iswap_usm,q);
 }
 
@@ -447,6 +517,7 @@ static void swap_conditional(limb a[5], limb b[5], limb iswap) {
 // 改进的double-and-add 算法计算公钥
 static void
 cmult(limb *resultx, limb *resultz, const u8 *n, const limb *q) {
+  CURVE25519_TRACE_SCOPE("cmult");
   limb a[5] = {0}, b[5] = {1}, c[5] = {1}, d[5] = {0};
   limb *nqpqx = a, *nqpqz = b, *nqx = c, *nqz = d, *t;
   limb e[5] = {0}, f[5] = {1}, g[5] = {0}, h[5] = {1};
@@ -455,7 +526,7 @@ cmult(limb *resultx, limb *resultz, const u8 *n, const limb *q) {
 
   memcpy(nqpqx, q, sizeof(limb) * 5);
   for (i = 0; i < 32; ++i) {
-    u8 byte = n[i];
+    u8 byte = n[31 - i];   //从最高字节开始处理
     for (j = 0; j < 8; ++j) {
       const limb bit = byte >> 7;
       swap_conditional(nqx, nqpqx, bit);   //避免了使用条件分支
@@ -492,6 +563,7 @@ cmult(limb *resultx, limb *resultz, const u8 *n, const limb *q) {
 
 //求有限域上z的逆元(扩展欧几里得算法)
 static void crecip(felem out, const felem z) {
+   CURVE25519_TRACE_SCOPE("crecip");
    felem a,t0,b,c;
    //通过一系列乘法和平方运算
    fsquare_times(a, z, 1); 
@@ -520,8 +592,12 @@ static void crecip(felem out, const felem z) {
 
 //计算公钥
 int curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+    CURVE25519_TRACE_SCOPE("curve25519_donna");
     limb bp[5], x[5], z[5], zmone[5];
     uint8_t e[32];
+    const auto start = std::chrono::steady_clock::now();
+    curve25519_perf_scope perf("curve25519_donna");
+    CURVE25519_PROBE(donna_entry, mypublic);
     
     memcpy(e,secret,sizeof(u8)*32);
     
@@ -534,9 +610,49 @@ int curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
     crecip(zmone, z);
     fmul(z, x, zmone);  //将 x 转换成椭圆曲线有限域上的元素
     fcontract(mypublic, z);
+    CURVE25519_COUNT(C25519_SCALARMULT, 1);
+    const uint64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start).count();
+    curve25519_profile_scalarmult(1, wall);
+    CURVE25519_PROBE(donna_return, mypublic, 0, wall);
   return 0;
 }
 
+//基准测试使用的内部运算入口
+const curve25519_primitives *curve25519_get_primitives() {
+  static const curve25519_primitives table = {
+    fmul, fsquare_times, crecip, fmonty, fexpand, fcontract
+  };
+  return &table;
+}
+
+//预热: 构建内核并各执行一次, 返回耗时(毫秒)
+double curve25519_prewarm() {
+  const auto start = std::chrono::steady_clock::now();
+  try {
+    queue &q = curve25519_queue();
+    //构建本程序中所有内核的可执行kernel bundle, AOT编译时只需加载设备镜像
+    auto bundle = get_kernel_bundle<bundle_state::executable>(q.get_context(), {q.get_device()});
+    (void)bundle;
+
+    //各执行一次批量内核和按运算拆分的内核, 完成运行时剩余的首次初始化
+    static const u8 basepoint[32] = {9};
+    u8 secret[32] = {1}, out[32];
+    u8 *usm = malloc_shared<u8>(96, q);
+    memcpy(usm + 32, secret, 32);
+    memcpy(usm + 64, basepoint, 32);
+    curve25519_donna_batch_submit(q, usm, usm + 32, usm + 64, 1).wait();
+    free(usm, q);
+    curve25519_donna(out, secret, basepoint);
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "预热SYCL内核失败: %s\n", ex.what());
+    return -1;
+  }
+  //读取或测量调优结果, 批量接口从第一次调用起就按分界点选择引擎
+  curve25519_autotune();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 /* 测试样例1
  * 该函数可以用于测试代码是否能正确处理非规范曲线点（即设置了第256位的点）。
  * 在某些情况下，可能会出现设置了第256位的点，这种点不能被视为有效的曲线点，
@@ -606,38 +722,52 @@ int test2(){
   return 0;  
 }
 
-//测试样例3
-static uint64_t
-time_now() {
-  struct timeval tv;
-  uint64_t ret;
-  gettimeofday(&tv, NULL);  //获取当前时间
-  ret = tv.tv_sec;    //秒
-  ret *= 1000000;     //转换成微秒
-  ret += tv.tv_usec;  //加上微秒
-
-  return ret;
-}
-//测运行速度
-void test3(){
-  static const unsigned char basepoint[32] = {9};
-  unsigned char mysecret[32], mypublic[32];
-  unsigned i;
-  uint64_t start, end;
-
-  memset(mysecret, 42, 32);
-  mysecret[0] &= 248;
-  mysecret[31] &= 127;
-  mysecret[31] |= 64;
-  //预先加载缓存
-  for (i = 0; i < 10; ++i) {
-    curve25519_donna(mypublic, mysecret, basepoint);
+/* 测试样例21: 标量乘法与libsodium逐字节一致
+ * cmult 从标量的最高字节开始做double-and-add, 只在最高字节非零的标量和
+ * RFC 7748 的测试向量能发现字节顺序的错误, 随机标量和基点覆盖其余情况 */
+int test21(){
+  static const u8 rfc_scalar[32] = {
+    0xa5,0x46,0xe3,0x6b,0xf0,0x52,0x7c,0x9d,0x3b,0x16,0x15,0x4b,0x82,0x46,0x5e,0xdd,
+    0x62,0x14,0x4c,0x0a,0xc1,0xfc,0x5a,0x18,0x50,0x6a,0x22,0x44,0xba,0x44,0x9a,0xc4,
+  };
+  static const u8 rfc_point[32] = {
+    0xe6,0xdb,0x68,0x67,0x58,0x30,0x30,0xdb,0x35,0x94,0xc1,0xa4,0x24,0xb1,0x5f,0x7c,
+    0x72,0x66,0x24,0xec,0x26,0xb3,0x35,0x3b,0x10,0xa9,0x03,0xa6,0xd0,0xab,0x1c,0x4c,
+  };
+  static const u8 rfc_result[32] = {
+    0xc3,0xda,0x55,0x37,0x9d,0xe9,0xc6,0x90,0x8e,0x94,0xea,0x4d,0xf2,0x8d,0x08,0x4f,
+    0x32,0xec,0xcf,0x03,0x49,0x1c,0x71,0xf7,0x54,0xb4,0x07,0x55,0x77,0xa2,0x85,0x52,
+  };
+  static const u8 basepoint[32] = {9};
+  u8 scalar[32], point[32], out[32], expect[32];
+
+  curve25519_donna(out, rfc_scalar, rfc_point);
+  if (memcmp(out, rfc_result, 32) != 0) {
+    fprintf(stderr, "标量乘法与RFC 7748测试向量不一致\n");
+    return 1;
   }
-  start = time_now();
-  for (i = 0; i < 10; ++i) {
-    curve25519_donna(mypublic, mysecret, basepoint);
+  //只有最高字节非零的标量
+  memset(scalar, 0, sizeof(scalar));
+  scalar[31] = 0x40;
+  curve25519_donna(out, scalar, basepoint);
+  if (crypto_scalarmult_curve25519(expect, scalar, basepoint) != 0 || memcmp(out, expect, 32) != 0) {
+    fprintf(stderr, "标量乘法与libsodium不一致\n");
+    return 1;
   }
-  end = time_now();
-  printf("%luus\n", (unsigned long) ((end - start) / 30000));
-  return;
-}
\ No newline at end of file
+  for (int i = 0; i < 64; ++i) {
+    randombytes_buf(scalar, sizeof(scalar));
+    if (i % 2 == 0) {
+      memcpy(point, basepoint, 32);
+    } else {
+      crypto_scalarmult_curve25519_base(point, scalar);   //随机的曲线点
+      randombytes_buf(scalar, sizeof(scalar));
+    }
+    curve25519_donna(out, scalar, point);
+    if (crypto_scalarmult_curve25519(expect, scalar, point) != 0 || memcmp(out, expect, 32) != 0) {
+      fprintf(stderr, "标量乘法与libsodium不一致\n");
+      return 1;
+    }
+  }
+  fprintf(stderr, "标量乘法与libsodium一致。\n");
+  return 0;
+}
@@ -24,6 +24,19 @@ static void swap_conditional(limb a[5], limb b[5], limb iswap);
 static void cmult(limb *resultx, limb *resultz, const u8 *n, const limb *q);
 static void crecip(felem out, const felem z);
 int curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint);
+
+//内部运算的函数表, 上面的运算都是static函数, 基准测试通过此表单独测量
+struct curve25519_primitives {
+  void (*fmul)(felem output, const felem in2, const felem in);
+  void (*fsquare_times)(felem output, const felem in, limb count);
+  void (*crecip)(felem out, const felem z);
+  void (*fmonty)(limb *x2, limb *z2, limb *x3, limb *z3, limb *x, limb *z,
+                 limb *xprime, limb *zprime, const limb *qmqp);
+  void (*fexpand)(limb *output, const u8 *in);
+  void (*fcontract)(u8 *output, const felem input);
+};
+const curve25519_primitives *curve25519_get_primitives();
+
 int test1();
 int test2();
-void test3();
\ No newline at end of file
+int test21();
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "curve25519_donna.h"
+#include "curve25519_runtime.h"
+#include "curve25519_async.h"
+#include "curve25519_host.h"
+#include "curve25519_resident.h"
+#include <sodium.h>
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* 常数时间检验(dudect方法)与耗时分布统计
+ *   用法: curve25519_dudect [--json 文件] [--raw 目录] [--cpu 编号] [--samples 次数] [--engine 名称]
+ *                           [--threshold t值] [--quick]
+ * 每个引擎交替输入两类私钥: 固定私钥(全0)和随机私钥, 类别按随机顺序排列, 逐次记录耗时。
+ * 对两类的耗时做Welch t检验, 并按多个分位数裁剪掉长尾后重复检验; |t|超过阈值(默认4.5)
+ * 说明耗时与私钥相关。每类再统计p50/p90/p99/p99.9和最大值, 反映SYCL调度等引起的抖动。
+ * 人类可读的结果写到stderr, JSON写到stdout或--json指定的文件, --raw 输出每次调用的耗时。 */
+
+struct dudect_options {
+  const char *json = nullptr;
+  const char *raw = nullptr;
+  const char *engine = nullptr;   //只运行名字以此开头的引擎
+  int cpu = -1;
+  size_t samples = 0;             //0表示使用各引擎的默认次数
+  double threshold = 4.5;
+  bool quick = false;
+};
+
+struct dudect_engine {
+  const char *name;
+  size_t batch;                   //一次调用完成的标量乘法个数, 同一次调用内私钥类别相同
+  size_t samples;                 //默认采样次数
+  std::function<void(u8 *out, const u8 *secret, const u8 *basepoint, size_t n)> op;
+};
+
+struct class_summary {
+  size_t n;
+  double mean, p50, p90, p99, p999, max;
+};
+
+struct dudect_result {
+  std::string name;
+  size_t batch;
+  class_summary cls[2];
+  double t_raw;                   //未裁剪的t值
+  double t_max;                   //各裁剪水平中绝对值最大的t值
+  double t_max_crop;              //t_max对应的裁剪分位数, 1表示未裁剪
+  bool leak;
+};
+
+static std::vector<dudect_result> results;
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char *unit = "cycles";
+//rdtscp等待之前的指令完成, 之后的lfence防止后面的指令提前执行
+static inline uint64_t timestamp() {
+  unsigned aux;
+  const uint64_t t = __rdtscp(&aux);
+  _mm_lfence();
+  return t;
+}
+#else
+static const char *unit = "ns";
+static inline uint64_t timestamp() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static int pin_cpu(int cpu) {
+  if (cpu < 0) cpu = sched_getcpu();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    perror("sched_setaffinity");
+    return -1;
+  }
+  return cpu;
+}
+
+//Welch t检验, 只统计不超过 crop 的记录
+static double welch_t(const std::vector<uint64_t> &t, const std::vector<uint8_t> &cls, double crop) {
+  double n[2] = {0, 0}, mean[2] = {0, 0}, m2[2] = {0, 0};
+  for (size_t i = 0; i < t.size(); ++i) {
+    const double x = double(t[i]);
+    if (x > crop) continue;
+    //Welford算法, 避免大数相减的精度损失
+    const int c = cls[i];
+    n[c] += 1;
+    const double d = x - mean[c];
+    mean[c] += d / n[c];
+    m2[c] += d * (x - mean[c]);
+  }
+  if (n[0] < 2 || n[1] < 2) return 0;
+  const double v0 = m2[0] / (n[0] - 1), v1 = m2[1] / (n[1] - 1);
+  const double se = std::sqrt(v0 / n[0] + v1 / n[1]);
+  return se > 0 ? (mean[0] - mean[1]) / se : 0;
+}
+
+static double percentile(const std::vector<uint64_t> &sorted, double q) {
+  if (sorted.empty()) return 0;
+  return double(sorted[std::min(sorted.size() - 1, size_t(std::ceil(q * sorted.size())) - 1)]);
+}
+
+static class_summary summarize(std::vector<uint64_t> v) {
+  class_summary s = {};
+  s.n = v.size();
+  if (v.empty()) return s;
+  std::sort(v.begin(), v.end());
+  double sum = 0;
+  for (uint64_t x : v) sum += double(x);
+  s.mean = sum / v.size();
+  s.p50 = percentile(v, 0.5);
+  s.p90 = percentile(v, 0.9);
+  s.p99 = percentile(v, 0.99);
+  s.p999 = percentile(v, 0.999);
+  s.max = double(v.back());
+  return s;
+}
+
+static void write_raw(const char *dir, const std::string &name, const std::vector<uint64_t> &t,
+                      const std::vector<uint8_t> &cls) {
+  std::string file = name;
+  std::replace(file.begin(), file.end(), '/', '_');
+  file = std::string(dir) + "/" + file + ".csv";
+  FILE *f = fopen(file.c_str(), "w");
+  if (f == nullptr) {
+    perror("fopen");
+    return;
+  }
+  fprintf(f, "class,%s\n", unit);
+  for (size_t i = 0; i < t.size(); ++i) fprintf(f, "%s,%lu\n", cls[i] ? "random" : "fixed", (unsigned long)t[i]);
+  fclose(f);
+}
+
+static void run(const dudect_engine &e, size_t samples, const dudect_options &opt) {
+  //输入在计时开始前全部生成, 随机数生成不计入耗时
+  const size_t stride = 32 * e.batch;
+  std::vector<uint8_t> cls(samples);
+  std::vector<u8> secrets(samples * stride, 0), basepoints(stride, 0), out(stride);
+  for (size_t i = 0; i < samples; ++i) {
+    cls[i] = static_cast<uint8_t>(randombytes_uniform(2));
+    if (cls[i] == 1) randombytes_buf(&secrets[i * stride], stride);
+  }
+  for (size_t i = 0; i < e.batch; ++i) basepoints[32 * i] = 9;
+
+  const size_t warmup = std::max<size_t>(1, samples / 100);
+  for (size_t i = 0; i < warmup; ++i) e.op(out.data(), &secrets[(i % samples) * stride], basepoints.data(), e.batch);
+  std::vector<uint64_t> t(samples);
+  for (size_t i = 0; i < samples; ++i) {
+    const uint64_t begin = timestamp();
+    e.op(out.data(), &secrets[i * stride], basepoints.data(), e.batch);
+    t[i] = timestamp() - begin;
+  }
+
+  dudect_result r;
+  r.name = e.name;
+  r.batch = e.batch;
+  std::vector<uint64_t> by_class[2];
+  for (size_t i = 0; i < samples; ++i) by_class[cls[i]].push_back(t[i]);
+  r.cls[0] = summarize(by_class[0]);
+  r.cls[1] = summarize(by_class[1]);
+
+  //长尾主要来自中断和调度, 与私钥无关, 按合并分布的分位数裁剪后分别检验
+  std::vector<uint64_t> sorted = t;
+  std::sort(sorted.begin(), sorted.end());
+  static const double crops[] = {1.0, 0.99, 0.95, 0.9, 0.75, 0.5};
+  r.t_raw = welch_t(t, cls, double(sorted.back()));
+  r.t_max = r.t_raw;
+  r.t_max_crop = 1.0;
+  for (double q : crops) {
+    const double tq = welch_t(t, cls, percentile(sorted, q));
+    if (std::fabs(tq) > std::fabs(r.t_max)) {
+      r.t_max = tq;
+      r.t_max_crop = q;
+    }
+  }
+  r.leak = std::fabs(r.t_max) > opt.threshold;
+  results.push_back(r);
+  if (opt.raw != nullptr) write_raw(opt.raw, r.name, t, cls);
+
+  const class_summary &f = r.cls[0], &g = r.cls[1];
+  fprintf(stderr, "%-30s %7zu %9.2f %9.2f(p%-4g) %12.0f %12.0f %12.0f %12.0f %8.2f %s\n", e.name,
+          samples, r.t_raw, r.t_max, r.t_max_crop * 100, f.p50, g.p50, std::max(f.p99, g.p99),
+          std::max(f.p999, g.p999), f.p50 > 0 ? std::max(f.p999, g.p999) / std::min(f.p50, g.p50) : 0,
+          r.leak ? "可能不是常数时间" : "");
+}
+
+static void write_class(FILE *f, const char *key, const class_summary &s) {
+  fprintf(f, "\"%s\": {\"n\": %zu, \"mean\": %.1f, \"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, "
+             "\"p999\": %.0f, \"max\": %.0f}", key, s.n, s.mean, s.p50, s.p90, s.p99, s.p999, s.max);
+}
+
+static void write_json(FILE *f, int cpu, double threshold) {
+  fprintf(f, "{\n  \"cpu\": %d,\n  \"unit\": \"%s\",\n  \"threshold\": %.2f,\n  \"results\": [\n", cpu, unit,
+          threshold);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const dudect_result &r = results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"batch\": %zu, \"t\": %.3f, \"t_max\": %.3f, \"t_max_crop\": %.2f, "
+               "\"leak\": %s, ", r.name.c_str(), r.batch, r.t_raw, r.t_max, r.t_max_crop,
+            r.leak ? "true" : "false");
+    write_class(f, "fixed", r.cls[0]);
+    fprintf(f, ", ");
+    write_class(f, "random", r.cls[1]);
+    fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  dudect_options opt;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--json" && i + 1 < argc) opt.json = argv[++i];
+    else if (a == "--raw" && i + 1 < argc) opt.raw = argv[++i];
+    else if (a == "--engine" && i + 1 < argc) opt.engine = argv[++i];
+    else if (a == "--cpu" && i + 1 < argc) opt.cpu = atoi(argv[++i]);
+    else if (a == "--samples" && i + 1 < argc) opt.samples = strtoul(argv[++i], nullptr, 10);
+    else if (a == "--threshold" && i + 1 < argc) opt.threshold = atof(argv[++i]);
+    else if (a == "--quick") opt.quick = true;
+    else {
+      fprintf(stderr, "用法: %s [--json 文件] [--raw 目录] [--cpu 编号] [--samples 次数] [--engine 名称] "
+                      "[--threshold t值] [--quick]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (sodium_init() < 0) {
+    fprintf(stderr, "libsodium初始化失败\n");
+    return -1;
+  }
+
+  //与curve25519_bench相同: 先创建SYCL运行时和主机线程池, 再绑定主线程
+  if (curve25519_prewarm() < 0) return -1;
+  curve25519_host_pool();
+  //常驻内核的轮询线程一直忙等, 只在测量它自己时运行, 不干扰其他引擎的计时
+  curve25519_resident *resident = nullptr;
+  const int cpu = pin_cpu(opt.cpu);
+
+  const std::vector<dudect_engine> engines = {
+    {"crypto_scalarmult(libsodium)", 1, 20000,
+     [](u8 *o, const u8 *s, const u8 *b, size_t) { crypto_scalarmult(o, s, b); }},
+    {"curve25519_donna_host", 1, 20000,
+     [](u8 *o, const u8 *s, const u8 *b, size_t) { curve25519_donna_host(o, s, b); }},
+    {"curve25519_donna_async", 1, 2000,
+     [](u8 *o, const u8 *s, const u8 *b, size_t) { curve25519_donna_async(o, s, b).get(); }},
+    {"curve25519_resident", 1, 2000,
+     [&resident](u8 *o, const u8 *s, const u8 *b, size_t) {
+       long ticket;
+       while ((ticket = curve25519_resident_push(resident, s, b)) < 0) {}
+       curve25519_resident_wait(resident, ticket, o);
+     }},
+    {"curve25519_donna_batch_sycl/64", 64, 200,
+     [](u8 *o, const u8 *s, const u8 *b, size_t n) { curve25519_donna_batch_sycl(o, s, b, n); }},
+    {"curve25519_donna_host_batch/64", 64, 2000,
+     [](u8 *o, const u8 *s, const u8 *b, size_t n) { curve25519_donna_host_batch(nullptr, o, s, b, n); }},
+    //逐运算的SYCL实现一次要提交上万次内核, 只能做少量采样
+    {"curve25519_donna", 1, 100,
+     [](u8 *o, const u8 *s, const u8 *b, size_t) { curve25519_donna(o, s, b); }},
+  };
+
+  fprintf(stderr, "%-30s %7s %9s %16s %12s %12s %12s %12s %8s  (单位: %s)\n", "引擎", "采样", "t",
+          "max|t|(裁剪)", "固定p50", "随机p50", "p99", "p99.9", "p99.9/p50", unit);
+  for (const dudect_engine &e : engines) {
+    if (opt.engine != nullptr && strncmp(e.name, opt.engine, strlen(opt.engine)) != 0) continue;
+    size_t samples = opt.samples ? opt.samples : e.samples;
+    if (opt.quick) samples = std::min<size_t>(samples, 20);
+    const bool needs_resident = strcmp(e.name, "curve25519_resident") == 0;
+    if (needs_resident && (resident = curve25519_resident_start(64, 1)) == nullptr) return -1;
+    run(e, std::max<size_t>(samples, 4), opt);
+    if (needs_resident) {
+      curve25519_resident_stop(resident);
+      resident = nullptr;
+    }
+  }
+
+  FILE *f = stdout;
+  if (opt.json != nullptr && (f = fopen(opt.json, "w")) == nullptr) {
+    perror("fopen");
+    return -1;
+  }
+  write_json(f, cpu, opt.threshold);
+  if (f != stdout) fclose(f);
+
+  for (const dudect_result &r : results) {
+    if (r.leak) return 2;
+  }
+  return 0;
+}
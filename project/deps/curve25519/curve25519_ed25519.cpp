@@ -0,0 +1,698 @@
+#include "curve25519_ed25519.h"
+#include "curve25519_edwards.h"
+#include "curve25519_host.h"
+#include "curve25519_runtime.h"
+#include "curve25519_stats.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+//批量签名和验证时每个任务块的消息数上限
+#define SIGN_CHUNK 64
+//多标量乘法窗口宽度的上限, 每个窗口的桶占 2^c * 160 字节
+#define MSM_MAX_WINDOW 12
+//有效签名少于此数时多标量乘法的固定开销超过收益, 直接逐个验证
+#define VERIFY_MIN_BATCH 4
+
+using namespace sycl;
+
+//基点的预计算表: base_table[i][j] = (j+1) * 256^i * B
+static ge_precomp base_table[32][8];
+//验证用的奇数倍点: base_odd[i] = (2i+1) * B
+static ge_precomp base_odd[8];
+static std::once_flag base_table_once;
+
+static void build_base_table() {
+  ge_p3 cur, acc, b2;
+  ge_p1p1 t;
+  ge_precomp cur_pre;
+  ge_basepoint(&cur);
+  ge_p3_dbl(&t, &cur);
+  ge_p1p1_to_p3(&b2, &t);
+  acc = cur;
+  for (int i = 0; i < 8; ++i) {
+    ge_p3_to_precomp(&base_odd[i], &acc);
+    ge_p3_add(&acc, &b2);
+  }
+  for (int i = 0; i < 32; ++i) {
+    ge_p3_to_precomp(&cur_pre, &cur);
+    acc = cur;
+    for (int j = 0; j < 8; ++j) {
+      if (j > 0) ge_p3_to_precomp(&base_table[i][j], &acc);
+      else base_table[i][0] = cur_pre;
+      ge_madd(&t, &acc, &cur_pre);
+      ge_p1p1_to_p3(&acc, &t);
+    }
+    // cur *= 256
+    for (int k = 0; k < 8; ++k) {
+      ge_p3_dbl(&t, &cur);
+      ge_p1p1_to_p3(&cur, &t);
+    }
+  }
+}
+
+//b == c 时返回1, 不使用分支
+static inline limb equal(u8 b, u8 c) {
+  limb x = static_cast<u8>(b ^ c);
+  x -= 1;
+  return x >> 63;
+}
+
+// t = b * base_table[pos], b ∈ [-8, 8]; 逐项条件赋值, 访问模式与b无关
+static void table_select(ge_precomp *t, int pos, signed char b) {
+  const limb negative = static_cast<u8>(b) >> 7;
+  const u8 babs = static_cast<u8>(b - ((-static_cast<int>(negative) & b) * 2));
+  ge_precomp_0(t);
+  for (int j = 0; j < 8; ++j) ge_precomp_cmov(t, &base_table[pos][j], equal(babs, j + 1));
+  ge_precomp minus;
+  fe_copy(minus.yplusx, t->yminusx);
+  fe_copy(minus.yminusx, t->yplusx);
+  fe_neg(minus.xy2d, t->xy2d);
+  ge_precomp_cmov(t, &minus, negative);
+}
+
+/* h = a * B: 标量写成64个带符号的4位数字 e[i] ∈ [-8, 8), a = sum e[i] * 16^i
+ * 先累加奇数位, 乘16后再累加偶数位, 共64次查表加法和4次倍点 */
+static void scalarmult_base(ge_p3 *h, const u8 *a) {
+  std::call_once(base_table_once, build_base_table);
+  signed char e[64];
+  for (int i = 0; i < 32; ++i) {
+    e[2 * i] = a[i] & 15;
+    e[2 * i + 1] = (a[i] >> 4) & 15;
+  }
+  signed char carry = 0;
+  for (int i = 0; i < 63; ++i) {
+    e[i] += carry;
+    carry = (e[i] + 8) >> 4;
+    e[i] -= carry * 16;
+  }
+  e[63] += carry;
+
+  ge_p1p1 r;
+  ge_p2 s;
+  ge_precomp t;
+  ge_p3_0(h);
+  for (int i = 1; i < 64; i += 2) {
+    table_select(&t, i / 2, e[i]);
+    ge_madd(&r, h, &t);
+    ge_p1p1_to_p3(h, &r);
+  }
+  ge_p3_dbl(&r, h);
+  ge_p1p1_to_p2(&s, &r);
+  ge_p2_dbl(&r, &s);
+  ge_p1p1_to_p2(&s, &r);
+  ge_p2_dbl(&r, &s);
+  ge_p1p1_to_p2(&s, &r);
+  ge_p2_dbl(&r, &s);
+  ge_p1p1_to_p3(h, &r);
+  for (int i = 0; i < 64; i += 2) {
+    table_select(&t, i / 2, e[i]);
+    ge_madd(&r, h, &t);
+    ge_p1p1_to_p3(h, &r);
+  }
+  sodium_memzero(e, sizeof(e));
+}
+
+void curve25519_ed25519_scalarmult_base(u8 *out, const u8 *a) {
+  ge_p3 h;
+  scalarmult_base(&h, a);
+  ge_p3_tobytes(out, &h);
+}
+
+//群的阶 L = 2^252 + 27742317777372353535851937790883648493, 按字节小端序
+static const int64_t order[32] = {0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7,
+                                  0xa2, 0xde, 0xf9, 0xde, 0x14, 0,    0,    0,    0,    0,    0,
+                                  0,    0,    0,    0,    0,    0,    0,    0,    0,    0x10};
+
+/* r = x mod L, x为64个(可能超过8位的)字节系数
+ * 从高位起用 2^252 ≡ -(L - 2^252) 逐字节消去, 循环次数固定, 与x的值无关 */
+static void sc_modl(u8 *r, int64_t x[64]) {
+  int64_t carry;
+  for (int i = 63; i >= 32; --i) {
+    carry = 0;
+    int j;
+    for (j = i - 32; j < i - 12; ++j) {
+      x[j] += carry - 16 * x[i] * order[j - (i - 32)];
+      carry = (x[j] + 128) >> 8;
+      x[j] -= carry * 256;
+    }
+    x[j] += carry;
+    x[i] = 0;
+  }
+  carry = 0;
+  for (int j = 0; j < 32; ++j) {
+    x[j] += carry - (x[31] >> 4) * order[j];
+    carry = x[j] >> 8;
+    x[j] &= 255;
+  }
+  for (int j = 0; j < 32; ++j) x[j] -= carry * order[j];
+  for (int i = 0; i < 32; ++i) {
+    x[i + 1] += x[i] >> 8;
+    r[i] = static_cast<u8>(x[i] & 255);
+  }
+}
+
+// s = (64字节小端序数) mod L, 结果写入s的前32字节
+static void sc_reduce(u8 *s) {
+  int64_t x[64];
+  for (int i = 0; i < 64; ++i) x[i] = s[i];
+  sc_modl(s, x);
+  sodium_memzero(x, sizeof(x));
+}
+
+// s = (a * b + c) mod L
+static void sc_muladd(u8 *s, const u8 *a, const u8 *b, const u8 *c) {
+  int64_t x[64];
+  for (int i = 0; i < 64; ++i) x[i] = i < 32 ? c[i] : 0;
+  for (int i = 0; i < 32; ++i) {
+    for (int j = 0; j < 32; ++j) x[i + j] += int64_t(a[i]) * b[j];
+  }
+  sc_modl(s, x);
+  sodium_memzero(x, sizeof(x));
+}
+
+//az = SHA-512(种子), 前32字节修剪后为私钥标量a, 后32字节用于生成随机数
+static void expand_seed(u8 *az, const u8 *seed) {
+  crypto_hash_sha512(az, seed, 32);
+  az[0] &= 248;
+  az[31] &= 127;
+  az[31] |= 64;
+}
+
+int curve25519_ed25519_keypair(u8 *pk, u8 *sk, const u8 *seed) {
+  u8 az[64];
+  expand_seed(az, seed);
+  curve25519_ed25519_scalarmult_base(pk, az);
+  sodium_memzero(az, sizeof(az));
+  memmove(sk, seed, 32);
+  memmove(sk + 32, pk, 32);
+  return 0;
+}
+
+//用展开后的私钥签名, pk为私钥中保存的公钥
+static void sign_expanded(u8 *sig, const u8 *m, size_t mlen, const u8 *az, const u8 *pk) {
+  crypto_hash_sha512_state hs;
+  u8 nonce[64], hram[64];
+
+  // r = SHA-512(az[32..64] || M) mod L, R = r * B
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, az + 32, 32);
+  crypto_hash_sha512_update(&hs, m, mlen);
+  crypto_hash_sha512_final(&hs, nonce);
+  sc_reduce(nonce);
+  curve25519_ed25519_scalarmult_base(sig, nonce);
+
+  // k = SHA-512(R || A || M) mod L, S = r + k * a
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, sig, 32);
+  crypto_hash_sha512_update(&hs, pk, 32);
+  crypto_hash_sha512_update(&hs, m, mlen);
+  crypto_hash_sha512_final(&hs, hram);
+  sc_reduce(hram);
+  sc_muladd(sig + 32, hram, az, nonce);
+
+  sodium_memzero(nonce, sizeof(nonce));
+  sodium_memzero(&hs, sizeof(hs));
+}
+
+int curve25519_ed25519_sign(u8 *sig, const u8 *m, size_t mlen, const u8 *sk) {
+  curve25519_perf_scope perf("curve25519_ed25519_sign");
+  CURVE25519_TRACE_SCOPE("curve25519_ed25519_sign");
+  u8 az[64];
+  expand_seed(az, sk);
+  sign_expanded(sig, m, mlen, az, sk + 32);
+  sodium_memzero(az, sizeof(az));
+  CURVE25519_COUNT(C25519_SIGN, 1);
+  return 0;
+}
+
+int curve25519_ed25519_sign_batch(host_pool *pool, u8 *sig, const u8 *const *m, const size_t *mlen,
+                                  const u8 *sk, size_t sk_stride, size_t n) {
+  if (n == 0) return 0;
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_perf_scope perf("curve25519_ed25519_sign_batch", n);
+  CURVE25519_TRACE_SCOPE("curve25519_ed25519_sign_batch");
+  std::call_once(base_table_once, build_base_table);
+
+  //同一私钥只展开一次
+  u8 shared_az[64];
+  if (sk_stride == 0) expand_seed(shared_az, sk);
+
+  size_t chunk = n / (host_pool_size(pool) * 4);
+  if (chunk == 0) chunk = 1;
+  if (chunk > SIGN_CHUNK) chunk = SIGN_CHUNK;
+
+  host_pool_parallel_for(pool, n, chunk, [&](size_t begin, size_t end, size_t) {
+    u8 az[64];
+    for (size_t i = begin; i < end; ++i) {
+      const u8 *key = sk + sk_stride * i;
+      if (sk_stride == 0) {
+        sign_expanded(sig + 64 * i, m[i], mlen[i], shared_az, key + 32);
+      } else {
+        expand_seed(az, key);
+        sign_expanded(sig + 64 * i, m[i], mlen[i], az, key + 32);
+      }
+    }
+    sodium_memzero(az, sizeof(az));
+  });
+  sodium_memzero(shared_az, sizeof(shared_az));
+  CURVE25519_COUNT(C25519_SIGN, n);
+  return 0;
+}
+
+//S < L 时返回1
+static bool sc_is_canonical(const u8 *s) {
+  for (int i = 31; i >= 0; --i) {
+    if (s[i] != order[i]) return s[i] < order[i];
+  }
+  return false;
+}
+
+/* 把标量写成带符号的滑动窗口形式: a = sum r[i] * 2^i, r[i]为0或[-15, 15]中的奇数
+ * 非零项之间至少间隔4位(变时, 只用于公开数据) */
+static void slide(signed char *r, const u8 *a) {
+  for (int i = 0; i < 256; ++i) r[i] = 1 & (a[i >> 3] >> (i & 7));
+  for (int i = 0; i < 256; ++i) {
+    if (!r[i]) continue;
+    for (int b = 1; b <= 6 && i + b < 256; ++b) {
+      if (!r[i + b]) continue;
+      if (r[i] + (r[i + b] << b) <= 15) {
+        r[i] += r[i + b] << b;
+        r[i + b] = 0;
+      } else if (r[i] - (r[i + b] << b) >= -15) {
+        r[i] -= r[i + b] << b;
+        for (int k = i + b; k < 256; ++k) {
+          if (!r[k]) {
+            r[k] = 1;
+            break;
+          }
+          r[k] = 0;
+        }
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+// r = a * A + b * B (变时)
+static void double_scalarmult_vartime(ge_p2 *r, const u8 *a, const ge_p3 *A, const u8 *b) {
+  signed char aslide[256], bslide[256];
+  ge_cached Ai[8];   // (2i+1) * A
+  ge_p1p1 t;
+  ge_p3 u, A2;
+  slide(aslide, a);
+  slide(bslide, b);
+
+  ge_p3_to_cached(&Ai[0], A);
+  ge_p3_dbl(&t, A);
+  ge_p1p1_to_p3(&A2, &t);
+  for (int i = 1; i < 8; ++i) {
+    ge_add(&t, &A2, &Ai[i - 1]);
+    ge_p1p1_to_p3(&u, &t);
+    ge_p3_to_cached(&Ai[i], &u);
+  }
+
+  fe_0(r->X);
+  fe_1(r->Y);
+  fe_1(r->Z);
+  int i = 255;
+  while (i >= 0 && !aslide[i] && !bslide[i]) --i;
+  for (; i >= 0; --i) {
+    ge_p2_dbl(&t, r);
+    if (aslide[i] > 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_add(&t, &u, &Ai[aslide[i] / 2]);
+    } else if (aslide[i] < 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_sub(&t, &u, &Ai[-aslide[i] / 2]);
+    }
+    if (bslide[i] > 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_madd(&t, &u, &base_odd[bslide[i] / 2]);
+    } else if (bslide[i] < 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_msub(&t, &u, &base_odd[-bslide[i] / 2]);
+    }
+    ge_p1p1_to_p2(r, &t);
+  }
+}
+
+//验证一个签名所需的解码结果和哈希值
+struct verify_item {
+  ge_p3 A, R;
+  u8 k[32];     // SHA-512(R || A || M) mod L
+  bool ok;      //编码检查是否通过
+};
+
+//检查编码并计算k, 逐个验证和批量验证共用
+static bool verify_prepare(verify_item *item, const u8 *sig, const u8 *m, size_t mlen, const u8 *pk) {
+  item->ok = false;
+  if (!sc_is_canonical(sig + 32)) return false;
+  if (ge_frombytes(&item->A, pk) != 0 || ge_p3_is_small_order(&item->A)) return false;
+  if (ge_frombytes(&item->R, sig) != 0 || ge_p3_is_small_order(&item->R)) return false;
+  u8 h[64];
+  crypto_hash_sha512_state hs;
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, sig, 32);
+  crypto_hash_sha512_update(&hs, pk, 32);
+  crypto_hash_sha512_update(&hs, m, mlen);
+  crypto_hash_sha512_final(&hs, h);
+  sc_reduce(h);
+  memcpy(item->k, h, 32);
+  item->ok = true;
+  return true;
+}
+
+//检查 R == S*B - k*A 的编码
+static bool verify_single(const verify_item *item, const u8 *sig) {
+  ge_p3 minus_a = item->A;
+  ge_p2 r;
+  u8 check[32];
+  ge_p3_neg(&minus_a);
+  double_scalarmult_vartime(&r, item->k, &minus_a, sig + 32);
+  ge_p2_tobytes(check, &r);
+  return memcmp(check, sig, 32) == 0;
+}
+
+int curve25519_ed25519_verify(const u8 *sig, const u8 *m, size_t mlen, const u8 *pk) {
+  curve25519_perf_scope perf("curve25519_ed25519_verify");
+  CURVE25519_TRACE_SCOPE("curve25519_ed25519_verify");
+  std::call_once(base_table_once, build_base_table);
+  verify_item item;
+  if (!verify_prepare(&item, sig, m, mlen, pk) || !verify_single(&item, sig)) return -1;
+  CURVE25519_COUNT(C25519_VERIFY, 1);
+  return 0;
+}
+
+//标量s从第bit位起的c位
+static inline unsigned msm_digit(const u8 *s, int bit, int c) {
+  unsigned v = 0;
+  for (int k = 0; k < c && bit + k < 256; ++k) v |= unsigned((s[(bit + k) >> 3] >> ((bit + k) & 7)) & 1) << k;
+  return v;
+}
+
+/* Pippenger桶方法中第w个窗口的累加: 点按标量在该窗口的c位数字d放入桶d,
+ * 再从高到低求前缀和并累加, 得到 out = sum d * 桶d。buckets至少有 2^c - 1 个
+ * 只使用curve25519_edwards.h中的运算, 可以在SYCL内核中执行 */
+static inline void msm_window(ge_p3 *out, const ge_cached *points, const u8 *scalars, size_t n, int c, int w,
+                              ge_p3 *buckets) {
+  const size_t nb = (size_t(1) << c) - 1;
+  ge_p1p1 t;
+  for (size_t b = 0; b < nb; ++b) ge_p3_0(&buckets[b]);
+  for (size_t i = 0; i < n; ++i) {
+    const unsigned d = msm_digit(scalars + 32 * i, w * c, c);
+    if (d == 0) continue;
+    ge_add(&t, &buckets[d - 1], &points[i]);
+    ge_p1p1_to_p3(&buckets[d - 1], &t);
+  }
+  ge_p3 running;
+  ge_p3_0(&running);
+  ge_p3_0(out);
+  for (size_t b = nb; b-- > 0;) {
+    ge_p3_add(&running, &buckets[b]);
+    ge_p3_add(out, &running);
+  }
+}
+
+//标量不超过253位, 窗口数为 ceil(253 / c)
+static inline int msm_windows(int c) { return (253 + c - 1) / c; }
+
+//按加法次数 窗口数 * (n + 2^(c+1)) 选择窗口宽度
+static int msm_window_bits(size_t n) {
+  int best = 1;
+  double best_cost = 0;
+  for (int c = 1; c <= MSM_MAX_WINDOW; ++c) {
+    const double cost = msm_windows(c) * (double(n) + double(size_t(2) << c));
+    if (c == 1 || cost < best_cost) best = c, best_cost = cost;
+  }
+  return best;
+}
+
+//按窗口从高到低合并: out = sum windows[w] * 2^(c*w)
+static void msm_combine(ge_p3 *out, const ge_p3 *windows, int nw, int c) {
+  ge_p1p1 t;
+  *out = windows[nw - 1];
+  for (int w = nw - 2; w >= 0; --w) {
+    for (int k = 0; k < c; ++k) {
+      ge_p3_dbl(&t, out);
+      ge_p1p1_to_p3(out, &t);
+    }
+    ge_p3_add(out, &windows[w]);
+  }
+}
+
+//在SYCL设备上完成各窗口的桶累加, 失败返回-1
+static int msm_sycl(ge_p3 *windows, const ge_cached *points, const u8 *scalars, size_t n, int c) {
+  const int nw = msm_windows(c);
+  const size_t nb = (size_t(1) << c) - 1;
+  queue &q = curve25519_queue();
+  ge_cached *pts = nullptr;
+  u8 *sc = nullptr;
+  ge_p3 *win = nullptr, *buckets = nullptr;
+  int ret = 0;
+  try {
+    pts = malloc_shared<ge_cached>(n, q);
+    sc = malloc_shared<u8>(32 * n, q);
+    win = malloc_shared<ge_p3>(nw, q);
+    buckets = malloc_device<ge_p3>(nw * nb, q);
+    CURVE25519_COUNT_USM(n * sizeof(ge_cached) + 32 * n + (nw + nw * nb) * sizeof(ge_p3));
+    if (pts == nullptr || sc == nullptr || win == nullptr || buckets == nullptr) {
+      ret = -1;
+    } else {
+      memcpy(pts, points, n * sizeof(ge_cached));
+      memcpy(sc, scalars, 32 * n);
+      event e = q.parallel_for(range<1>{size_t(nw)}, [=](id<1> w) {
+        msm_window(&win[w], pts, sc, n, c, static_cast<int>(w.get(0)), buckets + w.get(0) * nb);
+      });
+      CURVE25519_COUNT(C25519_SUBMIT, 1);
+      e.wait();
+      CURVE25519_COUNT(C25519_WAIT, 1);
+      memcpy(windows, win, nw * sizeof(ge_p3));
+    }
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "SYCL多标量乘法失败: %s\n", ex.what());
+    ret = -1;
+  }
+  if (pts != nullptr) free(pts, q);
+  if (sc != nullptr) free(sc, q);
+  if (win != nullptr) free(win, q);
+  if (buckets != nullptr) free(buckets, q);
+  return ret;
+}
+
+// out = sum scalars[i] * points[i], sycl 为true时在设备上累加, 失败时退回线程池
+static void msm(ge_p3 *out, host_pool *pool, const ge_cached *points, const u8 *scalars, size_t n, bool sycl) {
+  const int c = msm_window_bits(n);
+  const int nw = msm_windows(c);
+  std::vector<ge_p3> windows(nw);
+  if (!sycl || msm_sycl(windows.data(), points, scalars, n, c) != 0) {
+    host_pool_parallel_for(pool, nw, 1, [&](size_t begin, size_t end, size_t) {
+      std::vector<ge_p3> buckets((size_t(1) << c) - 1);
+      for (size_t w = begin; w < end; ++w) {
+        msm_window(&windows[w], points, scalars, n, c, static_cast<int>(w), buckets.data());
+      }
+    });
+  }
+  msm_combine(out, windows.data(), nw, c);
+}
+
+int curve25519_ed25519_verify_batch(host_pool *pool, const u8 *sig, const u8 *const *m, const size_t *mlen,
+                                    const u8 *pk, size_t pk_stride, size_t n, int *valid, bool sycl) {
+  if (n == 0) return 0;
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_perf_scope perf("curve25519_ed25519_verify_batch", n);
+  CURVE25519_TRACE_SCOPE("curve25519_ed25519_verify_batch");
+  std::call_once(base_table_once, build_base_table);
+
+  size_t chunk = n / (host_pool_size(pool) * 4);
+  if (chunk == 0) chunk = 1;
+  if (chunk > SIGN_CHUNK) chunk = SIGN_CHUNK;
+
+  //解码和哈希在线程池上并行
+  std::vector<verify_item> items(n);
+  host_pool_parallel_for(pool, n, chunk, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i) verify_prepare(&items[i], sig + 64 * i, m[i], mlen[i], pk + pk_stride * i);
+  });
+
+  /* 点和标量: 每个签名贡献 (R_i, z_i) 和 (A_i, z_i*k_i), 最后是 (B, -sum z_i*S_i)
+   * -x 用 x * (L-1) mod L 计算 */
+  static const u8 zero[32] = {0};
+  u8 minus_one[32];
+  for (int i = 0; i < 32; ++i) minus_one[i] = static_cast<u8>(order[i]);
+  minus_one[0] -= 1;
+
+  std::vector<ge_cached> points;
+  std::vector<u8> scalars;
+  points.reserve(2 * n + 1);
+  scalars.reserve(32 * (2 * n + 1));
+  u8 z[32] = {0}, zk[32], s_sum[32] = {0};
+  for (size_t i = 0; i < n; ++i) {
+    if (!items[i].ok) continue;
+    randombytes_buf(z, 16);
+    z[0] |= 1;   //z不为0
+    ge_cached c;
+    ge_p3_to_cached(&c, &items[i].R);
+    points.push_back(c);
+    scalars.insert(scalars.end(), z, z + 32);
+    ge_p3_to_cached(&c, &items[i].A);
+    points.push_back(c);
+    sc_muladd(zk, z, items[i].k, zero);
+    scalars.insert(scalars.end(), zk, zk + 32);
+    sc_muladd(s_sum, z, sig + 64 * i + 32, s_sum);
+  }
+
+  bool batch_ok = true;
+  if (points.size() < 2 * VERIFY_MIN_BATCH) {
+    batch_ok = points.empty();
+  } else {
+    ge_p3 b, result;
+    ge_cached c;
+    ge_basepoint(&b);
+    ge_p3_to_cached(&c, &b);
+    points.push_back(c);
+    sc_muladd(s_sum, s_sum, minus_one, zero);
+    scalars.insert(scalars.end(), s_sum, s_sum + 32);
+    msm(&result, pool, points.data(), scalars.data(), points.size(), sycl);
+    batch_ok = ge_p3_is_small_order(&result);
+  }
+
+  //批量方程不成立时逐个验证
+  int ret = 0;
+  std::vector<int> result(n);
+  for (size_t i = 0; i < n; ++i) result[i] = items[i].ok ? 1 : 0;
+  if (!batch_ok) {
+    host_pool_parallel_for(pool, n, chunk, [&](size_t begin, size_t end, size_t) {
+      for (size_t i = begin; i < end; ++i) {
+        if (result[i]) result[i] = verify_single(&items[i], sig + 64 * i) ? 1 : 0;
+      }
+    });
+  }
+  size_t passed = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (!result[i]) ret = -1;
+    if (valid != nullptr) valid[i] = result[i];
+    passed += result[i];
+  }
+  CURVE25519_COUNT(C25519_VERIFY, passed);
+  return ret;
+}
+
+//测试样例12: 密钥对和签名与libsodium逐字节一致, 批量签名与单次签名一致
+int test12() {
+  const size_t n = 19;
+  std::vector<u8> msg(n * 97), sig(n * 64), batch_sig(n * 64), sk(n * 64);
+  std::vector<const u8 *> m(n);
+  std::vector<size_t> mlen(n);
+  u8 seed[32], pk[32], expect_pk[32], expect_sk[64], expect_sig[64];
+  unsigned long long siglen;
+
+  for (size_t i = 0; i < msg.size(); ++i) msg[i] = static_cast<u8>(i * 7 + 3);
+  for (size_t i = 0; i < n; ++i) {
+    for (int j = 0; j < 32; ++j) seed[j] = static_cast<u8>(i * 31 + j * 5 + 1);
+    m[i] = &msg[97 * i];
+    mlen[i] = i * 5;    //包括空消息
+    curve25519_ed25519_keypair(pk, &sk[64 * i], seed);
+    curve25519_ed25519_sign(&sig[64 * i], m[i], mlen[i], &sk[64 * i]);
+
+    crypto_sign_seed_keypair(expect_pk, expect_sk, seed);
+    crypto_sign_detached(expect_sig, &siglen, m[i], mlen[i], expect_sk);
+    if (memcmp(pk, expect_pk, 32) != 0 || memcmp(&sk[64 * i], expect_sk, 64) != 0 ||
+        memcmp(&sig[64 * i], expect_sig, 64) != 0) {
+      fprintf(stderr, "Ed25519签名结果有误\n");
+      return 1;
+    }
+  }
+
+  host_pool *pool = host_pool_create(3, 0, false);
+  curve25519_ed25519_sign_batch(pool, batch_sig.data(), m.data(), mlen.data(), sk.data(), 64, n);
+  bool ok = memcmp(batch_sig.data(), sig.data(), sig.size()) == 0;
+  //同一私钥签所有消息
+  curve25519_ed25519_sign_batch(pool, batch_sig.data(), m.data(), mlen.data(), sk.data(), 0, n);
+  host_pool_destroy(pool);
+  for (size_t i = 0; ok && i < n; ++i) {
+    curve25519_ed25519_sign(expect_sig, m[i], mlen[i], sk.data());
+    ok = memcmp(&batch_sig[64 * i], expect_sig, 64) == 0;
+  }
+  if (!ok) {
+    fprintf(stderr, "Ed25519批量签名结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "Ed25519签名结果正确。\n");
+  return 0;
+}
+
+//测试样例13: 逐个验证与libsodium一致, 批量验证(线程池和SYCL)能找出被篡改的签名
+int test13() {
+  const size_t n = 41;
+  std::vector<u8> msg(n * 64), sig(n * 64), pk(n * 32);
+  std::vector<const u8 *> m(n);
+  std::vector<size_t> mlen(n, 64);
+  std::vector<int> valid(n);
+  u8 seed[32], sk[64];
+  unsigned long long siglen;
+
+  for (size_t i = 0; i < msg.size(); ++i) msg[i] = static_cast<u8>(i * 11 + 5);
+  for (size_t i = 0; i < n; ++i) {
+    for (int j = 0; j < 32; ++j) seed[j] = static_cast<u8>(i * 13 + j * 3 + 7);
+    crypto_sign_seed_keypair(&pk[32 * i], sk, seed);
+    m[i] = &msg[64 * i];
+    crypto_sign_detached(&sig[64 * i], &siglen, m[i], mlen[i], sk);
+  }
+
+  //各种篡改方式下与crypto_sign_verify_detached的结果一致
+  static const u8 small_order[32] = {1};   //单位元
+  u8 bad[64], bad_pk[32];
+  bool ok = true;
+  for (int kind = 0; kind < 6 && ok; ++kind) {
+    memcpy(bad, &sig[0], 64);
+    memcpy(bad_pk, &pk[0], 32);
+    switch (kind) {
+      case 1: bad[3] ^= 0x10; break;                  // R
+      case 2: bad[40] ^= 0x01; break;                 // S
+      case 3: {                                       // S + L, 不是规范编码
+        int carry = 0;
+        for (int i = 0; i < 32; ++i) {
+          const int v = bad[32 + i] + int(order[i]) + carry;
+          bad[32 + i] = static_cast<u8>(v);
+          carry = v >> 8;
+        }
+        break;
+      }
+      case 4: memcpy(bad_pk, small_order, 32); break;
+      case 5: bad_pk[0] ^= 0x02; break;
+      default: break;
+    }
+    const int expect = crypto_sign_verify_detached(bad, m[0], mlen[0], bad_pk);
+    ok = curve25519_ed25519_verify(bad, m[0], mlen[0], bad_pk) == expect && (kind == 0) == (expect == 0);
+  }
+  if (!ok) {
+    fprintf(stderr, "Ed25519验证结果与libsodium不一致\n");
+    return 1;
+  }
+
+  host_pool *pool = host_pool_create(3, 0, false);
+  for (int use_sycl = 0; use_sycl < 2 && ok; ++use_sycl) {
+    ok = curve25519_ed25519_verify_batch(pool, sig.data(), m.data(), mlen.data(), pk.data(), 32, n,
+                                         valid.data(), use_sycl) == 0;
+    //篡改一条消息和一个签名, 批量验证失败并标出这两个
+    msg[64 * 7] ^= 1;
+    sig[64 * 30 + 33] ^= 4;
+    ok = ok && curve25519_ed25519_verify_batch(pool, sig.data(), m.data(), mlen.data(), pk.data(), 32, n,
+                                               valid.data(), use_sycl) == -1;
+    for (size_t i = 0; i < n && ok; ++i) ok = valid[i] == (i != 7 && i != 30);
+    msg[64 * 7] ^= 1;
+    sig[64 * 30 + 33] ^= 4;
+  }
+  host_pool_destroy(pool);
+  if (!ok) {
+    fprintf(stderr, "Ed25519批量验证结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "Ed25519验证结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include "curve25519_field.h"
+#include "host_pool.h"
+
+/* 基于curve25519_field.h有限域运算的Ed25519(RFC 8032)密钥生成与签名。
+ * 固定基点的标量乘法使用预计算表(32组, 每组8个点, 约30KB), 首次调用时建表,
+ * 查表时逐项比较后条件赋值, 访问模式与私钥无关。SHA-512使用libsodium。
+ * 密钥格式与libsodium的crypto_sign一致: 公钥32字节, 私钥为 种子(32字节)||公钥。
+ * 验证只处理公开数据, 使用变时算法。                                          */
+
+//由32字节种子生成密钥对, 同crypto_sign_seed_keypair
+int curve25519_ed25519_keypair(u8 *pk, u8 *sk, const u8 *seed);
+
+//对消息签名, sig为64字节, 同crypto_sign_detached
+int curve25519_ed25519_sign(u8 *sig, const u8 *m, size_t mlen, const u8 *sk);
+
+/* 批量签名: 第i条消息 m[i](长度 mlen[i])用私钥 sk + sk_stride*i 签名, 写入 sig + 64*i
+ * 所有消息用同一私钥时 sk_stride 传0, 每条消息各用一个私钥时传64; pool 为空时使用默认线程池 */
+int curve25519_ed25519_sign_batch(host_pool *pool, u8 *sig, const u8 *const *m, const size_t *mlen,
+                                  const u8 *sk, size_t sk_stride, size_t n);
+
+/* 验证签名, 通过返回0, 否则返回-1; 与crypto_sign_verify_detached相同,
+ * 拒绝 S >= L、非规范编码的公钥以及小阶的公钥和R */
+int curve25519_ed25519_verify(const u8 *sig, const u8 *m, size_t mlen, const u8 *pk);
+
+/* 批量验证: 第i个签名 sig + 64*i 用公钥 pk + pk_stride*i 验证消息 m[i](长度 mlen[i])
+ * 对所有签名取随机系数z_i, 用一次多标量乘法检查
+ *   8 * (sum z_i*R_i + sum (z_i*k_i)*A_i - (sum z_i*S_i)*B) = 0
+ * 不成立时逐个验证找出无效的签名。全部有效返回0, 否则返回-1; valid 不为空时写入每个签名的结果(1有效)。
+ * 多标量乘法使用Pippenger桶方法, 按窗口并行: sycl 为false时在线程池 pool(空指针为默认线程池)上,
+ * 为true时每个窗口由一个work-item完成桶累加。
+ * 批量方程带余因子8, 与逐个验证仅在故意构造的含小阶分量的签名上可能不同。 */
+int curve25519_ed25519_verify_batch(host_pool *pool, const u8 *sig, const u8 *const *m, const size_t *mlen,
+                                    const u8 *pk, size_t pk_stride, size_t n, int *valid, bool sycl);
+
+//a * B, a为32字节小端序标量(a[31] <= 127), 结果为压缩编码
+void curve25519_ed25519_scalarmult_base(u8 *out, const u8 *a);
+
+int test12();
+int test13();
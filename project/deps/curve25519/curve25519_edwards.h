@@ -0,0 +1,355 @@
+#pragma once
+
+#include "curve25519_field.h"
+
+/* 扭曲爱德华兹曲线 -x^2 + y^2 = 1 + d*x^2*y^2 (edwards25519)上的点运算, 供Ed25519使用。
+ * 与curve25519_field.h相同, 全部是纯计算的内联函数, 可以在SYCL内核中调用。
+ * 点的表示与ref10一致:
+ *   ge_p2    (X:Y:Z)          x = X/Z, y = Y/Z
+ *   ge_p3    (X:Y:Z:T)        另有 XY = ZT
+ *   ge_p1p1  ((X:Z),(Y:T))    x = X/Z, y = Y/T, 加法和倍点的中间结果
+ *   ge_precomp (y+x, y-x, 2dxy) 仿射坐标的预计算点
+ *   ge_cached  (Y+X, Y-X, Z, 2dT) 射影坐标的加数
+ * 加法使用扩展坐标的统一公式, 对单位元和相同的点同样成立。              */
+
+struct ge_p2 {
+  felem X, Y, Z;
+};
+
+struct ge_p3 {
+  felem X, Y, Z, T;
+};
+
+struct ge_p1p1 {
+  felem X, Y, Z, T;
+};
+
+struct ge_precomp {
+  felem yplusx, yminusx, xy2d;
+};
+
+struct ge_cached {
+  felem YplusX, YminusX, Z, T2d;
+};
+
+// d = -121665/121666
+static inline void fe_ed25519_d(felem out) {
+  out[0] = 0x34dca135978a3;
+  out[1] = 0x1a8283b156ebd;
+  out[2] = 0x5e7a26001c029;
+  out[3] = 0x739c663a03cbb;
+  out[4] = 0x52036cee2b6ff;
+}
+
+// 2d, d = -121665/121666
+static inline void fe_ed25519_d2(felem out) {
+  out[0] = 0x69b9426b2f159;
+  out[1] = 0x35050762add7a;
+  out[2] = 0x3cf44c0038052;
+  out[3] = 0x6738cc7407977;
+  out[4] = 0x2406d9dc56dff;
+}
+
+// sqrt(-1) = 2^((p-1)/4)
+static inline void fe_sqrtm1(felem out) {
+  out[0] = 0x61b274a0ea0b0;
+  out[1] = 0x0d5a5fc8f189d;
+  out[2] = 0x7ef5e9cbd0c60;
+  out[3] = 0x78595a6804c9e;
+  out[4] = 0x2b8324804fc1d;
+}
+
+//基点B的仿射坐标, y = 4/5, x为偶数
+static inline void ge_basepoint(ge_p3 *b) {
+  b->X[0] = 0x62d608f25d51a;
+  b->X[1] = 0x412a4b4f6592a;
+  b->X[2] = 0x75b7171a4b31d;
+  b->X[3] = 0x1ff60527118fe;
+  b->X[4] = 0x216936d3cd6e5;
+  b->Y[0] = 0x6666666666658;
+  b->Y[1] = 0x4cccccccccccc;
+  b->Y[2] = 0x1999999999999;
+  b->Y[3] = 0x3333333333333;
+  b->Y[4] = 0x6666666666666;
+  fe_1(b->Z);
+  fe_mul(b->T, b->X, b->Y);
+}
+
+//完全规约后的最低位, 即编码时的符号位
+static inline limb fe_isnegative(const felem f) {
+  u8 s[32];
+  fe_tobytes(s, f);
+  return s[0] & 1;
+}
+
+//完全规约后不为0时返回1
+static inline limb fe_isnonzero(const felem f) {
+  u8 s[32];
+  fe_tobytes(s, f);
+  u8 r = 0;
+  for (int i = 0; i < 32; ++i) r |= s[i];
+  return r != 0;
+}
+
+// out = z^((p-5)/8) = z^(2^252-3), 用于开平方
+static inline void fe_pow22523(felem out, const felem z) {
+  felem t0, t1, t2;
+  fe_sq(t0, z);
+  fe_sq_times(t1, t0, 2);
+  fe_mul(t1, z, t1);
+  fe_mul(t0, t0, t1);
+  fe_sq(t0, t0);
+  fe_mul(t0, t1, t0);
+  fe_sq_times(t1, t0, 5);
+  fe_mul(t0, t1, t0);
+  fe_sq_times(t1, t0, 10);
+  fe_mul(t1, t1, t0);
+  fe_sq_times(t2, t1, 20);
+  fe_mul(t1, t2, t1);
+  fe_sq_times(t1, t1, 10);
+  fe_mul(t0, t1, t0);
+  fe_sq_times(t1, t0, 50);
+  fe_mul(t1, t1, t0);
+  fe_sq_times(t2, t1, 100);
+  fe_mul(t1, t2, t1);
+  fe_sq_times(t1, t1, 50);
+  fe_mul(t0, t1, t0);
+  fe_sq_times(t0, t0, 2);
+  fe_mul(out, t0, z);
+}
+
+//单位元(0, 1)
+static inline void ge_p3_0(ge_p3 *h) {
+  fe_0(h->X);
+  fe_1(h->Y);
+  fe_1(h->Z);
+  fe_0(h->T);
+}
+
+static inline void ge_precomp_0(ge_precomp *h) {
+  fe_1(h->yplusx);
+  fe_1(h->yminusx);
+  fe_0(h->xy2d);
+}
+
+static inline void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p) {
+  fe_mul(r->X, p->X, p->T);
+  fe_mul(r->Y, p->Y, p->Z);
+  fe_mul(r->Z, p->Z, p->T);
+}
+
+static inline void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p) {
+  fe_mul(r->X, p->X, p->T);
+  fe_mul(r->Y, p->Y, p->Z);
+  fe_mul(r->Z, p->Z, p->T);
+  fe_mul(r->T, p->X, p->Y);
+}
+
+static inline void ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
+  felem d2;
+  fe_add(r->YplusX, p->Y, p->X);
+  fe_sub(r->YminusX, p->Y, p->X);
+  fe_copy(r->Z, p->Z);
+  fe_ed25519_d2(d2);
+  fe_mul(r->T2d, p->T, d2);
+}
+
+static inline void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p) {
+  fe_copy(r->X, p->X);
+  fe_copy(r->Y, p->Y);
+  fe_copy(r->Z, p->Z);
+}
+
+// r = 2 * p, 输入各limb < 2^52
+static inline void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p) {
+  felem t0;
+  fe_sq(r->X, p->X);
+  fe_sq(r->Z, p->Y);
+  fe_sq(r->T, p->Z);
+  fe_add(r->T, r->T, r->T);
+  fe_add(r->Y, p->X, p->Y);
+  fe_sq(t0, r->Y);
+  fe_add(r->Y, r->Z, r->X);
+  fe_sub(r->Z, r->Z, r->X);
+  fe_sub(r->X, t0, r->Y);
+  fe_sub(r->T, r->T, r->Z);
+}
+
+static inline void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p) {
+  ge_p2 q;
+  ge_p3_to_p2(&q, p);
+  ge_p2_dbl(r, &q);
+}
+
+// r = p + q, q为预计算点
+static inline void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+  felem t0;
+  fe_add(r->X, p->Y, p->X);
+  fe_sub(r->Y, p->Y, p->X);
+  fe_mul(r->Z, r->X, q->yplusx);
+  fe_mul(r->Y, r->Y, q->yminusx);
+  fe_mul(r->T, q->xy2d, p->T);
+  fe_add(t0, p->Z, p->Z);
+  fe_sub(r->X, r->Z, r->Y);
+  fe_add(r->Y, r->Z, r->Y);
+  fe_add(r->Z, t0, r->T);
+  fe_sub(r->T, t0, r->T);
+}
+
+// r = p - q, q为预计算点
+static inline void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+  felem t0;
+  fe_add(r->X, p->Y, p->X);
+  fe_sub(r->Y, p->Y, p->X);
+  fe_mul(r->Z, r->X, q->yminusx);
+  fe_mul(r->Y, r->Y, q->yplusx);
+  fe_mul(r->T, q->xy2d, p->T);
+  fe_add(t0, p->Z, p->Z);
+  fe_sub(r->X, r->Z, r->Y);
+  fe_add(r->Y, r->Z, r->Y);
+  fe_sub(r->Z, t0, r->T);
+  fe_add(r->T, t0, r->T);
+}
+
+// r = p + q
+static inline void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
+  felem t0;
+  fe_add(r->X, p->Y, p->X);
+  fe_sub(r->Y, p->Y, p->X);
+  fe_mul(r->Z, r->X, q->YplusX);
+  fe_mul(r->Y, r->Y, q->YminusX);
+  fe_mul(r->T, q->T2d, p->T);
+  fe_mul(r->X, p->Z, q->Z);
+  fe_add(t0, r->X, r->X);
+  fe_sub(r->X, r->Z, r->Y);
+  fe_add(r->Y, r->Z, r->Y);
+  fe_add(r->Z, t0, r->T);
+  fe_sub(r->T, t0, r->T);
+}
+
+// r = p - q
+static inline void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
+  felem t0;
+  fe_add(r->X, p->Y, p->X);
+  fe_sub(r->Y, p->Y, p->X);
+  fe_mul(r->Z, r->X, q->YminusX);
+  fe_mul(r->Y, r->Y, q->YplusX);
+  fe_mul(r->T, q->T2d, p->T);
+  fe_mul(r->X, p->Z, q->Z);
+  fe_add(t0, r->X, r->X);
+  fe_sub(r->X, r->Z, r->Y);
+  fe_add(r->Y, r->Z, r->Y);
+  fe_sub(r->Z, t0, r->T);
+  fe_add(r->T, t0, r->T);
+}
+
+// p = p + q, 全部在扩展坐标下进行
+static inline void ge_p3_add(ge_p3 *p, const ge_p3 *q) {
+  ge_cached c;
+  ge_p1p1 t;
+  ge_p3_to_cached(&c, q);
+  ge_add(&t, p, &c);
+  ge_p1p1_to_p3(p, &t);
+}
+
+// 8 * p 是否为单位元, 即p的阶整除8(小阶点)
+static inline bool ge_p3_is_small_order(const ge_p3 *p) {
+  ge_p1p1 t;
+  ge_p2 q;
+  felem d;
+  ge_p3_dbl(&t, p);
+  ge_p1p1_to_p2(&q, &t);
+  ge_p2_dbl(&t, &q);
+  ge_p1p1_to_p2(&q, &t);
+  ge_p2_dbl(&t, &q);
+  ge_p1p1_to_p2(&q, &t);
+  fe_sub(d, q.Y, q.Z);
+  return fe_isnonzero(q.X) == 0 && fe_isnonzero(d) == 0;
+}
+
+/* 解压缩编码, 不是曲线上的点或y不小于p时返回-1(变时, 只用于公开数据)
+ * x = sqrt((y^2 - 1) / (d*y^2 + 1)) = u*v^3 * (u*v^7)^((p-5)/8) */
+static inline int ge_frombytes(ge_p3 *h, const u8 *s) {
+  felem u, v, v3, vxx, check, d;
+  u8 canonical[32];
+  fe_frombytes(h->Y, s);
+  fe_tobytes(canonical, h->Y);
+  for (int i = 0; i < 31; ++i) {
+    if (canonical[i] != s[i]) return -1;
+  }
+  if (canonical[31] != (s[31] & 0x7f)) return -1;
+
+  fe_1(h->Z);
+  fe_ed25519_d(d);
+  fe_sq(u, h->Y);
+  fe_mul(v, u, d);
+  fe_sub(u, u, h->Z);      // u = y^2 - 1
+  fe_add(v, v, h->Z);      // v = d*y^2 + 1
+  fe_sq(v3, v);
+  fe_mul(v3, v3, v);       // v3 = v^3
+  fe_sq(h->X, v3);
+  fe_mul(h->X, h->X, v);
+  fe_mul(h->X, h->X, u);   // x = u*v^7
+  fe_pow22523(h->X, h->X);
+  fe_mul(h->X, h->X, v3);
+  fe_mul(h->X, h->X, u);
+
+  fe_sq(vxx, h->X);
+  fe_mul(vxx, vxx, v);
+  fe_sub(check, vxx, u);   // v*x^2 - u
+  if (fe_isnonzero(check)) {
+    fe_add(check, vxx, u);
+    if (fe_isnonzero(check)) return -1;
+    fe_sqrtm1(d);
+    fe_mul(h->X, h->X, d);
+  }
+  //x = 0 时符号位必须为0
+  if (fe_isnonzero(h->X) == 0 && (s[31] >> 7) != 0) return -1;
+  if (fe_isnegative(h->X) != limb(s[31] >> 7)) fe_neg(h->X, h->X);
+  fe_mul(h->T, h->X, h->Y);
+  return 0;
+}
+
+static inline void ge_p3_neg(ge_p3 *p) {
+  fe_neg(p->X, p->X);
+  fe_neg(p->T, p->T);
+}
+
+static inline void ge_p2_tobytes(u8 *s, const ge_p2 *h) {
+  felem recip, x, y;
+  fe_invert(recip, h->Z);
+  fe_mul(x, h->X, recip);
+  fe_mul(y, h->Y, recip);
+  fe_tobytes(s, y);
+  s[31] ^= static_cast<u8>(fe_isnegative(x) << 7);
+}
+
+//转换为预计算点, 需要一次求逆, 只用于建表
+static inline void ge_p3_to_precomp(ge_precomp *r, const ge_p3 *p) {
+  felem recip, x, y, d2;
+  fe_invert(recip, p->Z);
+  fe_mul(x, p->X, recip);
+  fe_mul(y, p->Y, recip);
+  fe_add(r->yplusx, y, x);
+  fe_sub(r->yminusx, y, x);
+  fe_ed25519_d2(d2);
+  fe_mul(r->xy2d, x, y);
+  fe_mul(r->xy2d, r->xy2d, d2);
+}
+
+//flag为1时 t = u, 不使用分支
+static inline void ge_precomp_cmov(ge_precomp *t, const ge_precomp *u, limb flag) {
+  fe_cmov(t->yplusx, u->yplusx, flag);
+  fe_cmov(t->yminusx, u->yminusx, flag);
+  fe_cmov(t->xy2d, u->xy2d, flag);
+}
+
+//压缩编码: y的32字节小端序, 最高位为x的符号
+static inline void ge_p3_tobytes(u8 *s, const ge_p3 *h) {
+  felem recip, x, y;
+  fe_invert(recip, h->Z);
+  fe_mul(x, h->X, recip);
+  fe_mul(y, h->Y, recip);
+  fe_tobytes(s, y);
+  s[31] ^= static_cast<u8>(fe_isnegative(x) << 7);
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <cstdint>
+#include <sycl/sycl.hpp>
+
+/* 可在SYCL内核中调用的curve25519有限域运算(2^51进制, 5个limb)。
+ * 与curve25519_donna.cpp中按运算拆分内核的实现不同, 这里的每个函数都是纯计算,
+ * 一个work-item即可独立完成一次完整的标量乘法, 供批量内核和主机端引擎复用。
+ * 内核中不使用128位整数, 64x64位乘法的高位通过mul_hi取得。              */
+
+typedef uint8_t u8;
+typedef uint64_t limb;
+typedef limb felem[5];
+
+//128位中间结果: lo为低64位, hi为高64位
+struct fe_u128 {
+  limb lo, hi;
+};
+
+static inline fe_u128 fe_mul64(limb a, limb b) {
+#ifdef __SYCL_DEVICE_ONLY__
+  return {a * b, sycl::mul_hi(a, b)};
+#else
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  return {static_cast<limb>(r), static_cast<limb>(r >> 64)};
+#endif
+}
+
+// r += x
+static inline void fe_add128(fe_u128 &r, fe_u128 x) {
+  r.lo += x.lo;
+  r.hi += x.hi + (r.lo < x.lo);
+}
+
+// r += x (x为64位)
+static inline void fe_add64(fe_u128 &r, limb x) {
+  r.lo += x;
+  r.hi += (r.lo < x);
+}
+
+//取出低51位
+static inline limb fe_lo51(fe_u128 x) { return x.lo & 0x7ffffffffffff; }
+
+//右移51位(结果不超过64位)
+static inline limb fe_shr51(fe_u128 x) { return (x.lo >> 51) | (x.hi << 13); }
+
+static inline void fe_copy(felem out, const felem in) {
+  for (int i = 0; i < 5; ++i) out[i] = in[i];
+}
+
+static inline void fe_0(felem out) {
+  for (int i = 0; i < 5; ++i) out[i] = 0;
+}
+
+static inline void fe_1(felem out) {
+  out[0] = 1;
+  for (int i = 1; i < 5; ++i) out[i] = 0;
+}
+
+// out = a + b (不做进位)
+static inline void fe_add(felem out, const felem a, const felem b) {
+  for (int i = 0; i < 5; ++i) out[i] = a[i] + b[i];
+}
+
+/* out = a - b, 先对 b 进位使 b[i] < 2^51, 再加上2p防止下溢
+   执行后 out[i] < a[i] + 2^52 */
+static inline void fe_sub(felem out, const felem a, const felem b) {
+  limb t[5];
+  for (int i = 0; i < 5; ++i) t[i] = b[i];
+  t[1] += t[0] >> 51; t[0] &= 0x7ffffffffffff;
+  t[2] += t[1] >> 51; t[1] &= 0x7ffffffffffff;
+  t[3] += t[2] >> 51; t[2] &= 0x7ffffffffffff;
+  t[4] += t[3] >> 51; t[3] &= 0x7ffffffffffff;
+  t[0] += 19 * (t[4] >> 51); t[4] &= 0x7ffffffffffff;
+
+  out[0] = a[0] + 0xfffffffffffda - t[0];
+  out[1] = a[1] + 0xffffffffffffe - t[1];
+  out[2] = a[2] + 0xffffffffffffe - t[2];
+  out[3] = a[3] + 0xffffffffffffe - t[3];
+  out[4] = a[4] + 0xffffffffffffe - t[4];
+}
+
+//对5个128位系数进位规约, 结果 out[i] < 2^52
+static inline void fe_carry(felem out, fe_u128 t[5]) {
+  limb c;
+                        out[0] = fe_lo51(t[0]); c = fe_shr51(t[0]);
+  fe_add64(t[1], c);    out[1] = fe_lo51(t[1]); c = fe_shr51(t[1]);
+  fe_add64(t[2], c);    out[2] = fe_lo51(t[2]); c = fe_shr51(t[2]);
+  fe_add64(t[3], c);    out[3] = fe_lo51(t[3]); c = fe_shr51(t[3]);
+  fe_add64(t[4], c);    out[4] = fe_lo51(t[4]); c = fe_shr51(t[4]);
+
+  out[0] += c * 19; c = out[0] >> 51; out[0] &= 0x7ffffffffffff;
+  out[1] += c;
+}
+
+/* out = a * b, 允许 out 与输入重叠
+   执行前 a[i],b[i] < 2^54；执行后 out[i] < 2^52 */
+static inline void fe_mul(felem out, const felem a, const felem b) {
+  const limb b1_19 = b[1] * 19, b2_19 = b[2] * 19, b3_19 = b[3] * 19, b4_19 = b[4] * 19;
+  fe_u128 t[5];
+
+  t[0] = fe_mul64(a[0], b[0]);
+  fe_add128(t[0], fe_mul64(a[1], b4_19));
+  fe_add128(t[0], fe_mul64(a[2], b3_19));
+  fe_add128(t[0], fe_mul64(a[3], b2_19));
+  fe_add128(t[0], fe_mul64(a[4], b1_19));
+
+  t[1] = fe_mul64(a[0], b[1]);
+  fe_add128(t[1], fe_mul64(a[1], b[0]));
+  fe_add128(t[1], fe_mul64(a[2], b4_19));
+  fe_add128(t[1], fe_mul64(a[3], b3_19));
+  fe_add128(t[1], fe_mul64(a[4], b2_19));
+
+  t[2] = fe_mul64(a[0], b[2]);
+  fe_add128(t[2], fe_mul64(a[1], b[1]));
+  fe_add128(t[2], fe_mul64(a[2], b[0]));
+  fe_add128(t[2], fe_mul64(a[3], b4_19));
+  fe_add128(t[2], fe_mul64(a[4], b3_19));
+
+  t[3] = fe_mul64(a[0], b[3]);
+  fe_add128(t[3], fe_mul64(a[1], b[2]));
+  fe_add128(t[3], fe_mul64(a[2], b[1]));
+  fe_add128(t[3], fe_mul64(a[3], b[0]));
+  fe_add128(t[3], fe_mul64(a[4], b4_19));
+
+  t[4] = fe_mul64(a[0], b[4]);
+  fe_add128(t[4], fe_mul64(a[1], b[3]));
+  fe_add128(t[4], fe_mul64(a[2], b[2]));
+  fe_add128(t[4], fe_mul64(a[3], b[1]));
+  fe_add128(t[4], fe_mul64(a[4], b[0]));
+
+  fe_carry(out, t);
+}
+
+// out = in^2, 允许 out 与 in 重叠
+static inline void fe_sq(felem out, const felem in) {
+  const limb d0 = in[0] * 2, d1 = in[1] * 2, d2 = in[2] * 2 * 19, d419 = in[4] * 19, d4 = d419 * 2;
+  fe_u128 t[5];
+
+  t[0] = fe_mul64(in[0], in[0]);
+  fe_add128(t[0], fe_mul64(d4, in[1]));
+  fe_add128(t[0], fe_mul64(d2, in[3]));
+
+  t[1] = fe_mul64(d0, in[1]);
+  fe_add128(t[1], fe_mul64(d4, in[2]));
+  fe_add128(t[1], fe_mul64(in[3], in[3] * 19));
+
+  t[2] = fe_mul64(d0, in[2]);
+  fe_add128(t[2], fe_mul64(in[1], in[1]));
+  fe_add128(t[2], fe_mul64(d4, in[3]));
+
+  t[3] = fe_mul64(d0, in[3]);
+  fe_add128(t[3], fe_mul64(d1, in[2]));
+  fe_add128(t[3], fe_mul64(in[4], d419));
+
+  t[4] = fe_mul64(d0, in[4]);
+  fe_add128(t[4], fe_mul64(d1, in[3]));
+  fe_add128(t[4], fe_mul64(in[2], in[2]));
+
+  fe_carry(out, t);
+}
+
+// out = in^(2^count)
+static inline void fe_sq_times(felem out, const felem in, int count) {
+  fe_sq(out, in);
+  while (--count > 0) fe_sq(out, out);
+}
+
+// out = in * scalar, scalar < 2^32
+static inline void fe_mul_small(felem out, const felem in, limb scalar) {
+  fe_u128 t[5];
+  for (int i = 0; i < 5; ++i) t[i] = fe_mul64(in[i], scalar);
+  fe_carry(out, t);
+}
+
+//求逆元 out = z^(p-2), 运算链与crecip相同
+static inline void fe_invert(felem out, const felem z) {
+  felem a, t0, b, c;
+  fe_sq(a, z);
+  fe_sq_times(t0, a, 2);
+  fe_mul(b, t0, z);
+  fe_mul(a, b, a);
+  fe_sq(t0, a);
+  fe_mul(b, t0, b);
+  fe_sq_times(t0, b, 5);
+  fe_mul(b, t0, b);
+  fe_sq_times(t0, b, 10);
+  fe_mul(c, t0, b);
+  fe_sq_times(t0, c, 20);
+  fe_mul(t0, t0, c);
+  fe_sq_times(t0, t0, 10);
+  fe_mul(b, t0, b);
+  fe_sq_times(t0, b, 50);
+  fe_mul(c, t0, b);
+  fe_sq_times(t0, c, 100);
+  fe_mul(t0, t0, c);
+  fe_sq_times(t0, t0, 50);
+  fe_mul(t0, t0, b);
+  fe_sq_times(t0, t0, 5);
+  fe_mul(out, t0, a);
+}
+
+//iswap为1时交换a和b, 为0时不变, 不使用分支(防止侧信道泄漏信息)
+static inline void fe_cswap(felem a, felem b, limb iswap) {
+  const limb mask = 0 - iswap;
+  for (int i = 0; i < 5; ++i) {
+    const limb x = mask & (a[i] ^ b[i]);
+    a[i] ^= x;
+    b[i] ^= x;
+  }
+}
+
+//flag为1时 out = in, 为0时不变, 不使用分支
+static inline void fe_cmov(felem out, const felem in, limb flag) {
+  const limb mask = 0 - flag;
+  for (int i = 0; i < 5; ++i) out[i] ^= mask & (out[i] ^ in[i]);
+}
+
+// out = -in
+static inline void fe_neg(felem out, const felem in) {
+  felem zero;
+  fe_0(zero);
+  fe_sub(out, zero, in);
+}
+
+//读取8个字节(小端序)
+static inline limb fe_load_limb(const u8 *in) {
+  limb r = 0;
+  for (int i = 0; i < 8; ++i) r |= static_cast<limb>(in[i]) << (8 * i);
+  return r;
+}
+
+static inline void fe_store_limb(u8 *out, limb in) {
+  for (int i = 0; i < 8; ++i) out[i] = static_cast<u8>(in >> (8 * i));
+}
+
+//32字节小端序数据转换为域元素, 忽略最高位
+static inline void fe_frombytes(felem out, const u8 *in) {
+  out[0] = fe_load_limb(in) & 0x7ffffffffffff;
+  out[1] = (fe_load_limb(in + 6) >> 3) & 0x7ffffffffffff;
+  out[2] = (fe_load_limb(in + 12) >> 6) & 0x7ffffffffffff;
+  out[3] = (fe_load_limb(in + 19) >> 1) & 0x7ffffffffffff;
+  out[4] = (fe_load_limb(in + 24) >> 12) & 0x7ffffffffffff;
+}
+
+//完全规约后输出32字节(小端序), 过程与fcontract相同
+static inline void fe_tobytes(u8 *out, const felem in) {
+  limb t[5];
+  for (int i = 0; i < 5; ++i) t[i] = in[i];
+
+  for (int r = 0; r < 2; ++r) {
+    t[1] += t[0] >> 51; t[0] &= 0x7ffffffffffff;
+    t[2] += t[1] >> 51; t[1] &= 0x7ffffffffffff;
+    t[3] += t[2] >> 51; t[2] &= 0x7ffffffffffff;
+    t[4] += t[3] >> 51; t[3] &= 0x7ffffffffffff;
+    t[0] += 19 * (t[4] >> 51); t[4] &= 0x7ffffffffffff;
+  }
+
+  t[0] += 19;
+  t[1] += t[0] >> 51; t[0] &= 0x7ffffffffffff;
+  t[2] += t[1] >> 51; t[1] &= 0x7ffffffffffff;
+  t[3] += t[2] >> 51; t[2] &= 0x7ffffffffffff;
+  t[4] += t[3] >> 51; t[3] &= 0x7ffffffffffff;
+  t[0] += 19 * (t[4] >> 51); t[4] &= 0x7ffffffffffff;
+
+  t[0] += 0x8000000000000 - 19;
+  t[1] += 0x8000000000000 - 1;
+  t[2] += 0x8000000000000 - 1;
+  t[3] += 0x8000000000000 - 1;
+  t[4] += 0x8000000000000 - 1;
+
+  t[1] += t[0] >> 51; t[0] &= 0x7ffffffffffff;
+  t[2] += t[1] >> 51; t[1] &= 0x7ffffffffffff;
+  t[3] += t[2] >> 51; t[2] &= 0x7ffffffffffff;
+  t[4] += t[3] >> 51; t[3] &= 0x7ffffffffffff;
+  t[4] &= 0x7ffffffffffff;
+
+  fe_store_limb(out, t[0] | (t[1] << 51));
+  fe_store_limb(out + 8, (t[1] >> 13) | (t[2] << 38));
+  fe_store_limb(out + 16, (t[2] >> 26) | (t[3] << 25));
+  fe_store_limb(out + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+/* 单个work-item完成的curve25519标量乘法: mypublic = secret * basepoint
+ * 使用RFC 7748中的蒙哥马利阶梯, 每一位的处理完全相同(常数时间) */
+static inline void curve25519_scalarmult_item(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+  u8 e[32];
+  for (int i = 0; i < 32; ++i) e[i] = secret[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  felem x1, x2, z2, x3, z3, a, aa, b, bb, ee, c, d, da, cb;
+  fe_frombytes(x1, basepoint);
+  fe_1(x2);
+  fe_0(z2);
+  fe_copy(x3, x1);
+  fe_1(z3);
+
+  limb swap = 0;
+  for (int pos = 254; pos >= 0; --pos) {
+    const limb bit = (e[pos >> 3] >> (pos & 7)) & 1;
+    swap ^= bit;
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+    swap = bit;
+
+    fe_add(a, x2, z2);      // A = x2 + z2
+    fe_sq(aa, a);           // AA = A^2
+    fe_sub(b, x2, z2);      // B = x2 - z2
+    fe_sq(bb, b);           // BB = B^2
+    fe_sub(ee, aa, bb);     // E = AA - BB
+    fe_add(c, x3, z3);      // C = x3 + z3
+    fe_sub(d, x3, z3);      // D = x3 - z3
+    fe_mul(da, d, a);       // DA = D * A
+    fe_mul(cb, c, b);       // CB = C * B
+    fe_add(x3, da, cb);
+    fe_sq(x3, x3);          // x3 = (DA + CB)^2
+    fe_sub(z3, da, cb);
+    fe_sq(z3, z3);
+    fe_mul(z3, z3, x1);     // z3 = x1 * (DA - CB)^2
+    fe_mul(x2, aa, bb);     // x2 = AA * BB
+    fe_mul_small(z2, ee, 121665);
+    fe_add(z2, z2, aa);
+    fe_mul(z2, z2, ee);     // z2 = E * (AA + a24 * E)
+  }
+  fe_cswap(x2, x3, swap);
+  fe_cswap(z2, z3, swap);
+
+  fe_invert(z2, z2);
+  fe_mul(x2, x2, z2);
+  fe_tobytes(mypublic, x2);
+}
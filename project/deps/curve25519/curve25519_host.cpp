@@ -0,0 +1,101 @@
+#include "curve25519_host.h"
+#include "curve25519_stats.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include "curve25519_field.h"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+//每个工作线程暂存一块任务的输入, 最多 HOST_CHUNK 个
+#define HOST_CHUNK 64
+
+int curve25519_donna_host(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+  curve25519_perf_scope perf("curve25519_donna_host");
+  CURVE25519_TRACE_SCOPE("curve25519_donna_host");
+  curve25519_scalarmult_item(mypublic, secret, basepoint);
+  CURVE25519_COUNT(C25519_SCALARMULT, 1);
+  return 0;
+}
+
+host_pool *curve25519_host_pool() {
+  static std::once_flag once;
+  static host_pool *pool = nullptr;
+  std::call_once(once, [] { pool = host_pool_create(0, 64 * HOST_CHUNK, true); });
+  return pool;
+}
+
+int curve25519_donna_host_batch(host_pool *pool, u8 *mypublic, const u8 *secret,
+                                const u8 *basepoint, size_t n) {
+  if (n == 0) return 0;
+  if (pool == nullptr) pool = curve25519_host_pool();
+  curve25519_perf_scope perf("curve25519_donna_host_batch", n);
+  CURVE25519_TRACE_SCOPE("curve25519_donna_host_batch");
+  CURVE25519_COUNT(C25519_SCALARMULT, n);
+
+  //每个线程至少分到几块, 以便先完成的线程可以窃取
+  size_t chunk = n / (host_pool_size(pool) * 4);
+  if (chunk == 0) chunk = 1;
+  if (chunk > HOST_CHUNK) chunk = HOST_CHUNK;
+
+  host_pool_parallel_for(pool, n, chunk, [=](size_t begin, size_t end, size_t worker) {
+    //输入先复制到本线程NUMA本地的暂存内存中再计算
+    u8 *scratch = static_cast<u8 *>(host_pool_scratch(pool, worker));
+    if (scratch == nullptr) {
+      for (size_t i = begin; i < end; ++i) {
+        curve25519_scalarmult_item(mypublic + 32 * i, secret + 32 * i, basepoint + 32 * i);
+      }
+      return;
+    }
+    const size_t count = end - begin;
+    memcpy(scratch, secret + 32 * begin, 32 * count);
+    memcpy(scratch + 32 * count, basepoint + 32 * begin, 32 * count);
+    for (size_t i = 0; i < count; ++i) {
+      curve25519_scalarmult_item(mypublic + 32 * (begin + i), scratch + 32 * i, scratch + 32 * (count + i));
+    }
+    memset(scratch, 0, 32 * count);   //清除私钥副本
+  });
+  return 0;
+}
+
+//测试样例6: 主机端单次和批量引擎的结果与curve25519_donna一致
+int test6() {
+  const size_t n = 37;
+  u8 secret[n * 32], basepoint[n * 32], out[n * 32], expect[32], single[32];
+
+  for (size_t i = 0; i < n * 32; ++i) {
+    secret[i] = static_cast<u8>(i * 3 + 17);
+    basepoint[i] = static_cast<u8>(i * 29 + 9);
+  }
+  host_pool *pool = host_pool_create(3, 64 * HOST_CHUNK, false);
+  curve25519_donna_host_batch(pool, out, secret, basepoint, n);
+  host_pool_destroy(pool);
+
+  for (size_t i = 0; i < n; i += 6) {
+    curve25519_donna(expect, secret + 32 * i, basepoint + 32 * i);
+    curve25519_donna_host(single, secret + 32 * i, basepoint + 32 * i);
+    if (memcmp(out + 32 * i, expect, 32) != 0 || memcmp(single, expect, 32) != 0) {
+      fprintf(stderr, "主机端标量乘法结果有误\n");
+      return 1;
+    }
+  }
+
+  //大量极小的parallel_for: 调用者返回并销毁栈上的任务之后, 工作线程不能再访问它
+  pool = host_pool_create(4, 0, false);
+  std::atomic<size_t> sum{0};
+  size_t want = 0;
+  for (size_t i = 0; i < 20000; ++i) {
+    const size_t tasks = 1 + i % 3;
+    host_pool_parallel_for(pool, tasks, 1, [&](size_t begin, size_t end, size_t) {
+      sum.fetch_add(end - begin, std::memory_order_relaxed);
+    });
+    want += tasks;
+  }
+  host_pool_destroy(pool);
+  if (sum.load() != want) {
+    fprintf(stderr, "线程池任务计数有误\n");
+    return 1;
+  }
+  fprintf(stderr, "主机端标量乘法结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include "curve25519_donna.h"
+#include "host_pool.h"
+
+/* 不使用SYCL的主机端引擎, 与批量内核共用curve25519_field.h中的有限域运算 */
+
+//单次标量乘法, 在调用线程上完成
+int curve25519_donna_host(u8 *mypublic, const u8 *secret, const u8 *basepoint);
+
+//默认线程池: 每个可用CPU一个绑定的工作线程, 首次调用时创建
+host_pool *curve25519_host_pool();
+
+/* 批量标量乘法: 任务按块切分到线程池的工作线程上, 由工作窃取平衡负载
+ * pool 为空时使用默认线程池, 自建线程池的暂存内存不能小于 64*64 字节 */
+int curve25519_donna_host_batch(host_pool *pool, u8 *mypublic, const u8 *secret,
+                                const u8 *basepoint, size_t n);
+
+int test6();
@@ -0,0 +1,239 @@
+#include "curve25519_keypool.h"
+#include "curve25519_async.h"
+#include "curve25519_host.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+//一个槽, 按缓存行对齐避免相邻槽之间的伪共享
+struct alignas(64) keypool_slot {
+  std::atomic<uint64_t> seq;   //等于放入位置时可放入, 等于放入位置+1时可取出
+  u8 private_key[32];
+  u8 public_key[32];
+};
+
+struct curve25519_keypool {
+  keypool_slot *slots;   //sodium_malloc分配
+  size_t capacity, mask, batch, low;
+  alignas(64) std::atomic<uint64_t> enqueue_pos{0};
+  alignas(64) std::atomic<uint64_t> dequeue_pos{0};
+  alignas(64) std::atomic<uint32_t> wake{0};   //每次唤醒加一, 后台线程在上面等待
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> popped{0}, empty{0}, generated{0}, batches{0};
+  u8 *staging;           //批量生成的私钥和公钥, sodium_malloc分配
+  u8 *basepoints;
+  std::thread generator;
+};
+
+static size_t keypool_ready(const curve25519_keypool *pool) {
+  const uint64_t enq = pool->enqueue_pos.load(std::memory_order_acquire);
+  const uint64_t deq = pool->dequeue_pos.load(std::memory_order_acquire);
+  return enq > deq ? size_t(enq - deq) : 0;
+}
+
+//只有后台线程放入, 槽位被占用(池已满或取出者还没有释放槽位)时返回-1
+static int keypool_push(curve25519_keypool *pool, const u8 *private_key, const u8 *public_key) {
+  uint64_t pos = pool->enqueue_pos.load(std::memory_order_relaxed);
+  keypool_slot *slot;
+  for (;;) {
+    slot = &pool->slots[pos & pool->mask];
+    const int64_t diff = int64_t(slot->seq.load(std::memory_order_acquire)) - int64_t(pos);
+    if (diff == 0) {
+      if (pool->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = pool->enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  memcpy(slot->private_key, private_key, 32);
+  memcpy(slot->public_key, public_key, 32);
+  slot->seq.store(pos + 1, std::memory_order_release);
+  return 0;
+}
+
+int curve25519_keypool_pop(curve25519_keypool *pool, u8 *private_key, u8 *public_key) {
+  uint64_t pos = pool->dequeue_pos.load(std::memory_order_relaxed);
+  keypool_slot *slot;
+  for (;;) {
+    slot = &pool->slots[pos & pool->mask];
+    const int64_t diff = int64_t(slot->seq.load(std::memory_order_acquire)) - int64_t(pos + 1);
+    if (diff == 0) {
+      if (pool->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      pool->empty.fetch_add(1, std::memory_order_relaxed);
+      pool->wake.fetch_add(1, std::memory_order_release);
+      pool->wake.notify_one();
+      return -1;
+    } else {
+      pos = pool->dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  memcpy(private_key, slot->private_key, 32);
+  memcpy(public_key, slot->public_key, 32);
+  sodium_memzero(slot->private_key, 32);
+  slot->seq.store(pos + pool->mask + 1, std::memory_order_release);
+  pool->popped.fetch_add(1, std::memory_order_relaxed);
+  //降到一半以下时唤醒后台线程, 没有线程等待时notify_one不进入内核
+  if (keypool_ready(pool) <= pool->low) {
+    pool->wake.fetch_add(1, std::memory_order_release);
+    pool->wake.notify_one();
+  }
+  return 0;
+}
+
+//生成n个密钥对并放入池中; SYCL批量内核出错时改用主机端线程池
+static void keypool_refill(curve25519_keypool *pool, size_t n) {
+  CURVE25519_TRACE_SCOPE("curve25519_keypool_refill");
+  u8 *secret = pool->staging, *pub = pool->staging + 32 * pool->batch;
+  randombytes_buf(secret, 32 * n);
+  if (curve25519_donna_batch(pub, secret, pool->basepoints, n) != 0 &&
+      curve25519_donna_host_batch(nullptr, pub, secret, pool->basepoints, n) != 0) {
+    fprintf(stderr, "密钥对池生成公钥失败\n");
+    sodium_memzero(secret, 32 * n);
+    return;
+  }
+  /* n不超过空闲槽数, 放入失败只是因为某个取出者已推进dequeue_pos但还没有释放槽位:
+   * 保留未放入的密钥对, 让出CPU后继续放入, 不重新生成整批 */
+  size_t pushed = 0;
+  while (pushed < n && !pool->stop.load(std::memory_order_relaxed)) {
+    if (keypool_push(pool, secret + 32 * pushed, pub + 32 * pushed) == 0) {
+      ++pushed;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  sodium_memzero(secret, 32 * n);
+  pool->generated.fetch_add(pushed, std::memory_order_relaxed);
+  pool->batches.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void keypool_run(curve25519_keypool *pool) {
+  while (!pool->stop.load(std::memory_order_acquire)) {
+    //先读唤醒序号再检查数量, 检查之后的唤醒会让wait立即返回
+    const uint32_t seen = pool->wake.load(std::memory_order_acquire);
+    if (keypool_ready(pool) > pool->low) {
+      pool->wake.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+    //补满为止, 每批不超过batch个
+    for (size_t free = pool->capacity - keypool_ready(pool); free > 0 && !pool->stop.load(std::memory_order_relaxed);
+         free = pool->capacity - keypool_ready(pool)) {
+      keypool_refill(pool, free < pool->batch ? free : pool->batch);
+    }
+  }
+}
+
+curve25519_keypool *curve25519_keypool_create(size_t capacity, size_t batch) {
+  size_t cap = 2;
+  while (cap < capacity) cap <<= 1;
+  if (batch == 0 || batch > cap) batch = cap / 2;
+  //sodium_malloc需要sodium_init得到页大小, 重复调用没有影响
+  if (sodium_init() < 0) return nullptr;
+  void *slots = sodium_allocarray(cap, sizeof(keypool_slot));
+  u8 *staging = static_cast<u8 *>(sodium_allocarray(batch, 64));
+  if (slots == nullptr || staging == nullptr) {
+    fprintf(stderr, "密钥对池分配内存失败\n");
+    if (slots != nullptr) sodium_free(slots);
+    if (staging != nullptr) sodium_free(staging);
+    return nullptr;
+  }
+  curve25519_keypool *pool = new curve25519_keypool;
+  pool->slots = static_cast<keypool_slot *>(slots);
+  for (size_t i = 0; i < cap; ++i) {
+    new (&pool->slots[i]) keypool_slot;
+    pool->slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+  pool->capacity = cap;
+  pool->mask = cap - 1;
+  pool->batch = batch;
+  pool->low = cap / 2;
+  pool->staging = staging;
+  pool->basepoints = new u8[32 * batch]();
+  for (size_t i = 0; i < batch; ++i) pool->basepoints[32 * i] = 9;
+  pool->generator = std::thread(keypool_run, pool);
+  return pool;
+}
+
+void curve25519_keypool_destroy(curve25519_keypool *pool) {
+  if (pool == nullptr) return;
+  pool->stop.store(true, std::memory_order_release);
+  pool->wake.fetch_add(1, std::memory_order_release);
+  pool->wake.notify_one();
+  pool->generator.join();
+  //sodium_free释放前会擦除内容
+  for (size_t i = 0; i < pool->capacity; ++i) pool->slots[i].~keypool_slot();
+  sodium_free(pool->slots);
+  sodium_free(pool->staging);
+  delete[] pool->basepoints;
+  delete pool;
+}
+
+void curve25519_keypool_get_stats(curve25519_keypool *pool, curve25519_keypool_stats *out) {
+  out->popped = pool->popped.load(std::memory_order_relaxed);
+  out->empty = pool->empty.load(std::memory_order_relaxed);
+  out->generated = pool->generated.load(std::memory_order_relaxed);
+  out->batches = pool->batches.load(std::memory_order_relaxed);
+  out->ready = keypool_ready(pool);
+}
+
+//测试样例19: 取出的密钥对公钥正确且互不相同, 取空后后台线程重新补满, 多线程取出不重复
+int test19() {
+  const u8 base[32] = {9};
+  curve25519_keypool *pool = curve25519_keypool_create(8, 4);
+  bool ok = pool != nullptr;
+  auto wait_full = [&](size_t want) {
+    for (int i = 0; i < 5000 && keypool_ready(pool) < want; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return keypool_ready(pool) >= want;
+  };
+  std::vector<std::vector<u8>> seen;
+  u8 sk[32], pk[32], expect[32];
+  for (int round = 0; round < 2 && ok; ++round) {
+    ok = wait_full(8);
+    for (int i = 0; i < 8 && ok; ++i) {
+      ok = curve25519_keypool_pop(pool, sk, pk) == 0 && curve25519_donna(expect, sk, base) == 0 &&
+           memcmp(expect, pk, 32) == 0;
+      for (const std::vector<u8> &s : seen) ok = ok && memcmp(s.data(), sk, 32) != 0;
+      seen.emplace_back(sk, sk + 32);
+    }
+  }
+
+  //多线程同时取出, 每个密钥对只被取出一次
+  ok = ok && wait_full(8);
+  std::vector<std::vector<u8>> taken(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      u8 s[32], p[32];
+      for (int i = 0; i < 16; ++i) {
+        if (curve25519_keypool_pop(pool, s, p) == 0) taken[t].insert(taken[t].end(), s, s + 32);
+      }
+    });
+  }
+  for (std::thread &t : threads) t.join();
+  std::vector<std::vector<u8>> all;
+  for (const std::vector<u8> &v : taken) {
+    for (size_t i = 0; i < v.size(); i += 32) all.emplace_back(v.begin() + i, v.begin() + i + 32);
+  }
+  for (size_t i = 0; i < all.size() && ok; ++i) {
+    for (size_t j = i + 1; j < all.size(); ++j) ok = ok && all[i] != all[j];
+  }
+  curve25519_keypool_stats st;
+  if (pool != nullptr) {
+    curve25519_keypool_get_stats(pool, &st);
+    ok = ok && all.size() >= 8 && st.popped == 16 + all.size() && st.batches > 0;
+  }
+  curve25519_keypool_destroy(pool);
+  if (!ok) {
+    fprintf(stderr, "密钥对池结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "密钥对池结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+typedef uint8_t u8;
+
+/* 临时密钥对池: 后台线程批量生成(私钥, 公钥), 放入无锁的有界环形队列, 握手时O(1)取出。
+ * 队列按Vyukov的MPMC算法实现, 每个槽有一个序号, 放入和取出都只用一次CAS, 不使用锁;
+ * 剩余数量降到一半时唤醒后台线程, 按批用 curve25519_donna_batch(按调优结果选择引擎)补满, 出错时改用主机端线程池。
+ * 槽位数组和生成用的暂存区由sodium_malloc分配(锁定内存, 不会被换出), 私钥取出后立即擦除。 */
+
+struct curve25519_keypool;
+
+struct curve25519_keypool_stats {
+  uint64_t popped;      //成功取出的密钥对
+  uint64_t empty;       //取出时池为空的次数
+  uint64_t generated;   //后台生成的密钥对
+  uint64_t batches;     //后台生成的批次
+  size_t ready;         //当前可取的密钥对
+};
+
+/* 创建并启动后台线程, capacity向上取整为2的幂, batch为每批生成的数量(0为capacity的一半)
+ * 失败返回空指针 */
+curve25519_keypool *curve25519_keypool_create(size_t capacity, size_t batch);
+
+//停止后台线程, 擦除并释放剩余的密钥对
+void curve25519_keypool_destroy(curve25519_keypool *pool);
+
+//取出一个密钥对, 池为空时返回-1(调用者自行生成), 不会阻塞
+int curve25519_keypool_pop(curve25519_keypool *pool, u8 *private_key, u8 *public_key);
+
+void curve25519_keypool_get_stats(curve25519_keypool *pool, curve25519_keypool_stats *out);
+
+int test19();
@@ -0,0 +1,295 @@
+#include "curve25519_log.h"
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#define LOG_RING_SIZE 256    //每个线程缓冲的记录数, 必须是2的幂
+
+std::atomic<int> curve25519_log_threshold {C25519_LOG_INFO};
+std::atomic<bool> curve25519_log_secrets {false};
+
+static const char *level_names[C25519_LOG_OFF] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+//单生产者单消费者的环形缓冲区: 所属线程写head, 后台线程写tail
+struct log_ring {
+  curve25519_log_record rec[LOG_RING_SIZE];
+  std::atomic<uint64_t> head {0};
+  std::atomic<uint64_t> tail {0};
+  std::atomic<uint64_t> dropped {0};
+  std::atomic<bool> retired {false};   //所属线程已退出, 取空后由后台线程释放
+  uint64_t reported = 0;               //已报告的丢弃数, 只由后台线程访问
+  long tid = 0;
+};
+
+static std::mutex rings_mutex;                //保护 rings 列表
+static std::vector<log_ring *> rings;
+static std::mutex drain_mutex;                //同一时间只有一个线程取出并写出记录
+static FILE *log_out = nullptr;               //空指针表示标准输出
+static std::atomic<bool> writer_stop {false};
+static std::thread writer;
+static std::once_flag writer_once;
+
+//取出所有缓冲区中的记录, 按时间排序后写出; 调用者持有 drain_mutex, 返回写出的条数
+static size_t drain();
+
+static void stop_writer() {
+  writer_stop = true;
+  if (writer.joinable()) writer.join();
+  curve25519_log_flush();
+}
+
+//后台线程在第一条日志时启动, 空闲时每毫秒检查一次
+static void start_writer() {
+  writer = std::thread([] {
+    while (!writer_stop.load()) {
+      size_t n;
+      {
+        std::lock_guard<std::mutex> lock(drain_mutex);
+        n = drain();
+      }
+      if (n == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  atexit(stop_writer);
+}
+
+//线程退出时标记缓冲区, 记录仍由后台线程写出
+struct log_ring_owner {
+  log_ring *ring;
+  log_ring_owner() : ring(new log_ring) {
+    ring->tid = syscall(SYS_gettid);
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    rings.push_back(ring);
+  }
+  ~log_ring_owner() { ring->retired.store(true, std::memory_order_release); }
+};
+
+static log_ring *local_ring() {
+  static thread_local log_ring_owner owner;
+  std::call_once(writer_once, start_writer);
+  return owner.ring;
+}
+
+curve25519_log_record *curve25519_log_begin(int level, const char *fmt) {
+  log_ring *ring = local_ring();
+  const uint64_t h = ring->head.load(std::memory_order_relaxed);
+  if (h - ring->tail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+    ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  curve25519_log_record *r = &ring->rec[h & (LOG_RING_SIZE - 1)];
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  r->ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  r->fmt = fmt;
+  r->level = static_cast<uint8_t>(level);
+  r->nargs = 0;
+  r->used = 0;
+  return r;
+}
+
+void curve25519_log_commit(curve25519_log_record *r) {
+  (void)r;
+  log_ring *ring = local_ring();
+  ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+static void append_hex(std::string *out, const uint8_t *p, size_t n) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < n; ++i) {
+    out->push_back(digits[p[i] >> 4]);
+    out->push_back(digits[p[i] & 15]);
+  }
+}
+
+static void format_arg(std::string *out, const curve25519_log_record &r, int i) {
+  char num[32];
+  const uint64_t a = r.arg[i];
+  const size_t len = a >> 32, offset = (a >> 16) & 0xffff, copied = a & 0xffff;
+  switch (r.kind[i]) {
+    case LOG_ARG_INT:
+      snprintf(num, sizeof(num), "%lld", static_cast<long long>(a));
+      out->append(num);
+      break;
+    case LOG_ARG_UINT:
+      snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(a));
+      out->append(num);
+      break;
+    case LOG_ARG_DOUBLE: {
+      double d;
+      memcpy(&d, &a, sizeof(d));
+      snprintf(num, sizeof(num), "%g", d);
+      out->append(num);
+      break;
+    }
+    case LOG_ARG_STR:
+      out->append(r.payload + offset, copied);
+      break;
+    case LOG_ARG_SECRET:
+      if (copied == 0 && len != 0) {
+        out->append("<已隐藏" + std::to_string(len) + "字节>");
+        break;
+      }
+      [[fallthrough]];
+    case LOG_ARG_HEX:
+      append_hex(out, reinterpret_cast<const uint8_t *>(r.payload + offset), copied);
+      if (copied < len) out->append("...(共" + std::to_string(len) + "字节)");
+      break;
+  }
+}
+
+static void format_record(std::string *out, const curve25519_log_record &r, long tid) {
+  char head[64];
+  const time_t sec = r.ns / 1000000000ull;
+  struct tm tm;
+  localtime_r(&sec, &tm);
+  const size_t n = strftime(head, sizeof(head), "%H:%M:%S", &tm);
+  snprintf(head + n, sizeof(head) - n, ".%06lu %-5s [%ld] ", (unsigned long)(r.ns % 1000000000ull / 1000),
+           r.level < C25519_LOG_OFF ? level_names[r.level] : "?", tid);
+  out->append(head);
+  int next = 0;
+  for (const char *p = r.fmt; *p != '\0'; ++p) {
+    if (p[0] == '{' && p[1] == '}' && next < r.nargs) {
+      format_arg(out, r, next++);
+      ++p;
+    } else {
+      out->push_back(*p);
+    }
+  }
+  out->push_back('\n');
+}
+
+static size_t drain() {
+  std::vector<log_ring *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    snapshot = rings;
+  }
+  std::vector<std::pair<uint64_t, std::string>> lines;
+  for (log_ring *ring : snapshot) {
+    //先读retired再读head: 看到retired时head已是最终值, 取空后可以释放
+    const bool retired = ring->retired.load(std::memory_order_acquire);
+    const uint64_t h = ring->head.load(std::memory_order_acquire);
+    uint64_t t = ring->tail.load(std::memory_order_relaxed);
+    for (; t != h; ++t) {
+      lines.emplace_back(ring->rec[t & (LOG_RING_SIZE - 1)].ns, std::string());
+      format_record(&lines.back().second, ring->rec[t & (LOG_RING_SIZE - 1)], ring->tid);
+    }
+    ring->tail.store(t, std::memory_order_release);
+    const uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+    if (dropped != ring->reported) {
+      fprintf(stderr, "日志缓冲区已满, 线程%ld丢弃了%lu条日志\n", ring->tid,
+              (unsigned long)(dropped - ring->reported));
+      ring->reported = dropped;
+    }
+    if (retired) {
+      std::lock_guard<std::mutex> lock(rings_mutex);
+      rings.erase(std::find(rings.begin(), rings.end(), ring));
+      delete ring;
+    }
+  }
+  //各线程的缓冲区分别有序, 合并后按时间排序
+  std::stable_sort(lines.begin(), lines.end(),
+                   [](const auto &a, const auto &b) { return a.first < b.first; });
+  FILE *f = log_out != nullptr ? log_out : stdout;
+  for (const auto &line : lines) fwrite(line.second.data(), 1, line.second.size(), f);
+  if (!lines.empty()) fflush(f);
+  return lines.size();
+}
+
+void curve25519_log_flush() {
+  std::lock_guard<std::mutex> lock(drain_mutex);
+  drain();
+}
+
+int curve25519_log_open(const char *path) {
+  FILE *f = nullptr;
+  if (path != nullptr) {
+    f = fopen(path, "a");
+    if (f == nullptr) {
+      perror("fopen");
+      return -1;
+    }
+  }
+  std::lock_guard<std::mutex> lock(drain_mutex);
+  drain();   //之前的记录写到原来的位置
+  if (log_out != nullptr) fclose(log_out);
+  log_out = f;
+  return 0;
+}
+
+void curve25519_log_set_level(int level) {
+  curve25519_log_threshold.store(level, std::memory_order_relaxed);
+}
+
+static bool log_from_env() {
+  static const char *names[] = {"debug", "info", "warn", "error", "off"};
+  if (const char *level = getenv("CURVE25519_LOG_LEVEL")) {
+    for (int i = 0; i <= C25519_LOG_OFF; ++i) {
+      if (strcmp(level, names[i]) == 0) curve25519_log_set_level(i);
+    }
+  }
+  if (const char *path = getenv("CURVE25519_LOG_FILE")) curve25519_log_open(path);
+  const char *secrets = getenv("CURVE25519_LOG_SECRETS");
+  curve25519_log_secrets = secrets != nullptr && strcmp(secrets, "0") != 0;
+  return true;
+}
+static const bool log_env = log_from_env();
+
+//测试样例11: 多个线程的记录全部写出, 敏感数据默认不出现在输出中
+int test11() {
+  char path[] = "/tmp/curve25519_log_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  const uint8_t key[4] = {0xde, 0xad, 0xbe, 0xef};
+  const uint8_t pub[2] = {0x01, 0x2f};
+  const int old_level = curve25519_log_threshold.load();
+  const bool old_secrets = curve25519_log_secrets.load();
+  curve25519_log_set_level(C25519_LOG_INFO);
+  curve25519_log_secrets = false;
+  if (curve25519_log_open(path) != 0) return 1;
+
+  curve25519_log(C25519_LOG_DEBUG, "不应输出");
+  curve25519_log(C25519_LOG_INFO, "公钥 {} 私钥 {} 端口 {} 耗时 {}ms 来自 {}", curve25519_hex(pub, 2),
+                 curve25519_secret(key, 4), 10000, 1.5, "127.0.0.1");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < 100; ++i) curve25519_log(C25519_LOG_WARN, "线程{}第{}条", t, i);
+    });
+  }
+  for (auto &t : threads) t.join();
+  curve25519_log_flush();
+  curve25519_log_open(nullptr);
+  curve25519_log_set_level(old_level);
+  curve25519_log_secrets = old_secrets;
+
+  std::string text;
+  char chunk[4096];
+  FILE *f = fopen(path, "r");
+  size_t got;
+  while (f != nullptr && (got = fread(chunk, 1, sizeof(chunk), f)) > 0) text.append(chunk, got);
+  if (f != nullptr) fclose(f);
+  unlink(path);
+  const size_t lines = std::count(text.begin(), text.end(), '\n');
+  if (lines != 401 || text.find("不应输出") != std::string::npos || text.find("deadbeef") != std::string::npos ||
+      text.find("公钥 012f 私钥 <已隐藏4字节> 端口 10000 耗时 1.5ms 来自 127.0.0.1") == std::string::npos ||
+      text.find("线程3第99条") == std::string::npos) {
+    fprintf(stderr, "异步日志输出有误\n");
+    return 1;
+  }
+  fprintf(stderr, "异步日志输出正确。\n");
+  return 0;
+}
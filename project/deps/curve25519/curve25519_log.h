@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* 异步日志: 调用线程只把格式串指针和参数的二进制值写入线程私有的无锁环形缓冲区,
+ * 由后台线程格式化后写出, 关键路径上没有系统调用和锁。缓冲区满时丢弃并计数, 不阻塞调用者。
+ * 格式串必须是字符串常量, 用 {} 作为占位符。密钥等敏感数据用 curve25519_secret 包装,
+ * 默认只记录长度, 设置 CURVE25519_LOG_SECRETS=1 时才输出内容。
+ * 环境变量: CURVE25519_LOG_LEVEL=debug|info|warn|error|off, CURVE25519_LOG_FILE=文件名 */
+
+enum curve25519_log_level {
+  C25519_LOG_DEBUG = 0,
+  C25519_LOG_INFO,
+  C25519_LOG_WARN,
+  C25519_LOG_ERROR,
+  C25519_LOG_OFF
+};
+
+#define LOG_MAX_ARGS 6       //每条记录最多的参数个数
+#define LOG_PAYLOAD 256      //字符串和字节串参数共用的载荷, 超出部分截断
+
+enum log_arg_kind : uint8_t { LOG_ARG_INT, LOG_ARG_UINT, LOG_ARG_DOUBLE, LOG_ARG_STR, LOG_ARG_HEX, LOG_ARG_SECRET };
+
+//环形缓冲区中的一条记录, 字符串和字节串按值复制进载荷
+struct curve25519_log_record {
+  uint64_t ns;                   //CLOCK_REALTIME
+  const char *fmt;
+  uint8_t level;
+  uint8_t nargs;
+  uint16_t used;                 //载荷已用字节数
+  uint8_t kind[LOG_MAX_ARGS];
+  uint64_t arg[LOG_MAX_ARGS];    //数值参数的值; 载荷参数为 原始长度<<32 | 偏移<<16 | 复制长度
+  char payload[LOG_PAYLOAD];
+};
+
+//以十六进制输出的字节串
+struct curve25519_log_hex {
+  const void *data;
+  size_t len;
+};
+
+//敏感字节串, 默认只记录长度
+struct curve25519_log_secret {
+  const void *data;
+  size_t len;
+};
+
+inline curve25519_log_hex curve25519_hex(const void *data, size_t len) { return {data, len}; }
+inline curve25519_log_secret curve25519_secret(const void *data, size_t len) { return {data, len}; }
+
+extern std::atomic<int> curve25519_log_threshold;
+extern std::atomic<bool> curve25519_log_secrets;
+
+inline bool curve25519_log_enabled(int level) {
+  return level >= curve25519_log_threshold.load(std::memory_order_relaxed);
+}
+
+//在本线程的缓冲区中占用一条记录, 缓冲区满时返回空指针; 填好参数后调用 commit 交给后台线程
+curve25519_log_record *curve25519_log_begin(int level, const char *fmt);
+void curve25519_log_commit(curve25519_log_record *r);
+
+//把载荷参数复制进记录, 放不下的部分截断
+inline void curve25519_log_copy(curve25519_log_record *r, log_arg_kind kind, const void *data, size_t len) {
+  const size_t n = len < size_t(LOG_PAYLOAD - r->used) ? len : size_t(LOG_PAYLOAD - r->used);
+  if (n != 0) memcpy(r->payload + r->used, data, n);
+  r->kind[r->nargs] = kind;
+  r->arg[r->nargs++] = uint64_t(len) << 32 | uint64_t(r->used) << 16 | n;
+  r->used += n;
+}
+
+template <typename T>
+inline void curve25519_log_put(curve25519_log_record *r, const T &v) {
+  if constexpr (std::is_same_v<T, curve25519_log_hex>) {
+    curve25519_log_copy(r, LOG_ARG_HEX, v.data, v.len);
+  } else if constexpr (std::is_same_v<T, curve25519_log_secret>) {
+    //未允许输出时敏感数据不进入缓冲区
+    if (curve25519_log_secrets.load(std::memory_order_relaxed)) {
+      curve25519_log_copy(r, LOG_ARG_SECRET, v.data, v.len);
+    } else {
+      curve25519_log_copy(r, LOG_ARG_SECRET, nullptr, 0);
+      r->arg[r->nargs - 1] |= uint64_t(v.len) << 32;
+    }
+  } else if constexpr (std::is_convertible_v<T, const char *>) {
+    const char *s = v;
+    curve25519_log_copy(r, LOG_ARG_STR, s, s ? strlen(s) : 0);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    const double d = v;
+    r->kind[r->nargs] = LOG_ARG_DOUBLE;
+    memcpy(&r->arg[r->nargs++], &d, sizeof(d));
+  } else {
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "不支持的日志参数类型");
+    r->kind[r->nargs] = std::is_signed_v<T> ? LOG_ARG_INT : LOG_ARG_UINT;
+    r->arg[r->nargs++] = static_cast<uint64_t>(v);
+  }
+}
+
+//例: curve25519_log(C25519_LOG_INFO, "共享密钥: {}", curve25519_secret(key, 32));
+template <typename... Args>
+inline void curve25519_log(int level, const char *fmt, const Args &...args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "日志参数过多");
+  if (!curve25519_log_enabled(level)) return;
+  curve25519_log_record *r = curve25519_log_begin(level, fmt);
+  if (r == nullptr) return;
+  (curve25519_log_put(r, args), ...);
+  curve25519_log_commit(r);
+}
+
+//改为写到 path(追加), 空指针恢复为标准输出; 失败返回-1
+int curve25519_log_open(const char *path);
+void curve25519_log_set_level(int level);
+
+//等待已提交的记录全部写出, 进程退出时自动调用
+void curve25519_log_flush();
+
+int test11();
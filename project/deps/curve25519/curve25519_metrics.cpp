@@ -0,0 +1,318 @@
+#include "curve25519_metrics.h"
+#include "curve25519_stats.h"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum metric_type { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM };
+
+struct metric_desc {
+  const char *name;
+  const char *help;
+  metric_type type;
+};
+
+//线程私有的计数槽, 直方图的桶数组在该线程首次记录时分配
+struct metrics_slot {
+  std::atomic<int64_t> value[METRICS_MAX];                //计数器和仪表的值
+  std::atomic<uint64_t> sum[METRICS_MAX];                 //直方图记录值之和(纳秒)
+  std::atomic<std::atomic<uint64_t> *> hist[METRICS_MAX];
+  metrics_slot();
+  ~metrics_slot();
+};
+
+static std::mutex metrics_mutex;
+static metric_desc metrics[METRICS_MAX];
+static std::atomic<int> metric_count {0};
+static std::vector<metrics_slot *> live_slots;            //仍在运行的线程的计数槽
+static int64_t retired_value[METRICS_MAX];                //已退出线程的累计值
+static uint64_t retired_sum[METRICS_MAX];
+static std::vector<uint64_t> retired_hist[METRICS_MAX];
+
+//prometheus标签只能用ASCII, 与curve25519_counter的顺序一致
+static const char *stats_labels[C25519_COUNTER_MAX] = {
+  "submit", "wait", "buffer", "host_accessor", "usm_alloc", "usm_bytes", "thread", "scalarmult", "sign", "verify", "box",
+  "session_hit", "session_miss", "session_evict"
+};
+
+metrics_slot::metrics_slot() {
+  for (int i = 0; i < METRICS_MAX; ++i) {
+    value[i].store(0, std::memory_order_relaxed);
+    sum[i].store(0, std::memory_order_relaxed);
+    hist[i].store(nullptr, std::memory_order_relaxed);
+  }
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  live_slots.push_back(this);
+}
+
+metrics_slot::~metrics_slot() {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  for (int i = 0; i < METRICS_MAX; ++i) {
+    retired_value[i] += value[i].load(std::memory_order_relaxed);
+    retired_sum[i] += sum[i].load(std::memory_order_relaxed);
+    std::atomic<uint64_t> *h = hist[i].load(std::memory_order_relaxed);
+    if (h == nullptr) continue;
+    if (retired_hist[i].empty()) retired_hist[i].resize(METRICS_BUCKETS);
+    for (int b = 0; b < METRICS_BUCKETS; ++b) retired_hist[i][b] += h[b].load(std::memory_order_relaxed);
+    delete[] h;
+  }
+  live_slots.erase(std::find(live_slots.begin(), live_slots.end(), this));
+}
+
+static metrics_slot &local_slot() {
+  static thread_local metrics_slot slot;
+  return slot;
+}
+
+//对数线性分桶: 小于16的值各占一个桶, 之后每个2的幂区间按最高5位再分16个子桶
+static int bucket_of(uint64_t ns) {
+  if (ns < (1u << METRICS_SUB_BITS)) return static_cast<int>(ns);
+  const int e = 63 - __builtin_clzll(ns);
+  if (e > METRICS_MAX_EXP) return METRICS_BUCKETS - 1;
+  return ((e - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS) +
+         static_cast<int>((ns >> (e - METRICS_SUB_BITS)) & ((1u << METRICS_SUB_BITS) - 1));
+}
+
+//桶内的最大值(纳秒, 含)
+static uint64_t bucket_upper(int b) {
+  if (b < (1 << METRICS_SUB_BITS)) return b;
+  const int e = (b >> METRICS_SUB_BITS) + METRICS_SUB_BITS - 1;
+  const uint64_t sub = b & ((1 << METRICS_SUB_BITS) - 1);
+  const uint64_t width = 1ull << (e - METRICS_SUB_BITS);
+  return (((1ull << METRICS_SUB_BITS) + sub) << (e - METRICS_SUB_BITS)) + width - 1;
+}
+
+static int register_metric(const char *name, const char *help, metric_type type) {
+  std::lock_guard<std::mutex> lock(metrics_mutex);
+  const int id = metric_count.load(std::memory_order_relaxed);
+  if (id >= METRICS_MAX) {
+    fprintf(stderr, "指标数目超过%d, 忽略%s\n", METRICS_MAX, name);
+    return -1;
+  }
+  metrics[id] = {name, help, type};
+  metric_count.store(id + 1, std::memory_order_release);
+  return id;
+}
+
+int curve25519_metrics_counter(const char *name, const char *help) {
+  return register_metric(name, help, METRIC_COUNTER);
+}
+
+int curve25519_metrics_gauge(const char *name, const char *help) {
+  return register_metric(name, help, METRIC_GAUGE);
+}
+
+int curve25519_metrics_histogram(const char *name, const char *help) {
+  return register_metric(name, help, METRIC_HISTOGRAM);
+}
+
+//只有所属线程写入计数槽, 用relaxed读写代替原子加
+void curve25519_metrics_add(int id, int64_t n) {
+  if (id < 0) return;
+  std::atomic<int64_t> &v = local_slot().value[id];
+  v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void curve25519_metrics_observe(int id, uint64_t ns) {
+  if (id < 0) return;
+  metrics_slot &slot = local_slot();
+  std::atomic<uint64_t> *h = slot.hist[id].load(std::memory_order_relaxed);
+  if (h == nullptr) {
+    h = new std::atomic<uint64_t>[METRICS_BUCKETS];
+    for (int b = 0; b < METRICS_BUCKETS; ++b) h[b].store(0, std::memory_order_relaxed);
+    slot.hist[id].store(h, std::memory_order_release);   //抓取线程看到指针时桶已清零
+  }
+  std::atomic<uint64_t> &c = h[bucket_of(ns)];
+  c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  slot.sum[id].store(slot.sum[id].load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+}
+
+//汇总一个指标在所有线程上的值, 调用者持有 metrics_mutex; buckets 为空指针时不汇总直方图
+static int64_t total(int id, uint64_t *sum, uint64_t *buckets) {
+  int64_t v = retired_value[id];
+  if (sum != nullptr) *sum = retired_sum[id];
+  if (buckets != nullptr) {
+    for (int b = 0; b < METRICS_BUCKETS; ++b) buckets[b] = retired_hist[id].empty() ? 0 : retired_hist[id][b];
+  }
+  for (metrics_slot *s : live_slots) {
+    v += s->value[id].load(std::memory_order_relaxed);
+    if (sum != nullptr) *sum += s->sum[id].load(std::memory_order_relaxed);
+    std::atomic<uint64_t> *h = s->hist[id].load(std::memory_order_acquire);
+    if (buckets == nullptr || h == nullptr) continue;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) buckets[b] += h[b].load(std::memory_order_relaxed);
+  }
+  return v;
+}
+
+uint64_t curve25519_metrics_quantile(int id, double q) {
+  if (id < 0 || id >= metric_count.load(std::memory_order_acquire)) return 0;
+  std::vector<uint64_t> buckets(METRICS_BUCKETS);
+  {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    total(id, nullptr, buckets.data());
+  }
+  uint64_t count = 0;
+  for (uint64_t c : buckets) count += c;
+  if (count == 0) return 0;
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+  uint64_t seen = 0;
+  for (int b = 0; b < METRICS_BUCKETS; ++b) {
+    seen += buckets[b];
+    if (seen >= rank) return bucket_upper(b);
+  }
+  return bucket_upper(METRICS_BUCKETS - 1);
+}
+
+static void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(std::string *out, const char *fmt, ...) {
+  char line[512];
+  va_list ap;
+  va_start(ap, fmt);
+  const int n = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if (n > 0) out->append(line, std::min<size_t>(n, sizeof(line) - 1));
+}
+
+void curve25519_metrics_render(std::string *out) {
+  static const char *type_names[] = {"counter", "gauge", "histogram"};
+  std::vector<uint64_t> buckets(METRICS_BUCKETS);
+  const int n = metric_count.load(std::memory_order_acquire);
+  for (int id = 0; id < n; ++id) {
+    const metric_desc &m = metrics[id];
+    uint64_t sum = 0;
+    int64_t v;
+    {
+      std::lock_guard<std::mutex> lock(metrics_mutex);
+      v = total(id, &sum, m.type == METRIC_HISTOGRAM ? buckets.data() : nullptr);
+    }
+    appendf(out, "# HELP %s %s\n# TYPE %s %s\n", m.name, m.help, m.name, type_names[m.type]);
+    if (m.type != METRIC_HISTOGRAM) {
+      appendf(out, "%s %ld\n", m.name, (long)v);
+      continue;
+    }
+    //只输出非空的桶, 累计计数仍然单调, 以秒为单位
+    uint64_t count = 0;
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+      if (buckets[b] == 0) continue;
+      count += buckets[b];
+      appendf(out, "%s_bucket{le=\"%.9g\"} %lu\n", m.name, bucket_upper(b) / 1e9, (unsigned long)count);
+    }
+    appendf(out, "%s_bucket{le=\"+Inf\"} %lu\n", m.name, (unsigned long)count);
+    appendf(out, "%s_sum %.9g\n%s_count %lu\n", m.name, sum / 1e9, m.name, (unsigned long)count);
+  }
+
+  curve25519_stats s;
+  curve25519_stats_get(&s);
+  appendf(out, "# HELP curve25519_operations_total curve25519 runtime operations since start\n"
+               "# TYPE curve25519_operations_total counter\n");
+  for (int i = 0; i < C25519_COUNTER_MAX; ++i) {
+    appendf(out, "curve25519_operations_total{op=\"%s\"} %lu\n", stats_labels[i], (unsigned long)s.value[i]);
+  }
+}
+
+static void send_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      return;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+//每次抓取一个短连接, 只看请求行, 其余请求头忽略
+static void serve_client(int cfd) {
+  char req[1024];
+  const ssize_t n = recv(cfd, req, sizeof(req) - 1, 0);
+  if (n <= 0) return;
+  req[n] = '\0';
+  std::string body, head;
+  if (strncmp(req, "GET /metrics", 12) == 0 || strncmp(req, "GET / ", 6) == 0) {
+    curve25519_metrics_render(&body);
+    head = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+  } else {
+    body = "not found\n";
+    head = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n";
+  }
+  head += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+  send_all(cfd, head.data(), head.size());
+  send_all(cfd, body.data(), body.size());
+}
+
+int curve25519_metrics_serve(int port) {
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  if (lfd == -1) {
+    perror("socket");
+    return -1;
+  }
+  int on = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   //只在本机开放
+  if (bind(lfd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 || listen(lfd, 16) == -1) {
+    perror("metrics bind");
+    close(lfd);
+    return -1;
+  }
+  std::thread([lfd] {
+    for (;;) {
+      int cfd = accept(lfd, nullptr, nullptr);
+      if (cfd == -1) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        perror("metrics accept");
+        break;
+      }
+      serve_client(cfd);
+      close(cfd);
+    }
+    close(lfd);
+  }).detach();
+  return 0;
+}
+
+//测试样例10: 多个线程(包括已退出的)记录的直方图被正确汇总, 分位数误差在一个子桶以内
+int test10() {
+  const int hist = curve25519_metrics_histogram("test10_seconds", "test10 latency");
+  const int gauge = curve25519_metrics_gauge("test10_in_flight", "test10 gauge");
+  if (hist < 0 || gauge < 0) return 1;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([=] {
+      curve25519_metrics_add(gauge, 1);
+      for (uint64_t v = 1; v <= 1000; ++v) curve25519_metrics_observe(hist, v * 1000);   //1us到1ms
+      curve25519_metrics_add(gauge, -1);
+    });
+  }
+  for (auto &t : threads) t.join();
+  curve25519_metrics_observe(hist, 1000000);   //本线程仍然存活
+
+  const uint64_t p50 = curve25519_metrics_quantile(hist, 0.5);
+  const uint64_t p100 = curve25519_metrics_quantile(hist, 1.0);
+  std::string text;
+  curve25519_metrics_render(&text);
+  const bool ok = p50 >= 500000 && p50 < 500000 + 500000 / 16 && p100 >= 1000000 &&
+                  p100 < 1000000 + 1000000 / 16 && text.find("test10_seconds_count 4001\n") != std::string::npos &&
+                  text.find("test10_in_flight 0\n") != std::string::npos &&
+                  text.find("test10_seconds_bucket{le=\"+Inf\"} 4001\n") != std::string::npos;
+  if (!ok) {
+    fprintf(stderr, "指标直方图汇总有误\n");
+    return 1;
+  }
+  fprintf(stderr, "指标直方图汇总正确。\n");
+  return 0;
+}
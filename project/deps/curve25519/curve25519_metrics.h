@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* 服务端指标: 计数器、仪表和HDR风格的延迟直方图, 以Prometheus文本格式输出。
+ * 每个线程写自己的计数槽, 不加锁也不用原子加; 抓取时汇总所有线程, 已退出线程的值并入全局累计。
+ * 直方图按纳秒记录, 每个2的幂区间再等分为16个子桶, 相对误差不超过1/16。 */
+
+#define METRICS_MAX 32          //可注册的指标总数
+#define METRICS_SUB_BITS 4      //每个2的幂区间的子桶数为 1<<METRICS_SUB_BITS
+#define METRICS_MAX_EXP 40      //超过2^40ns(约18分钟)的记录计入最后一个桶
+#define METRICS_BUCKETS ((METRICS_MAX_EXP - METRICS_SUB_BITS + 2) << METRICS_SUB_BITS)
+
+//注册指标, 返回后续记录使用的编号, 指标已满时返回-1; 名字和说明须在进程内一直有效
+int curve25519_metrics_counter(const char *name, const char *help);
+int curve25519_metrics_gauge(const char *name, const char *help);
+int curve25519_metrics_histogram(const char *name, const char *help);
+
+//计数器只增不减, 仪表可以加负数; id 为-1时忽略
+void curve25519_metrics_add(int id, int64_t n);
+//记录一次耗时(纳秒)
+void curve25519_metrics_observe(int id, uint64_t ns);
+
+//汇总后的直方图分位数(纳秒, 取所在桶的上界), 没有记录时返回0
+uint64_t curve25519_metrics_quantile(int id, double q);
+
+//按Prometheus文本格式输出全部指标, 附带curve25519运算计数器
+void curve25519_metrics_render(std::string *out);
+
+//在本机回环地址的port端口上启动HTTP监听线程, GET /metrics 返回当前指标
+int curve25519_metrics_serve(int port);
+
+int test10();
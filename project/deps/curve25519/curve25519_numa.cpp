@@ -0,0 +1,168 @@
+#include "curve25519_numa.h"
+#include "curve25519_stats.h"
+#include "curve25519_async.h"
+#include "curve25519_tune.h"
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace sycl;
+
+//内存池按固定大小的块分配, 一个块可容纳 ARENA_BLOCK/96 个任务
+#define ARENA_BLOCK (64 * 1024)
+#define ARENA_PAGE 4096   //首次写入的粒度, 每个work-item写一页
+
+//一个NUMA域: 子设备、绑定在子设备上的队列以及该域的USM内存池
+struct numa_domain {
+  queue *dq;
+  u8 *arena;
+  std::vector<u8 *> free_blocks;
+  std::mutex lock;
+};
+
+static std::vector<numa_domain *> domains;
+static size_t cpu_count = 1;
+static bool route_by_node = false;   //子设备与NUMA节点一一对应时按节点号选择
+
+//创建子设备, 按NUMA亲和域划分失败时退回均分
+static std::vector<device> partition(const device &root, numa_partition mode, size_t parts) {
+  if (mode == NUMA_PARTITION_AFFINITY) {
+    try {
+      std::vector<device> subs = root.create_sub_devices<info::partition_property::partition_by_affinity_domain>(
+          info::partition_affinity_domain::numa);
+      route_by_node = true;
+      return subs;
+    } catch (const sycl::exception &ex) {
+      fprintf(stderr, "按NUMA亲和域划分设备失败: %s, 改为均分\n", ex.what());
+    }
+  }
+  if (parts < 2) return {root};
+  const size_t units = root.get_info<info::device::max_compute_units>();
+  if (units < parts) return {root};
+  try {
+    return root.create_sub_devices<info::partition_property::partition_equally>(units / parts);
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "均分设备失败: %s\n", ex.what());
+  }
+  return {root};
+}
+
+int curve25519_numa_init(numa_partition mode, size_t parts, size_t arena_bytes) {
+  if (!domains.empty()) return static_cast<int>(domains.size());
+  const long online = sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_count = online > 0 ? static_cast<size_t>(online) : 1;
+
+  numa_domain *pending = nullptr;   //已创建但还没有放入domains的域, 出错时单独释放
+  try {
+    const device root{cpu_selector_v};
+    for (const device &sub : partition(root, mode, parts)) {
+      auto *d = pending = new numa_domain;
+      d->arena = nullptr;
+      d->dq = nullptr;
+      d->dq = new queue{sub};
+      const size_t blocks = arena_bytes / ARENA_BLOCK;
+      d->arena = blocks > 0 ? malloc_shared<u8>(blocks * ARENA_BLOCK, *d->dq) : nullptr;
+      if (d->arena != nullptr) CURVE25519_COUNT_USM(blocks * ARENA_BLOCK);
+      if (d->arena != nullptr) {
+        //由子设备上的内核首次写入每一页, 页面按首次访问落在执行内核的CPU所在的域
+        u8 *arena = d->arena;
+        d->dq->parallel_for(range<1>{blocks * ARENA_BLOCK / ARENA_PAGE}, [=](id<1> i) {
+          for (size_t j = 0; j < ARENA_PAGE; ++j) arena[i * ARENA_PAGE + j] = 0;
+        }).wait();
+        for (size_t i = 0; i < blocks; ++i) d->free_blocks.push_back(d->arena + i * ARENA_BLOCK);
+      }
+      domains.push_back(d);
+      pending = nullptr;
+    }
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "初始化NUMA子设备失败: %s\n", ex.what());
+    if (pending != nullptr) {
+      if (pending->arena != nullptr) free(pending->arena, *pending->dq);
+      delete pending->dq;   //可以为空
+      delete pending;
+    }
+    curve25519_numa_release();
+    return -1;
+  }
+  return static_cast<int>(domains.size());
+}
+
+size_t curve25519_numa_count() { return domains.size(); }
+
+//调用线程所在的NUMA域: 按亲和域划分时用节点号, 均分时用CPU编号
+static numa_domain &local_domain() {
+  unsigned cpu = 0, node = 0;
+  if (domains.size() == 1 || syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return *domains[0];
+  if (route_by_node) return *domains[node % domains.size()];
+  return *domains[cpu * domains.size() / cpu_count % domains.size()];
+}
+
+queue &curve25519_local_queue() { return *local_domain().dq; }
+
+//一次任务占用的USM内存, 无论从哪里返回都先擦除私钥副本, 再把块还回内存池或释放
+struct numa_lease {
+  numa_domain &d;
+  size_t n;
+  u8 *usm = nullptr;
+  bool from_arena = false;
+  ~numa_lease() {
+    if (usm == nullptr) return;
+    memset(usm + 32 * n, 0, 32 * n);
+    if (from_arena) {
+      std::lock_guard<std::mutex> guard(d.lock);
+      d.free_blocks.push_back(usm);
+    } else {
+      free(usm, *d.dq);
+    }
+  }
+};
+
+int curve25519_donna_batch_local(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n) {
+  if (n == 0) return 0;
+  if (domains.empty()) return curve25519_donna_batch_sycl(mypublic, secret, basepoint, n);
+
+  numa_domain &d = local_domain();
+  numa_lease lease{d, n};
+  if (96 * n <= ARENA_BLOCK) {
+    std::lock_guard<std::mutex> guard(d.lock);
+    if (!d.free_blocks.empty()) {
+      lease.usm = d.free_blocks.back();
+      lease.from_arena = true;
+      d.free_blocks.pop_back();
+    }
+  }
+  try {
+    if (!lease.from_arena) {
+      lease.usm = malloc_shared<u8>(96 * n, *d.dq);
+      CURVE25519_COUNT_USM(96 * n);
+    }
+    if (lease.usm == nullptr) return -1;
+    u8 *usm = lease.usm;
+    memcpy(usm + 32 * n, secret, 32 * n);
+    memcpy(usm + 64 * n, basepoint, 32 * n);
+    const curve25519_tuning tuning = curve25519_tuning_current();
+    curve25519_donna_batch_submit(*d.dq, usm, usm + 32 * n, usm + 64 * n, n,
+                                  tuning.work_group, tuning.sub_group).wait();
+    CURVE25519_COUNT(C25519_WAIT, 1);
+    CURVE25519_COUNT(C25519_SCALARMULT, n);
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "子设备批量标量乘法失败: %s\n", ex.what());
+    return -1;
+  }
+  memcpy(mypublic, lease.usm, 32 * n);
+  return 0;
+}
+
+void curve25519_numa_release() {
+  for (numa_domain *d : domains) {
+    d->dq->wait();
+    if (d->arena != nullptr) free(d->arena, *d->dq);
+    delete d->dq;
+    delete d;
+  }
+  domains.clear();
+  route_by_node = false;
+}
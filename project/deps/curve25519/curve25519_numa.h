@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <sycl/sycl.hpp>
+#include "curve25519_donna.h"
+
+/* 按NUMA亲和域把CPU设备划分为子设备, 每个子设备有自己的队列和USM内存池,
+ * 批量任务被送到提交线程所在NUMA节点的子设备上执行, 避免跨插槽访问内存,
+ * 并让并发的批量任务互不争抢同一个调度器。                              */
+
+enum numa_partition {
+  NUMA_PARTITION_AFFINITY = 0,   //按NUMA亲和域划分, 不支持时退回均分
+  NUMA_PARTITION_EQUALLY = 1     //按计算单元均分为指定份数
+};
+
+/* 划分CPU设备
+ *   mode: 划分方式; parts: 均分时(包括按亲和域划分失败后)的份数
+ *   arena_bytes: 每个子设备预先分配的USM内存池大小
+ * 返回子设备数, 划分失败时使用整个设备作为唯一的域并返回1, 出错返回-1 */
+int curve25519_numa_init(numa_partition mode, size_t parts, size_t arena_bytes);
+
+//已初始化的子设备数, 未初始化时为0
+size_t curve25519_numa_count();
+
+//调用线程所在NUMA节点对应的子设备队列
+sycl::queue &curve25519_local_queue();
+
+//在调用线程本地的子设备上完成批量标量乘法, 输入输出为普通主机内存
+int curve25519_donna_batch_local(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n);
+
+//释放所有子设备队列和内存池
+void curve25519_numa_release();
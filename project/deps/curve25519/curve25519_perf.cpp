@@ -0,0 +1,150 @@
+#include "curve25519_perf.h"
+#include "curve25519_host.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+struct perf_totals {
+  uint64_t ops = 0;
+  uint64_t value[PERF_COUNTER_MAX] = {0};
+};
+
+static const char *perf_names[PERF_COUNTER_MAX] = {
+  "cycles", "instructions", "branch-misses", "L1D-misses", "LLC-misses"
+};
+
+static int perf_fd[PERF_COUNTER_MAX] = {-1, -1, -1, -1, -1};
+static std::atomic<bool> perf_on {false};
+static std::mutex perf_mutex;
+static std::map<std::string, perf_totals> perf_ops;
+
+static int open_counter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.inherit = 1;          //之后创建的线程一并计数
+  attr.exclude_kernel = 1;   //perf_event_paranoid为2时只允许统计用户态
+  attr.exclude_hv = 1;
+  //计数器多于硬件寄存器时内核会轮流复用, 读数按运行时间比例换算
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+int curve25519_perf_enable() {
+  std::lock_guard<std::mutex> lock(perf_mutex);
+  if (perf_on) return PERF_COUNTER_MAX;
+  const uint64_t l1d_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  perf_fd[PERF_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  perf_fd[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  perf_fd[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  perf_fd[PERF_L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE, l1d_miss);
+  perf_fd[PERF_LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+  int opened = 0;
+  for (int i = 0; i < PERF_COUNTER_MAX; ++i) {
+    if (perf_fd[i] >= 0) {
+      opened++;
+    } else {
+      fprintf(stderr, "打开性能计数器%s失败: %s\n", perf_names[i], strerror(errno));
+    }
+  }
+  if (opened == 0) return -1;
+  perf_on = true;
+  return opened;
+}
+
+bool curve25519_perf_enabled() {
+  return perf_on.load(std::memory_order_relaxed);
+}
+
+void curve25519_perf_read(curve25519_perf_sample *s) {
+  for (int i = 0; i < PERF_COUNTER_MAX; ++i) {
+    uint64_t buf[3] = {0, 0, 0};   //计数值, 启用时间, 实际运行时间
+    s->value[i] = 0;
+    if (perf_fd[i] < 0 || read(perf_fd[i], buf, sizeof(buf)) != sizeof(buf)) continue;
+    s->value[i] = buf[2] == 0 ? 0 : static_cast<uint64_t>(double(buf[0]) * buf[1] / buf[2]);
+  }
+}
+
+void curve25519_perf_record(const char *name, const curve25519_perf_sample *begin, uint64_t ops) {
+  curve25519_perf_sample end;
+  curve25519_perf_read(&end);
+  std::lock_guard<std::mutex> lock(perf_mutex);
+  perf_totals &t = perf_ops[name];
+  t.ops += ops;
+  for (int i = 0; i < PERF_COUNTER_MAX; ++i) {
+    t.value[i] += end.value[i] > begin->value[i] ? end.value[i] - begin->value[i] : 0;
+  }
+}
+
+void curve25519_perf_dump(FILE *f) {
+  if (!curve25519_perf_enabled()) {
+    fprintf(f, "硬件性能计数器未开启\n");
+    return;
+  }
+  std::lock_guard<std::mutex> lock(perf_mutex);
+  fprintf(f, "硬件性能计数器(每次操作平均值):\n%-28s %10s", "操作", "次数");
+  for (int i = 0; i < PERF_COUNTER_MAX; ++i) fprintf(f, " %14s", perf_names[i]);
+  fprintf(f, " %6s\n", "IPC");
+  for (auto &it : perf_ops) {
+    const perf_totals &t = it.second;
+    const double ops = t.ops ? double(t.ops) : 1.0;
+    fprintf(f, "%-28s %10lu", it.first.c_str(), (unsigned long)t.ops);
+    for (int i = 0; i < PERF_COUNTER_MAX; ++i) fprintf(f, " %14.0f", t.value[i] / ops);
+    fprintf(f, " %6.2f\n",
+            t.value[PERF_CYCLES] ? double(t.value[PERF_INSTRUCTIONS]) / t.value[PERF_CYCLES] : 0.0);
+  }
+}
+
+void curve25519_perf_reset() {
+  std::lock_guard<std::mutex> lock(perf_mutex);
+  perf_ops.clear();
+}
+
+//CURVE25519_PERF=1 时在静态初始化阶段(其他线程创建之前)开启, 退出时输出
+static bool perf_from_env() {
+  const char *env = getenv("CURVE25519_PERF");
+  if (env == nullptr || strcmp(env, "0") == 0) return false;
+  if (curve25519_perf_enable() < 0) return false;
+  atexit([] { curve25519_perf_dump(stderr); });
+  return true;
+}
+static const bool perf_env = perf_from_env();
+
+//测试样例8: 计数器可用时, 主机端标量乘法应计到指令和周期
+int test8() {
+  static const u8 basepoint[32] = {9};
+  u8 secret[32] = {1}, out[32];
+  if (curve25519_perf_enable() < 0) {
+    fprintf(stderr, "无法打开性能计数器, 跳过测试。\n");
+    return 0;
+  }
+  curve25519_perf_reset();
+  {
+    curve25519_perf_scope scope("test8", 4);
+    for (int i = 0; i < 4; ++i) curve25519_donna_host(out, secret, basepoint);
+  }
+  bool counted;
+  {
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    const perf_totals &t = perf_ops["test8"];
+    counted = t.ops == 4 && (perf_fd[PERF_INSTRUCTIONS] < 0 || t.value[PERF_INSTRUCTIONS] > 0);
+  }
+  curve25519_perf_reset();
+  if (!counted) {
+    fprintf(stderr, "性能计数器计数有误\n");
+    return 1;
+  }
+  fprintf(stderr, "性能计数器计数正确。\n");
+  return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/* 硬件性能计数器: 用perf_event_open统计周期、指令、分支预测失败、L1D和末级缓存未命中,
+ * 按操作(curve25519_donna、批量接口、Alice握手各阶段)累计, 输出每次操作的平均值和IPC。
+ * 计数器对整个进程计数(inherit), 开启之后创建的线程(SYCL运行时、线程池)也计入,
+ * 所以必须在创建其他线程之前开启: 设置环境变量 CURVE25519_PERF=1 时在静态初始化阶段开启,
+ * 退出时自动输出; 也可以在main开头调用 curve25519_perf_enable。
+ * 多个线程同时执行被统计的操作时各操作的计数会互相包含。                              */
+
+enum curve25519_perf_counter {
+  PERF_CYCLES = 0,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_COUNTER_MAX
+};
+
+struct curve25519_perf_sample {
+  uint64_t value[PERF_COUNTER_MAX];
+};
+
+//打开计数器, 返回成功打开的计数器个数, 一个都打不开时返回-1
+int curve25519_perf_enable();
+bool curve25519_perf_enabled();
+
+//读取当前计数(已按复用时间比例换算)
+void curve25519_perf_read(curve25519_perf_sample *s);
+
+//把从 begin 到现在的计数计入名为 name 的操作, ops 为这段时间完成的操作次数
+void curve25519_perf_record(const char *name, const curve25519_perf_sample *begin, uint64_t ops);
+
+//输出每个操作的平均计数
+void curve25519_perf_dump(FILE *f);
+void curve25519_perf_reset();
+
+//作用域内的计数计入 name, 未开启时只有一次判断的开销
+struct curve25519_perf_scope {
+  const char *name;
+  uint64_t ops;
+  bool on;
+  curve25519_perf_sample begin;
+  curve25519_perf_scope(const char *name, uint64_t ops = 1) : name(name), ops(ops), on(curve25519_perf_enabled()) {
+    if (on) curve25519_perf_read(&begin);
+  }
+  ~curve25519_perf_scope() {
+    if (on) curve25519_perf_record(name, &begin, ops);
+  }
+};
+
+int test8();
@@ -0,0 +1,13 @@
+#include "curve25519_probe.h"
+
+#ifdef CURVE25519_HAVE_PROBES
+
+//探针信号量: 跟踪程序按ELF注记中记录的地址读写, 名字须与sys/sdt.h的约定一致
+#define CURVE25519_PROBE_DEFINE(name) \
+  __attribute__((section(".probes"))) volatile unsigned short curve25519_##name##_semaphore = 0;
+extern "C" {
+CURVE25519_PROBE_LIST(CURVE25519_PROBE_DEFINE)
+}
+#undef CURVE25519_PROBE_DEFINE
+
+#endif
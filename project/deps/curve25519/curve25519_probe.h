@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "curve25519_trace.h"
+
+/* USDT静态探针(提供者 curve25519), 不重新编译、不重启进程即可用bpftrace或SystemTap挂载:
+ *   bpftrace -e 'usdt:./Alice:curve25519:handshake { @[str(arg1)] = hist(arg2); }'
+ * 每个探针带一个信号量, 挂载了跟踪程序时才计算耗时等参数; 未挂载时探针本身是一条nop,
+ * 参数计算只多一次内存读取。没有<sys/sdt.h>或定义 CURVE25519_NO_PROBES 时全部展开为空。
+ *
+ *   donna_entry(mypublic)               donna_return(mypublic, ret, ns)
+ *   batch_entry(n)                      batch_return(n, ret, ns)
+ *   async_entry(mypublic, n)            async_return(mypublic, n, ret, ns)   ns为提交到完成
+ *   handshake(side, phase, ns, bytes)   Alice/Bob每个握手阶段结束时触发         */
+
+#define CURVE25519_PROBE_LIST(X) \
+  X(donna_entry) X(donna_return) X(batch_entry) X(batch_return) X(async_entry) X(async_return) X(handshake)
+
+#if !defined(CURVE25519_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define CURVE25519_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef CURVE25519_HAVE_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+//信号量由跟踪程序挂载时递增, 定义在 curve25519_probe.cpp 的.probes段中
+#define CURVE25519_PROBE_SEMAPHORE(name) extern "C" volatile unsigned short curve25519_##name##_semaphore;
+CURVE25519_PROBE_LIST(CURVE25519_PROBE_SEMAPHORE)
+#undef CURVE25519_PROBE_SEMAPHORE
+
+#define CURVE25519_PROBE_ENABLED(name) __builtin_expect(curve25519_##name##_semaphore != 0, 0)
+#define CURVE25519_PROBE(name, ...) STAP_PROBEV(curve25519, name, __VA_ARGS__)
+
+#else
+
+#define CURVE25519_PROBE_ENABLED(name) false
+#define CURVE25519_PROBE(name, ...) ((void)0)
+
+#endif
+
+//握手阶段结束, begin_ns 取自 curve25519_trace_now
+inline void curve25519_probe_phase(const char *side, const char *phase, uint64_t begin_ns, size_t bytes) {
+  if (CURVE25519_PROBE_ENABLED(handshake)) {
+    CURVE25519_PROBE(handshake, side, phase, curve25519_trace_now() - begin_ns, bytes);
+  }
+}
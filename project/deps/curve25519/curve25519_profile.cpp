@@ -0,0 +1,169 @@
+#include "curve25519_profile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace sycl;
+
+//待解析的事件超过这个数目时集中读取时间戳, 避免长时间运行时事件无限增长
+#define PROFILE_PENDING_MAX 4096
+
+struct kernel_totals {
+  uint64_t launches = 0;
+  uint64_t queued_ns = 0;
+  uint64_t exec_ns = 0;
+  std::vector<event> pending;
+};
+
+static std::atomic<int> profile_on {-1};       //-1表示尚未读取环境变量
+static std::atomic<bool> queue_created {false};
+static std::mutex profile_mutex;
+static std::map<std::string, kernel_totals> totals;
+static size_t pending_count = 0;
+static uint64_t scalarmults = 0;
+static uint64_t scalarmult_wall_ns = 0;
+static uint64_t scalarmult_timed = 0;          //有主机侧耗时的标量乘法次数
+
+bool curve25519_profile_enabled() {
+  int on = profile_on.load();
+  if (on < 0) {
+    const char *env = getenv("CURVE25519_PROFILE");
+    int expect = -1;
+    profile_on.compare_exchange_strong(expect, env != nullptr && strcmp(env, "0") != 0);
+    on = profile_on.load();
+  }
+  return on == 1;
+}
+
+int curve25519_profile_enable() {
+  if (queue_created.load()) {
+    fprintf(stderr, "全局队列已创建, 无法再开启内核剖析\n");
+    return -1;
+  }
+  profile_on = 1;
+  return 0;
+}
+
+property_list curve25519_profile_queue_properties() {
+  queue_created = true;
+  if (curve25519_profile_enabled()) return property_list{property::queue::enable_profiling()};
+  return property_list{};
+}
+
+//读取事件的时间戳并计入累计值, 事件未完成时阻塞到完成, 调用者持有 profile_mutex
+static void add_times(kernel_totals &t, const event &e) {
+  try {
+    const uint64_t submit = e.get_profiling_info<info::event_profiling::command_submit>();
+    const uint64_t start = e.get_profiling_info<info::event_profiling::command_start>();
+    const uint64_t end = e.get_profiling_info<info::event_profiling::command_end>();
+    t.queued_ns += start > submit ? start - submit : 0;
+    t.exec_ns += end > start ? end - start : 0;
+  } catch (const sycl::exception &ex) {
+    //事件来自未开启剖析的队列, 只计启动次数
+  }
+}
+
+//读取待解析事件的时间戳并计入累计值, 调用者持有 profile_mutex
+static void resolve_pending() {
+  for (auto &it : totals) {
+    kernel_totals &t = it.second;
+    for (event &e : t.pending) add_times(t, e);
+    t.pending.clear();
+  }
+  pending_count = 0;
+}
+
+event curve25519_profile_kernel(const char *primitive, event e) {
+  if (!curve25519_profile_enabled()) return e;
+  std::lock_guard<std::mutex> lock(profile_mutex);
+  kernel_totals &t = totals[primitive];
+  t.launches++;
+  t.pending.push_back(e);
+  if (++pending_count >= PROFILE_PENDING_MAX) resolve_pending();
+  return e;
+}
+
+void curve25519_profile_kernel_done(const char *primitive, const event &e) {
+  if (!curve25519_profile_enabled()) return;
+  std::lock_guard<std::mutex> lock(profile_mutex);
+  kernel_totals &t = totals[primitive];
+  t.launches++;
+  add_times(t, e);
+}
+
+void curve25519_profile_scalarmult(size_t n, uint64_t wall_ns) {
+  if (!curve25519_profile_enabled()) return;
+  std::lock_guard<std::mutex> lock(profile_mutex);
+  scalarmults += n;
+  if (wall_ns != 0) {
+    scalarmult_wall_ns += wall_ns;
+    scalarmult_timed += n;
+  }
+}
+
+size_t curve25519_profile_get(curve25519_kernel_profile *out, size_t max, uint64_t *count) {
+  std::lock_guard<std::mutex> lock(profile_mutex);
+  resolve_pending();
+  size_t i = 0;
+  for (auto &it : totals) {
+    if (i < max) {
+      snprintf(out[i].primitive, sizeof(out[i].primitive), "%s", it.first.c_str());
+      out[i].launches = it.second.launches;
+      out[i].queued_ns = it.second.queued_ns;
+      out[i].exec_ns = it.second.exec_ns;
+    }
+    ++i;
+  }
+  if (count != nullptr) *count = scalarmults;
+  return i;
+}
+
+void curve25519_profile_dump(FILE *f) {
+  if (!curve25519_profile_enabled()) {
+    fprintf(f, "内核剖析未开启\n");
+    return;
+  }
+  curve25519_kernel_profile p[64];
+  uint64_t ops = 0, wall_ns, timed;
+  const size_t n = std::min<size_t>(curve25519_profile_get(p, 64, &ops), 64);
+  {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    wall_ns = scalarmult_wall_ns;
+    timed = scalarmult_timed;
+  }
+  const double div = ops ? double(ops) : 1.0;
+  fprintf(f, "内核剖析: %lu次标量乘法, 以下为每次标量乘法的平均值\n", (unsigned long)ops);
+  fprintf(f, "%-20s %12s %14s %14s %14s\n", "运算", "启动次数", "排队延迟us", "执行时间us", "单次执行ns");
+  uint64_t launches = 0, queued = 0, exec = 0;
+  for (size_t i = 0; i < n; ++i) {
+    fprintf(f, "%-20s %12.1f %14.1f %14.1f %14.0f\n", p[i].primitive, p[i].launches / div,
+            p[i].queued_ns / div / 1e3, p[i].exec_ns / div / 1e3,
+            p[i].launches ? double(p[i].exec_ns) / p[i].launches : 0.0);
+    launches += p[i].launches;
+    queued += p[i].queued_ns;
+    exec += p[i].exec_ns;
+  }
+  fprintf(f, "%-20s %12.1f %14.1f %14.1f\n", "合计", launches / div, queued / div / 1e3, exec / div / 1e3);
+  //主机侧总耗时中扣除内核执行时间, 剩下的是提交、同步和缓冲区管理等启动开销
+  //批量内核没有单次的主机侧耗时, 混有批量任务时不做这项拆分
+  if (timed != 0 && timed == ops) {
+    const double wall = double(wall_ns) / timed / 1e3;
+    const double compute = exec / div / 1e3;
+    fprintf(f, "主机侧耗时 %.1fus, 内核执行 %.1fus (%.1f%%), 启动及同步开销 %.1fus\n", wall,
+            compute, wall > 0 ? 100 * compute / wall : 0, wall - compute);
+  }
+}
+
+void curve25519_profile_reset() {
+  std::lock_guard<std::mutex> lock(profile_mutex);
+  resolve_pending();
+  totals.clear();
+  scalarmults = 0;
+  scalarmult_wall_ns = 0;
+  scalarmult_timed = 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <sycl/sycl.hpp>
+
+/* 内核级性能剖析: 全局队列带 enable_profiling 属性创建时, 记录每次内核的
+ * 提交、开始、结束时间戳, 按运算(fmul、fsquare_times、swap_conditional等)汇总,
+ * 用来区分握手耗时中内核启动开销和实际计算各占多少。
+ * 通过环境变量 CURVE25519_PROFILE=1 或在首次使用队列前调用 curve25519_profile_enable 开启。 */
+
+struct curve25519_kernel_profile {
+  char primitive[32];
+  uint64_t launches;
+  uint64_t queued_ns;     //提交到开始执行的累计时间
+  uint64_t exec_ns;       //开始到执行结束的累计时间
+};
+
+//开启剖析, 全局队列已经创建时返回-1
+int curve25519_profile_enable();
+bool curve25519_profile_enabled();
+
+//创建全局队列时使用的属性, 调用后不能再开启剖析
+sycl::property_list curve25519_profile_queue_properties();
+
+//记录一次内核提交并原样返回事件, 未开启剖析时不做任何事
+sycl::event curve25519_profile_kernel(const char *primitive, sycl::event e);
+
+//记录一次已经完成的内核, 立即读取时间戳; 在依赖 e 的host_task中调用, 不阻塞提交线程
+void curve25519_profile_kernel_done(const char *primitive, const sycl::event &e);
+
+//记录完成了 n 次标量乘法, wall_ns 为主机侧耗时(未知时为0)
+void curve25519_profile_scalarmult(size_t n, uint64_t wall_ns);
+
+/* 取出汇总结果, 最多 max 项, 返回运算种类数
+ * scalarmults 不为空时写入已记录的标量乘法次数 */
+size_t curve25519_profile_get(curve25519_kernel_profile *out, size_t max, uint64_t *scalarmults);
+
+//按每次标量乘法输出各运算的启动次数、排队延迟和执行时间
+void curve25519_profile_dump(FILE *f);
+void curve25519_profile_reset();
@@ -0,0 +1,218 @@
+#include "curve25519_resident.h"
+#include "curve25519_stats.h"
+#include "curve25519_field.h"
+#include <cstdio>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace sycl;
+
+//内核空闲时两次扫描之间最多读多少次控制块
+#define RESIDENT_MAX_BACKOFF 4096
+//主机等待时先自旋的pause次数上限, 之后每次让出CPU
+#define RESIDENT_MAX_SPIN 64
+
+//主机和内核都通过同一种atomic_ref访问共享内存中的状态
+template <typename T>
+using usm_atomic = atomic_ref<T, memory_order::acq_rel, memory_scope::system,
+                              access::address_space::global_space>;
+
+curve25519_resident *curve25519_resident_start(size_t capacity, size_t workers) {
+  if (capacity == 0 || workers == 0) return nullptr;
+  if (workers > capacity) workers = capacity;
+
+  auto *r = new curve25519_resident;
+  r->capacity = capacity;
+  r->workers = workers;
+  r->queue = nullptr;
+  r->ctrl = nullptr;
+  r->slots = nullptr;
+  try {
+    //常驻内核独占一个队列, 不影响全局队列上的其他内核
+    r->queue = new queue{cpu_selector_v};
+    //工作组之间没有前进保证, 轮询者不超过计算单元数, 多出的工作组可能一直得不到调度
+    const size_t units = r->queue->get_device().get_info<info::device::max_compute_units>();
+    if (units > 0 && workers > units) workers = r->workers = units;
+    r->ctrl = malloc_shared<resident_ctrl>(1, *r->queue);
+    r->slots = malloc_shared<resident_slot>(capacity, *r->queue);
+    CURVE25519_COUNT_USM(sizeof(resident_ctrl) + sizeof(resident_slot) * capacity);
+    if (r->ctrl == nullptr || r->slots == nullptr) {
+      fprintf(stderr, "分配常驻内核任务队列失败\n");
+      curve25519_resident_stop(r);
+      return nullptr;
+    }
+    memset(r->ctrl, 0, sizeof(resident_ctrl));
+    memset(r->slots, 0, sizeof(resident_slot) * capacity);
+
+    resident_ctrl *ctrl = r->ctrl;
+    resident_slot *slots = r->slots;
+    CURVE25519_COUNT(C25519_SUBMIT, 1);
+    r->kernel = r->queue->submit([&](handler &h) {
+      //工作组大小为1: 每个轮询者是独立的工作组, 互不阻塞
+      h.parallel_for(nd_range<1>{range<1>{workers}, range<1>{1}}, [=](nd_item<1> it) {
+        const size_t w = it.get_global_id(0);
+        usm_atomic<uint32_t> stop(ctrl->stop);
+        usm_atomic<uint64_t> tail(ctrl->tail);
+        uint32_t backoff = 1;
+        while (true) {
+          //先读停止标志再扫描, 停止前放入的任务一定会在最后一次扫描中被处理
+          const bool stopping = stop.load(memory_order::seq_cst) != 0;
+          //放入任务前先推进tail, 扫描后tail不变说明期间没有新任务
+          const uint64_t seen = tail.load(memory_order::seq_cst);
+          bool idle = true;
+          //每个轮询者扫描全部任务槽, 用CAS认领: 即使只有一部分工作组被调度, 所有任务也会被处理
+          for (size_t k = 0; k < capacity; ++k) {
+            const size_t s = (w + k) % capacity;
+            usm_atomic<uint32_t> state(slots[s].state);
+            uint32_t expected = RESIDENT_READY;
+            const uint32_t current = state.load(memory_order::seq_cst);
+            //主机正在写入的任务在停止前也要等它就绪
+            if (current == RESIDENT_WRITING) idle = false;
+            if (current == RESIDENT_READY &&
+                state.compare_exchange_strong(expected, RESIDENT_RUNNING)) {
+              curve25519_scalarmult_item(slots[s].result, slots[s].secret, slots[s].basepoint);
+              for (int i = 0; i < 32; ++i) slots[s].secret[i] = 0;   //清除私钥
+              state.store(RESIDENT_DONE);
+              idle = false;
+            }
+          }
+          if (idle && stopping) break;
+          if (!idle) {
+            backoff = 1;
+            continue;
+          }
+          //空闲时只读控制块所在的缓存行, 有新任务或要停止时立即重新扫描, 否则等待时间逐次加倍
+          for (uint32_t i = 0; i < backoff; ++i) {
+            if (tail.load(memory_order::seq_cst) != seen || stop.load(memory_order::seq_cst) != 0) break;
+          }
+          if (backoff < RESIDENT_MAX_BACKOFF) backoff *= 2;
+        }
+      });
+    });
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "启动常驻内核失败: %s\n", ex.what());
+    if (r->queue != nullptr) {
+      if (r->slots != nullptr) free(r->slots, *r->queue);
+      if (r->ctrl != nullptr) free(r->ctrl, *r->queue);
+      delete r->queue;
+    }
+    delete r;
+    return nullptr;
+  }
+  return r;
+}
+
+long curve25519_resident_push(curve25519_resident *r, const u8 *secret, const u8 *basepoint) {
+  usm_atomic<uint64_t> tail(r->ctrl->tail);
+  const uint64_t start = tail.fetch_add(1);
+  //从序号对应的任务槽开始向后找空闲槽, 结果未被取走的槽不会让放入失败
+  size_t s = 0;
+  bool claimed = false;
+  for (size_t k = 0; k < r->capacity && !claimed; ++k) {
+    s = (start + k) % r->capacity;
+    usm_atomic<uint32_t> probe(r->slots[s].state);
+    uint32_t expected = RESIDENT_FREE;
+    claimed = probe.load() == RESIDENT_FREE &&
+              probe.compare_exchange_strong(expected, RESIDENT_WRITING, memory_order::seq_cst);
+  }
+  if (!claimed) return -1;
+  usm_atomic<uint32_t> state(r->slots[s].state);
+  //占用任务槽之后再检查停止标志: 内核要么看到WRITING并等待, 要么这里看到停止并放弃
+  usm_atomic<uint32_t> stop(r->ctrl->stop);
+  if (stop.load(memory_order::seq_cst) != 0) {
+    state.store(RESIDENT_FREE);
+    return -1;
+  }
+  memcpy(r->slots[s].secret, secret, 32);
+  memcpy(r->slots[s].basepoint, basepoint, 32);
+  state.store(RESIDENT_READY);   //release: 内核看到READY时任务数据已写入
+  return static_cast<long>(s);
+}
+
+int curve25519_resident_poll(curve25519_resident *r, long ticket, u8 *mypublic) {
+  usm_atomic<uint32_t> state(r->slots[ticket].state);
+  if (state.load() != RESIDENT_DONE) return 0;
+  memcpy(mypublic, r->slots[ticket].result, 32);
+  state.store(RESIDENT_FREE);
+  return 1;
+}
+
+void curve25519_resident_wait(curve25519_resident *r, long ticket, u8 *mypublic) {
+  int spin = 1;
+  while (!curve25519_resident_poll(r, ticket, mypublic)) {
+    if (spin > RESIDENT_MAX_SPIN) {
+      std::this_thread::yield();
+      continue;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    for (int i = 0; i < spin; ++i) _mm_pause();
+#endif
+    spin *= 2;
+  }
+}
+
+void curve25519_resident_stop(curve25519_resident *r) {
+  if (r == nullptr) return;
+  if (r->ctrl != nullptr && r->slots != nullptr) {
+    usm_atomic<uint32_t> stop(r->ctrl->stop);
+    stop.store(1, memory_order::seq_cst);
+    r->kernel.wait();
+  }
+  if (r->slots != nullptr) free(r->slots, *r->queue);
+  if (r->ctrl != nullptr) free(r->ctrl, *r->queue);
+  delete r->queue;
+  delete r;
+}
+
+//测试样例5: 常驻内核的计算结果与curve25519_donna一致
+int test5() {
+  const size_t n = 8;
+  u8 secret[n * 32], basepoint[n * 32], expect[32], out[32];
+  long ticket[n];
+
+  for (size_t i = 0; i < n * 32; ++i) {
+    secret[i] = static_cast<u8>(i * 5 + 1);
+    basepoint[i] = static_cast<u8>(i * 11 + 9);
+  }
+  curve25519_resident *r = curve25519_resident_start(16, 2);
+  if (r == nullptr) return 1;
+  for (size_t i = 0; i < n; ++i) {
+    ticket[i] = curve25519_resident_push(r, secret + 32 * i, basepoint + 32 * i);
+  }
+  int ret = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (ticket[i] < 0) {
+      ret = 1;
+      continue;
+    }
+    curve25519_resident_wait(r, ticket[i], out);
+    curve25519_donna(expect, secret + 32 * i, basepoint + 32 * i);
+    if (memcmp(out, expect, 32) != 0) ret = 1;
+  }
+  curve25519_resident_stop(r);
+
+  //结果未取走的任务槽被跳过: 4个槽中第0个仍被占用时, 序号回到0的放入使用其他空闲槽
+  r = curve25519_resident_start(4, 1);
+  if (r == nullptr) return 1;
+  long held = curve25519_resident_push(r, secret, basepoint);
+  for (size_t i = 1; i < 5 && ret == 0; ++i) {
+    const long t = curve25519_resident_push(r, secret + 32 * i, basepoint + 32 * i);
+    if (t < 0 || t == held) {
+      ret = 1;
+      break;
+    }
+    curve25519_resident_wait(r, t, out);
+    curve25519_donna(expect, secret + 32 * i, basepoint + 32 * i);
+    if (memcmp(out, expect, 32) != 0) ret = 1;
+  }
+  if (held < 0) {
+    ret = 1;
+  } else {
+    curve25519_resident_wait(r, held, out);
+  }
+  curve25519_resident_stop(r);
+  fprintf(stderr, ret == 0 ? "常驻内核计算结果正确。\n" : "常驻内核计算结果有误\n");
+  return ret;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sycl/sycl.hpp>
+#include "curve25519_donna.h"
+
+/* 常驻内核: 启动后一直运行的SYCL内核轮询USM共享内存中的环形任务队列,
+ * 主机线程放入(私钥, 基点)任务后无需再提交内核, 结果写回任务槽并置完成标志。
+ * 每个任务槽的状态按 FREE -> WRITING -> READY -> RUNNING -> DONE -> FREE 变化,
+ * 所有状态转换都是原子操作, 主机和内核之间不使用锁。                        */
+
+enum resident_state : uint32_t {
+  RESIDENT_FREE = 0,      //空闲, 可被主机占用
+  RESIDENT_WRITING = 1,   //主机正在写入任务
+  RESIDENT_READY = 2,     //等待内核处理
+  RESIDENT_RUNNING = 3,   //内核正在计算
+  RESIDENT_DONE = 4       //结果已写回, 等待主机取走
+};
+
+//一个任务槽, 按缓存行对齐避免不同槽之间的伪共享
+struct alignas(64) resident_slot {
+  uint32_t state;
+  u8 secret[32];
+  u8 basepoint[32];
+  u8 result[32];
+};
+
+//主机与内核共享的控制块
+struct alignas(64) resident_ctrl {
+  uint64_t tail;        //主机放入任务的序号
+  uint32_t stop;        //置1后内核处理完剩余任务即退出
+};
+
+struct curve25519_resident {
+  sycl::queue *queue;
+  resident_ctrl *ctrl;
+  resident_slot *slots;
+  size_t capacity;
+  size_t workers;
+  sycl::event kernel;
+};
+
+/* 启动常驻内核
+ *   capacity: 环形队列的任务槽数
+ *   workers: 轮询队列的工作项数, 每个工作项独占一个工作组, 超过设备计算单元数时按计算单元数截断 */
+curve25519_resident *curve25519_resident_start(size_t capacity, size_t workers);
+
+//放入一个任务, 返回任务号; 所有任务槽都被占用(队列已满)或已经开始关闭时返回-1
+long curve25519_resident_push(curve25519_resident *r, const u8 *secret, const u8 *basepoint);
+
+//查询任务是否完成: 完成时把结果写入 mypublic, 释放任务槽并返回1, 否则返回0
+int curve25519_resident_poll(curve25519_resident *r, long ticket, u8 *mypublic);
+
+//等待任务完成: 先用pause自旋, 次数逐次加倍, 超过上限后每次让出CPU
+void curve25519_resident_wait(curve25519_resident *r, long ticket, u8 *mypublic);
+
+//关闭常驻内核: 通知内核退出, 等待已放入和正在写入的任务处理完毕并释放内存
+//关闭期间的放入返回-1; 释放内存后不能再调用push/poll
+void curve25519_resident_stop(curve25519_resident *r);
+
+int test5();
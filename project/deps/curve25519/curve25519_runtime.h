@@ -0,0 +1,11 @@
+#pragma once
+
+#include <sycl/sycl.hpp>
+
+//curve25519使用的全局队列, 首次调用时创建
+sycl::queue &curve25519_queue();
+
+/* 预热: 创建队列并构建全部内核, 让首次握手不再承担运行时发现和即时编译的开销,
+ * 并读取或测量自动调优结果(curve25519_tune.h, 首次启动时测量并写入缓存)。
+ * 应在开始监听之前调用, 返回耗时(毫秒), 失败时返回-1 */
+double curve25519_prewarm();
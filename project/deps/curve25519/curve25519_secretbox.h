@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* XSalsa20-Poly1305(crypto_secretbox), 与crypto_box_easy_afternm的输出相同: MAC(16字节) || 密文。
+ * 与curve25519_field.h相同, 全部是纯计算的内联函数, 一个work-item即可独立完成一条记录的加解密;
+ * Salsa20的轮函数是模板, 主机端批量引擎用向量类型一次计算多条记录。
+ * Poly1305使用26位limb, 只需要32x32位乘法, 内核中不使用128位整数。           */
+
+typedef uint8_t u8;
+
+#define SECRETBOX_MACBYTES 16
+
+static inline uint32_t sb_load32(const u8 *p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static inline void sb_store32(u8 *p, uint32_t v) {
+  p[0] = static_cast<u8>(v);
+  p[1] = static_cast<u8>(v >> 8);
+  p[2] = static_cast<u8>(v >> 16);
+  p[3] = static_cast<u8>(v >> 24);
+}
+
+//T为uint32_t或每个元素为uint32_t的向量类型
+template <typename T>
+static inline T sb_rotl(T x, int c) {
+  return (x << c) | (x >> (32 - c));
+}
+
+// Salsa20的20轮(10次双轮), 不做最后的加法
+template <typename T>
+static inline void salsa20_rounds(T x[16]) {
+  for (int i = 0; i < 10; ++i) {
+    x[4] ^= sb_rotl<T>(x[0] + x[12], 7);
+    x[8] ^= sb_rotl<T>(x[4] + x[0], 9);
+    x[12] ^= sb_rotl<T>(x[8] + x[4], 13);
+    x[0] ^= sb_rotl<T>(x[12] + x[8], 18);
+    x[9] ^= sb_rotl<T>(x[5] + x[1], 7);
+    x[13] ^= sb_rotl<T>(x[9] + x[5], 9);
+    x[1] ^= sb_rotl<T>(x[13] + x[9], 13);
+    x[5] ^= sb_rotl<T>(x[1] + x[13], 18);
+    x[14] ^= sb_rotl<T>(x[10] + x[6], 7);
+    x[2] ^= sb_rotl<T>(x[14] + x[10], 9);
+    x[6] ^= sb_rotl<T>(x[2] + x[14], 13);
+    x[10] ^= sb_rotl<T>(x[6] + x[2], 18);
+    x[3] ^= sb_rotl<T>(x[15] + x[11], 7);
+    x[7] ^= sb_rotl<T>(x[3] + x[15], 9);
+    x[11] ^= sb_rotl<T>(x[7] + x[3], 13);
+    x[15] ^= sb_rotl<T>(x[11] + x[7], 18);
+
+    x[1] ^= sb_rotl<T>(x[0] + x[3], 7);
+    x[2] ^= sb_rotl<T>(x[1] + x[0], 9);
+    x[3] ^= sb_rotl<T>(x[2] + x[1], 13);
+    x[0] ^= sb_rotl<T>(x[3] + x[2], 18);
+    x[6] ^= sb_rotl<T>(x[5] + x[4], 7);
+    x[7] ^= sb_rotl<T>(x[6] + x[5], 9);
+    x[4] ^= sb_rotl<T>(x[7] + x[6], 13);
+    x[5] ^= sb_rotl<T>(x[4] + x[7], 18);
+    x[11] ^= sb_rotl<T>(x[10] + x[9], 7);
+    x[8] ^= sb_rotl<T>(x[11] + x[10], 9);
+    x[9] ^= sb_rotl<T>(x[8] + x[11], 13);
+    x[10] ^= sb_rotl<T>(x[9] + x[8], 18);
+    x[12] ^= sb_rotl<T>(x[15] + x[14], 7);
+    x[13] ^= sb_rotl<T>(x[12] + x[15], 9);
+    x[14] ^= sb_rotl<T>(x[13] + x[12], 13);
+    x[15] ^= sb_rotl<T>(x[14] + x[13], 18);
+  }
+}
+
+//输入状态: 常量"expand 32-byte k", 密钥k[8], 16字节输入in[4]
+template <typename T>
+static inline void salsa20_init(T x[16], const T k[8], const T in[4]) {
+  x[0] = T{} + 0x61707865u;
+  x[5] = T{} + 0x3320646eu;
+  x[10] = T{} + 0x79622d32u;
+  x[15] = T{} + 0x6b206574u;
+  for (int i = 0; i < 4; ++i) {
+    x[1 + i] = k[i];
+    x[11 + i] = k[4 + i];
+    x[6 + i] = in[i];
+  }
+}
+
+// HSalsa20: 由密钥和nonce的前16字节派生XSalsa20的子密钥
+template <typename T>
+static inline void hsalsa20(T subkey[8], const T k[8], const T in[4]) {
+  T x[16];
+  salsa20_init(x, k, in);
+  salsa20_rounds(x);
+  subkey[0] = x[0];
+  subkey[1] = x[5];
+  subkey[2] = x[10];
+  subkey[3] = x[15];
+  subkey[4] = x[6];
+  subkey[5] = x[7];
+  subkey[6] = x[8];
+  subkey[7] = x[9];
+}
+
+// Salsa20的一个64字节块, in为 nonce(2个字) || 块计数(2个字)
+template <typename T>
+static inline void salsa20_block(T out[16], const T k[8], const T in[4]) {
+  T x[16];
+  salsa20_init(x, k, in);
+  for (int i = 0; i < 16; ++i) out[i] = x[i];
+  salsa20_rounds(x);
+  for (int i = 0; i < 16; ++i) out[i] += x[i];
+}
+
+// Poly1305, 5个26位limb
+struct poly1305_state {
+  uint32_t r[5], h[5], pad[4];
+};
+
+static inline void poly1305_init(poly1305_state *st, const u8 *key) {
+  st->r[0] = (sb_load32(key + 0)) & 0x3ffffff;
+  st->r[1] = (sb_load32(key + 3) >> 2) & 0x3ffff03;
+  st->r[2] = (sb_load32(key + 6) >> 4) & 0x3ffc0ff;
+  st->r[3] = (sb_load32(key + 9) >> 6) & 0x3f03fff;
+  st->r[4] = (sb_load32(key + 12) >> 8) & 0x00fffff;
+  for (int i = 0; i < 5; ++i) st->h[i] = 0;
+  for (int i = 0; i < 4; ++i) st->pad[i] = sb_load32(key + 16 + 4 * i);
+}
+
+// h = (h + m) * r mod 2^130-5, 处理16字节的整数倍; hibit为 1<<24, 最后不足16字节的块为0
+static inline void poly1305_blocks(poly1305_state *st, const u8 *m, size_t bytes, uint32_t hibit) {
+  const uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+  const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+  while (bytes >= 16) {
+    h0 += (sb_load32(m + 0)) & 0x3ffffff;
+    h1 += (sb_load32(m + 3) >> 2) & 0x3ffffff;
+    h2 += (sb_load32(m + 6) >> 4) & 0x3ffffff;
+    h3 += (sb_load32(m + 9) >> 6) & 0x3ffffff;
+    h4 += (sb_load32(m + 12) >> 8) | hibit;
+
+    uint64_t d0 = uint64_t(h0) * r0 + uint64_t(h1) * s4 + uint64_t(h2) * s3 + uint64_t(h3) * s2 + uint64_t(h4) * s1;
+    uint64_t d1 = uint64_t(h0) * r1 + uint64_t(h1) * r0 + uint64_t(h2) * s4 + uint64_t(h3) * s3 + uint64_t(h4) * s2;
+    uint64_t d2 = uint64_t(h0) * r2 + uint64_t(h1) * r1 + uint64_t(h2) * r0 + uint64_t(h3) * s4 + uint64_t(h4) * s3;
+    uint64_t d3 = uint64_t(h0) * r3 + uint64_t(h1) * r2 + uint64_t(h2) * r1 + uint64_t(h3) * r0 + uint64_t(h4) * s4;
+    uint64_t d4 = uint64_t(h0) * r4 + uint64_t(h1) * r3 + uint64_t(h2) * r2 + uint64_t(h3) * r1 + uint64_t(h4) * r0;
+
+    uint32_t c;
+                   c = uint32_t(d0 >> 26); h0 = uint32_t(d0) & 0x3ffffff;
+    d1 += c;       c = uint32_t(d1 >> 26); h1 = uint32_t(d1) & 0x3ffffff;
+    d2 += c;       c = uint32_t(d2 >> 26); h2 = uint32_t(d2) & 0x3ffffff;
+    d3 += c;       c = uint32_t(d3 >> 26); h3 = uint32_t(d3) & 0x3ffffff;
+    d4 += c;       c = uint32_t(d4 >> 26); h4 = uint32_t(d4) & 0x3ffffff;
+    h0 += c * 5;   c = h0 >> 26;           h0 &= 0x3ffffff;
+    h1 += c;
+
+    m += 16;
+    bytes -= 16;
+  }
+  st->h[0] = h0;
+  st->h[1] = h1;
+  st->h[2] = h2;
+  st->h[3] = h3;
+  st->h[4] = h4;
+}
+
+//处理最后不足16字节的部分(补1后补0), 完全规约后加上pad, 输出16字节MAC
+static inline void poly1305_finish(poly1305_state *st, u8 *mac, const u8 *tail, size_t len) {
+  if (len > 0) {
+    u8 block[16];
+    for (size_t i = 0; i < 16; ++i) block[i] = i < len ? tail[i] : (i == len ? 1 : 0);
+    poly1305_blocks(st, block, 16, 0);
+  }
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+  uint32_t c;
+               c = h1 >> 26; h1 &= 0x3ffffff;
+  h2 += c;     c = h2 >> 26; h2 &= 0x3ffffff;
+  h3 += c;     c = h3 >> 26; h3 &= 0x3ffffff;
+  h4 += c;     c = h4 >> 26; h4 &= 0x3ffffff;
+  h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+  h1 += c;
+
+  // g = h + 5 - 2^130, 不为负时取g
+  uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+  uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+  uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+  uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+  uint32_t g4 = h4 + c - (1u << 26);
+  uint32_t mask = (g4 >> 31) - 1;
+  h0 = (h0 & ~mask) | (g0 & mask);
+  h1 = (h1 & ~mask) | (g1 & mask);
+  h2 = (h2 & ~mask) | (g2 & mask);
+  h3 = (h3 & ~mask) | (g3 & mask);
+  h4 = (h4 & ~mask) | (g4 & mask);
+
+  h0 = h0 | (h1 << 26);
+  h1 = (h1 >> 6) | (h2 << 20);
+  h2 = (h2 >> 12) | (h3 << 14);
+  h3 = (h3 >> 18) | (h4 << 8);
+  uint64_t f;
+  f = uint64_t(h0) + st->pad[0];             sb_store32(mac + 0, uint32_t(f));
+  f = uint64_t(h1) + st->pad[1] + (f >> 32); sb_store32(mac + 4, uint32_t(f));
+  f = uint64_t(h2) + st->pad[2] + (f >> 32); sb_store32(mac + 8, uint32_t(f));
+  f = uint64_t(h3) + st->pad[3] + (f >> 32); sb_store32(mac + 12, uint32_t(f));
+}
+
+static inline void poly1305_auth(u8 *mac, const u8 *m, size_t len, const u8 *key) {
+  poly1305_state st;
+  poly1305_init(&st, key);
+  poly1305_blocks(&st, m, len & ~size_t(15), 1u << 24);
+  poly1305_finish(&st, mac, m + (len & ~size_t(15)), len & 15);
+}
+
+//两个MAC相等时返回1, 比较时间与内容无关
+static inline int secretbox_mac_equal(const u8 *a, const u8 *b) {
+  u8 d = 0;
+  for (int i = 0; i < SECRETBOX_MACBYTES; ++i) d |= a[i] ^ b[i];
+  return d == 0;
+}
+
+/* XSalsa20的密钥流与 in 异或后写入 out, 跳过流的前 skip 字节
+ * subkey为HSalsa20派生的子密钥, n2为nonce的后8字节 */
+static inline void xsalsa20_xor(u8 *out, const u8 *in, size_t len, const uint32_t subkey[8], const u8 *n2,
+                                size_t skip) {
+  uint32_t input[4] = {sb_load32(n2), sb_load32(n2 + 4), 0, 0}, ks[16];
+  u8 block[64];
+  size_t pos = 0;
+  for (uint64_t counter = skip / 64; pos < len; ++counter) {
+    input[2] = uint32_t(counter);
+    input[3] = uint32_t(counter >> 32);
+    salsa20_block<uint32_t>(ks, subkey, input);
+    for (int i = 0; i < 16; ++i) sb_store32(block + 4 * i, ks[i]);
+    for (size_t i = counter == skip / 64 ? skip % 64 : 0; i < 64 && pos < len; ++i, ++pos) out[pos] = in[pos] ^ block[i];
+  }
+}
+
+//子密钥和Poly1305密钥(密钥流的前32字节)
+static inline void secretbox_keys(uint32_t subkey[8], u8 *poly_key, const u8 *n, const u8 *k) {
+  uint32_t key[8], in[4], ks[16];
+  for (int i = 0; i < 8; ++i) key[i] = sb_load32(k + 4 * i);
+  for (int i = 0; i < 4; ++i) in[i] = sb_load32(n + 4 * i);
+  hsalsa20<uint32_t>(subkey, key, in);
+  in[0] = sb_load32(n + 16);
+  in[1] = sb_load32(n + 20);
+  in[2] = in[3] = 0;
+  salsa20_block<uint32_t>(ks, subkey, in);
+  for (int i = 0; i < 8; ++i) sb_store32(poly_key + 4 * i, ks[i]);
+}
+
+//加密一条记录: c = MAC || 密文, 共 mlen + 16 字节; n为24字节nonce, k为32字节密钥
+static inline void secretbox_item(u8 *c, const u8 *m, size_t mlen, const u8 *n, const u8 *k) {
+  uint32_t subkey[8];
+  u8 poly_key[32];
+  secretbox_keys(subkey, poly_key, n, k);
+  xsalsa20_xor(c + SECRETBOX_MACBYTES, m, mlen, subkey, n + 16, 32);
+  poly1305_auth(c, c + SECRETBOX_MACBYTES, mlen, poly_key);
+  for (int i = 0; i < 8; ++i) subkey[i] = 0;
+  for (int i = 0; i < 32; ++i) poly_key[i] = 0;
+}
+
+//解密一条记录, 先验证MAC, 通过后才写入明文(clen - 16字节); 验证失败返回-1
+static inline int secretbox_open_item(u8 *m, const u8 *c, size_t clen, const u8 *n, const u8 *k) {
+  if (clen < SECRETBOX_MACBYTES) return -1;
+  uint32_t subkey[8];
+  u8 poly_key[32], mac[SECRETBOX_MACBYTES];
+  secretbox_keys(subkey, poly_key, n, k);
+  poly1305_auth(mac, c + SECRETBOX_MACBYTES, clen - SECRETBOX_MACBYTES, poly_key);
+  const int ok = secretbox_mac_equal(mac, c);
+  if (ok) xsalsa20_xor(m, c + SECRETBOX_MACBYTES, clen - SECRETBOX_MACBYTES, subkey, n + 16, 32);
+  for (int i = 0; i < 8; ++i) subkey[i] = 0;
+  for (int i = 0; i < 32; ++i) poly_key[i] = 0;
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,303 @@
+#include "curve25519_session.h"
+#include "curve25519_donna.h"
+#include "curve25519_secretbox.h"
+#include "curve25519_stats.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//(本地公钥, 对端公钥)
+struct session_id {
+  u8 bytes[64];
+  bool operator==(const session_id &o) const { return memcmp(bytes, o.bytes, sizeof(bytes)) == 0; }
+};
+
+//对端公钥由对方选择, 用带随机密钥的SipHash, 对方无法让条目集中到一个分片或桶
+static uint64_t session_hash_of(const session_id &id, const u8 *key) {
+  u8 h[crypto_shorthash_BYTES];
+  crypto_shorthash(h, id.bytes, sizeof(id.bytes), key);
+  uint64_t v;
+  memcpy(&v, h, sizeof(v));
+  return v;
+}
+
+struct session_hash {
+  const u8 *key;
+  size_t operator()(const session_id &id) const { return size_t(session_hash_of(id, key)); }
+};
+
+struct session_entry {
+  session_id id;
+  curve25519_session_keys keys;
+};
+
+//链表头部为最近使用的条目
+struct session_shard {
+  std::mutex mu;
+  std::list<session_entry> lru;
+  std::unordered_map<session_id, std::list<session_entry>::iterator, session_hash> index;
+  size_t capacity;
+  session_shard(size_t capacity, const u8 *key) : index(16, session_hash{key}), capacity(capacity) {}
+};
+
+struct curve25519_session_cache {
+  u8 hash_key[crypto_shorthash_KEYBYTES];
+  std::vector<std::unique_ptr<session_shard>> shards;
+  std::atomic<uint64_t> hits{0}, misses{0}, evictions{0};
+};
+
+static session_id make_id(const u8 *local_public, const u8 *peer_public) {
+  session_id id;
+  memcpy(id.bytes, local_public, 32);
+  memcpy(id.bytes + 32, peer_public, 32);
+  return id;
+}
+
+//用哈希的高位选分片, 低位留给分片内的散列表
+static session_shard &shard_of(curve25519_session_cache *cache, const session_id &id) {
+  return *cache->shards[(session_hash_of(id, cache->hash_key) >> 32) % cache->shards.size()];
+}
+
+int curve25519_box_beforenm(u8 *box_key, const u8 *shared) {
+  static const u8 zero[32] = {0};
+  if (sodium_memcmp(shared, zero, 32) == 0) return -1;
+  uint32_t key[8], in[4] = {0, 0, 0, 0}, out[8];
+  for (int i = 0; i < 8; ++i) key[i] = sb_load32(shared + 4 * i);
+  hsalsa20<uint32_t>(out, key, in);
+  for (int i = 0; i < 8; ++i) sb_store32(box_key + 4 * i, out[i]);
+  sodium_memzero(key, sizeof(key));
+  sodium_memzero(out, sizeof(out));
+  return 0;
+}
+
+void curve25519_session_confirm(u8 *tag, const u8 *shared, const u8 *server_public, const u8 *client_public,
+                                bool from_server) {
+  static const char label[] = "curve25519 handshake confirm";
+  u8 transcript[sizeof(label) + 1 + 64];
+  memcpy(transcript, label, sizeof(label));
+  transcript[sizeof(label)] = from_server ? 'S' : 'C';
+  memcpy(transcript + sizeof(label) + 1, server_public, 32);
+  memcpy(transcript + sizeof(label) + 33, client_public, 32);
+  crypto_generichash(tag, CURVE25519_CONFIRM_BYTES, transcript, sizeof(transcript), shared, 32);
+}
+
+curve25519_session_cache *curve25519_session_cache_create(size_t capacity, size_t shards) {
+  if (shards == 0) shards = 16;
+  if (capacity < shards) capacity = shards;
+  curve25519_session_cache *cache = new curve25519_session_cache;
+  randombytes_buf(cache->hash_key, sizeof(cache->hash_key));
+  for (size_t i = 0; i < shards; ++i) {
+    //容量平均分到各分片, 余数给前面的分片
+    cache->shards.push_back(
+        std::make_unique<session_shard>(capacity / shards + (i < capacity % shards ? 1 : 0), cache->hash_key));
+  }
+  return cache;
+}
+
+void curve25519_session_cache_destroy(curve25519_session_cache *cache) {
+  if (cache == nullptr) return;
+  for (auto &s : cache->shards) {
+    for (session_entry &e : s->lru) sodium_memzero(&e.keys, sizeof(e.keys));
+  }
+  delete cache;
+}
+
+int curve25519_session_get(curve25519_session_cache *cache, curve25519_session_keys *keys, const u8 *local_public,
+                           const u8 *local_private, const u8 *peer_public, bool *hit) {
+  const session_id id = make_id(local_public, peer_public);
+  session_shard &s = shard_of(cache, id);
+  {
+    std::lock_guard<std::mutex> lock(s.mu);
+    auto it = s.index.find(id);
+    if (it != s.index.end()) {
+      s.lru.splice(s.lru.begin(), s.lru, it->second);
+      *keys = it->second->keys;
+      cache->hits.fetch_add(1, std::memory_order_relaxed);
+      CURVE25519_COUNT(C25519_SESSION_HIT, 1);
+      if (hit != nullptr) *hit = true;
+      return 0;
+    }
+  }
+  cache->misses.fetch_add(1, std::memory_order_relaxed);
+  CURVE25519_COUNT(C25519_SESSION_MISS, 1);
+  if (hit != nullptr) *hit = false;
+
+  //标量乘法在锁外计算, 同一对密钥并发未命中时各算一次, 后插入的覆盖前者
+  {
+    CURVE25519_TRACE_SCOPE("curve25519_session_derive");
+    if (curve25519_donna(keys->shared, local_private, peer_public) != 0 ||
+        curve25519_box_beforenm(keys->box, keys->shared) != 0) {
+      sodium_memzero(keys, sizeof(*keys));
+      return -1;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(s.mu);
+  auto it = s.index.find(id);
+  if (it != s.index.end()) {
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    it->second->keys = *keys;
+    return 0;
+  }
+  s.lru.push_front(session_entry{id, *keys});
+  s.index.emplace(id, s.lru.begin());
+  if (s.lru.size() > s.capacity) {
+    session_entry &old = s.lru.back();
+    s.index.erase(old.id);
+    sodium_memzero(&old.keys, sizeof(old.keys));
+    s.lru.pop_back();
+    cache->evictions.fetch_add(1, std::memory_order_relaxed);
+    CURVE25519_COUNT(C25519_SESSION_EVICT, 1);
+  }
+  return 0;
+}
+
+int curve25519_session_forget(curve25519_session_cache *cache, const u8 *local_public, const u8 *peer_public) {
+  const session_id id = make_id(local_public, peer_public);
+  session_shard &s = shard_of(cache, id);
+  std::lock_guard<std::mutex> lock(s.mu);
+  auto it = s.index.find(id);
+  if (it == s.index.end()) return -1;
+  sodium_memzero(&it->second->keys, sizeof(it->second->keys));
+  s.lru.erase(it->second);
+  s.index.erase(it);
+  return 0;
+}
+
+void curve25519_session_cache_stats(curve25519_session_cache *cache, curve25519_session_stats *out) {
+  out->hits = cache->hits.load(std::memory_order_relaxed);
+  out->misses = cache->misses.load(std::memory_order_relaxed);
+  out->evictions = cache->evictions.load(std::memory_order_relaxed);
+  out->size = 0;
+  for (auto &s : cache->shards) {
+    std::lock_guard<std::mutex> lock(s->mu);
+    out->size += s->lru.size();
+  }
+}
+
+int curve25519_session_load_key(const char *path, u8 *private_key) {
+  int fd = open(path, O_RDONLY);
+  if (fd != -1) {
+    const ssize_t n = read(fd, private_key, 32);
+    close(fd);
+    if (n != 32) {
+      fprintf(stderr, "私钥文件长度不是32字节: %s\n", path);
+      return -1;
+    }
+    return 0;
+  }
+  if (errno != ENOENT) {
+    fprintf(stderr, "读取私钥文件失败: %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  randombytes_buf(private_key, 32);
+  fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 || write(fd, private_key, 32) != 32) {
+    fprintf(stderr, "写入私钥文件失败: %s: %s\n", path, strerror(errno));
+    if (fd != -1) close(fd);
+    return -1;
+  }
+  close(fd);
+  return 0;
+}
+
+//测试样例18: 会话密钥与crypto_box_beforenm一致, LRU按最近使用淘汰, 多线程访问结果一致,
+//握手确认值双方一致且两个方向、不同公钥的结果不同
+int test18() {
+  const int peers = 6;
+  u8 local_pk[32], local_sk[32], peer_pk[peers][32], peer_sk[32], expect[peers][32];
+  crypto_box_keypair(local_pk, local_sk);
+  for (int i = 0; i < peers; ++i) {
+    crypto_box_keypair(peer_pk[i], peer_sk);
+    crypto_box_beforenm(expect[i], peer_pk[i], local_sk);
+  }
+  bool ok = true;
+  curve25519_session_keys keys;
+  bool hit = true;
+  auto get = [&](curve25519_session_cache *cache, int i, bool want_hit) {
+    return curve25519_session_get(cache, &keys, local_pk, local_sk, peer_pk[i], &hit) == 0 && hit == want_hit &&
+           memcmp(keys.box, expect[i], 32) == 0;
+  };
+
+  //单个分片, 容量4
+  curve25519_session_cache *cache = curve25519_session_cache_create(4, 1);
+  for (int i = 0; i < 4; ++i) ok = ok && get(cache, i, false);
+  ok = ok && get(cache, 0, true);    //0变为最近使用
+  ok = ok && get(cache, 4, false);   //淘汰1
+  ok = ok && get(cache, 1, false);   //淘汰2
+  ok = ok && get(cache, 0, true) && get(cache, 3, true) && get(cache, 4, true);
+  //小阶点不缓存
+  const u8 zero[32] = {0};
+  ok = ok && curve25519_session_get(cache, &keys, local_pk, local_sk, zero, &hit) == -1;
+  ok = ok && curve25519_session_forget(cache, local_pk, peer_pk[0]) == 0 &&
+       curve25519_session_forget(cache, local_pk, peer_pk[0]) == -1 && get(cache, 0, false);
+  curve25519_session_stats st;
+  curve25519_session_cache_stats(cache, &st);
+  ok = ok && st.hits == 4 && st.misses == 8 && st.evictions == 2 && st.size == 4;
+  curve25519_session_cache_destroy(cache);
+
+  //多个分片, 多线程重复访问
+  cache = curve25519_session_cache_create(64, 4);
+  std::atomic<int> wrong{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      curve25519_session_keys k;
+      for (int r = 0; r < 3; ++r) {
+        for (int i = 0; i < peers; ++i) {
+          const int p = (i + t) % peers;
+          if (curve25519_session_get(cache, &k, local_pk, local_sk, peer_pk[p], nullptr) != 0 ||
+              memcmp(k.box, expect[p], 32) != 0) {
+            wrong.fetch_add(1);
+          }
+        }
+      }
+    });
+  }
+  for (std::thread &t : threads) t.join();
+  curve25519_session_cache_stats(cache, &st);
+  ok = ok && wrong.load() == 0 && st.size == peers && st.hits + st.misses == 4 * 3 * peers && st.hits >= 2 * peers;
+  curve25519_session_cache_destroy(cache);
+
+  //确认值: Alice(服务端)和Bob(客户端)各自用自己的共享密钥计算
+  u8 server_pk[32], server_sk[32], client_pk[32], client_sk[32], s1[32], s2[32];
+  u8 server_tag[CURVE25519_CONFIRM_BYTES], client_tag[CURVE25519_CONFIRM_BYTES], other[CURVE25519_CONFIRM_BYTES];
+  crypto_box_keypair(server_pk, server_sk);
+  crypto_box_keypair(client_pk, client_sk);
+  ok = ok && crypto_scalarmult(s1, server_sk, client_pk) == 0 && crypto_scalarmult(s2, client_sk, server_pk) == 0;
+  curve25519_session_confirm(server_tag, s1, server_pk, client_pk, true);
+  curve25519_session_confirm(client_tag, s1, server_pk, client_pk, false);
+  curve25519_session_confirm(other, s2, server_pk, client_pk, true);
+  ok = ok && sodium_memcmp(server_tag, other, sizeof(other)) == 0 && sodium_memcmp(server_tag, client_tag, sizeof(other)) != 0;
+  curve25519_session_confirm(other, s2, server_pk, client_pk, false);
+  ok = ok && sodium_memcmp(client_tag, other, sizeof(other)) == 0;
+  curve25519_session_confirm(other, s2, server_pk, peer_pk[0], false);
+  ok = ok && sodium_memcmp(client_tag, other, sizeof(other)) != 0;
+
+  //长期私钥: 第一次生成, 之后读取同一个
+  const std::string path = std::string(P_tmpdir) + "/curve25519_session_test_" + std::to_string(getpid());
+  unlink(path.c_str());
+  u8 k1[32], k2[32];
+  ok = ok && curve25519_session_load_key(path.c_str(), k1) == 0 && curve25519_session_load_key(path.c_str(), k2) == 0 &&
+       memcmp(k1, k2, 32) == 0;
+  unlink(path.c_str());
+
+  if (!ok) {
+    fprintf(stderr, "会话密钥缓存结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "会话密钥缓存结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+typedef uint8_t u8;
+
+/* 会话密钥: 由X25519共享密钥按crypto_box_beforenm派生crypto_box_*_afternm使用的密钥,
+ * 并按(本地公钥, 对端公钥)缓存在分片的LRU中, 同一对密钥再次握手时不再计算标量乘法。
+ * 每个分片一把锁和一条LRU链表, 分片由带随机密钥的SipHash选择; 淘汰和销毁时擦除密钥。
+ * 命中、未命中和淘汰次数计入C25519_SESSION_*计数器。                              */
+
+struct curve25519_session_cache;
+
+//缓存中一对密钥的结果
+struct curve25519_session_keys {
+  u8 shared[32];   //X25519共享密钥, 握手确认使用
+  u8 box[32];      //crypto_box_beforenm的结果
+};
+
+struct curve25519_session_stats {
+  uint64_t hits, misses, evictions;
+  size_t size;   //当前缓存的条目数
+};
+
+//crypto_box_beforenm: HSalsa20(共享密钥, 全零nonce); 共享密钥全为0(对端公钥为小阶点)时返回-1
+int curve25519_box_beforenm(u8 *box_key, const u8 *shared);
+
+#define CURVE25519_CONFIRM_BYTES 32
+
+/* 握手确认值: 以共享密钥为密钥, 对标签、方向和双方公钥(先服务端后客户端)计算带密钥的BLAKE2b。
+ * 双方交换并比较确认值, 共享密钥本身不在网络上传输; from_server区分两个方向,
+ * 对方不能把收到的确认值原样发回。比较时使用sodium_memcmp。                  */
+void curve25519_session_confirm(u8 *tag, const u8 *shared, const u8 *server_public, const u8 *client_public,
+                                bool from_server);
+
+//创建缓存, 最多capacity条, 分成shards片(0为16片)
+curve25519_session_cache *curve25519_session_cache_create(size_t capacity, size_t shards);
+void curve25519_session_cache_destroy(curve25519_session_cache *cache);
+
+/* 获取本地密钥对与对端公钥的会话密钥: 命中时直接复制, 否则计算标量乘法和beforenm后插入
+ * hit不为空时写入是否命中; 成功返回0, 对端公钥不合法时返回-1且不缓存 */
+int curve25519_session_get(curve25519_session_cache *cache, curve25519_session_keys *keys, const u8 *local_public,
+                           const u8 *local_private, const u8 *peer_public, bool *hit);
+
+//删除一对密钥的缓存(例如本地密钥轮换后), 存在时返回0
+int curve25519_session_forget(curve25519_session_cache *cache, const u8 *local_public, const u8 *peer_public);
+
+void curve25519_session_cache_stats(curve25519_session_cache *cache, curve25519_session_stats *out);
+
+/* 长期私钥: 从文件path读取32字节私钥, 文件不存在时随机生成并以0600权限写入
+ * 重连时使用同一私钥, 对端的会话缓存才能命中; 成功返回0 */
+int curve25519_session_load_key(const char *path, u8 *private_key);
+
+int test18();
@@ -0,0 +1,103 @@
+#include "curve25519_stats.h"
+#include "curve25519_donna.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const char *counter_names[C25519_COUNTER_MAX] = {
+  "内核提交", "wait同步", "buffer构造", "host_accessor", "USM分配", "USM字节", "创建线程", "标量乘法", "Ed25519签名", "Ed25519验证", "认证加解密",
+  "会话密钥命中", "会话密钥未命中", "会话密钥淘汰"
+};
+
+#ifndef CURVE25519_NO_STATS
+
+static std::mutex stats_mutex;
+static std::vector<curve25519_stats_slot *> live_slots;   //仍在运行的线程的计数槽
+static uint64_t retired[C25519_COUNTER_MAX];              //已退出线程的累计值
+static uint64_t baseline[C25519_COUNTER_MAX];             //上次重置时的总数
+
+curve25519_stats_slot::curve25519_stats_slot() {
+  for (auto &v : value) v.store(0, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  live_slots.push_back(this);
+}
+
+curve25519_stats_slot::~curve25519_stats_slot() {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  for (int i = 0; i < C25519_COUNTER_MAX; ++i) retired[i] += value[i].load(std::memory_order_relaxed);
+  live_slots.erase(std::find(live_slots.begin(), live_slots.end(), this));
+}
+
+//所有线程的累计总数, 调用者持有 stats_mutex
+static void total(uint64_t *out) {
+  memcpy(out, retired, sizeof(retired));
+  for (curve25519_stats_slot *s : live_slots) {
+    for (int i = 0; i < C25519_COUNTER_MAX; ++i) out[i] += s->value[i].load(std::memory_order_relaxed);
+  }
+}
+
+void curve25519_stats_get(curve25519_stats *out) {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  total(out->value);
+  for (int i = 0; i < C25519_COUNTER_MAX; ++i) out->value[i] -= baseline[i];
+}
+
+//其他线程的计数槽不能由这里写入, 重置只记下当前总数作为基线
+void curve25519_stats_reset() {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  total(baseline);
+}
+
+#else
+
+void curve25519_stats_get(curve25519_stats *out) {
+  memset(out, 0, sizeof(*out));
+}
+
+void curve25519_stats_reset() {}
+
+#endif
+
+void curve25519_stats_print(FILE *f) {
+  curve25519_stats s;
+  curve25519_stats_get(&s);
+  const uint64_t ops = s.value[C25519_SCALARMULT];
+  fprintf(f, "%-16s %14s %14s\n", "计数器", "总数", "每次标量乘法");
+  for (int i = 0; i < C25519_COUNTER_MAX; ++i) {
+    fprintf(f, "%-16s %14lu %14.1f\n", counter_names[i], (unsigned long)s.value[i],
+            ops ? double(s.value[i]) / ops : 0.0);
+  }
+}
+
+//测试样例7: 一次标量乘法的计数(阶梯256轮, 每轮fmonty创建5个线程), 线程退出后其计数仍被汇总
+int test7() {
+  static const u8 basepoint[32] = {9};
+  u8 secret[32] = {1}, out[32];
+  curve25519_stats s;
+
+  curve25519_stats_reset();
+  curve25519_donna(out, secret, basepoint);
+#ifndef CURVE25519_NO_STATS
+  std::thread([] { CURVE25519_COUNT(C25519_THREAD, 1); }).join();
+#endif
+  curve25519_stats_get(&s);
+#ifndef CURVE25519_NO_STATS
+  if (s.value[C25519_SCALARMULT] != 1 || s.value[C25519_SUBMIT] == 0 || s.value[C25519_WAIT] == 0 ||
+      s.value[C25519_BUFFER] == 0 || s.value[C25519_USM_ALLOC] == 0 ||
+      s.value[C25519_THREAD] != 5 * 256 + 1) {
+    fprintf(stderr, "运算计数有误\n");
+    return 1;
+  }
+#else
+  for (int i = 0; i < C25519_COUNTER_MAX; ++i) {
+    if (s.value[i] != 0) {
+      fprintf(stderr, "关闭计数的构建中计数不为0\n");
+      return 1;
+    }
+  }
+#endif
+  fprintf(stderr, "运算计数正确。\n");
+  return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/* 运算与内存分配计数器: 每个线程独立计数, 调用 curve25519_stats_get 时汇总。
+ * 定义 CURVE25519_NO_STATS 编译时计数语句全部展开为空, 不产生任何开销。 */
+
+enum curve25519_counter {
+  C25519_SUBMIT = 0,        //内核提交
+  C25519_WAIT,              //显式的 .wait() 同步
+  C25519_BUFFER,            //sycl::buffer 构造
+  C25519_HOST_ACCESSOR,     //host_accessor 创建
+  C25519_USM_ALLOC,         //USM分配次数
+  C25519_USM_BYTES,         //USM分配字节数
+  C25519_THREAD,            //创建的线程
+  C25519_SCALARMULT,        //完成的标量乘法
+  C25519_SIGN,              //完成的Ed25519签名
+  C25519_VERIFY,            //验证通过的Ed25519签名
+  C25519_BOX,               //批量认证加解密成功的记录
+  C25519_SESSION_HIT,       //会话密钥缓存命中
+  C25519_SESSION_MISS,      //会话密钥缓存未命中, 计算了标量乘法
+  C25519_SESSION_EVICT,     //会话密钥缓存淘汰
+  C25519_COUNTER_MAX
+};
+
+struct curve25519_stats {
+  uint64_t value[C25519_COUNTER_MAX];
+};
+
+#ifndef CURVE25519_NO_STATS
+
+//线程私有的计数槽, 线程创建后首次计数时登记, 线程退出时并入全局累计值
+struct curve25519_stats_slot {
+  std::atomic<uint64_t> value[C25519_COUNTER_MAX];
+  curve25519_stats_slot();
+  ~curve25519_stats_slot();
+};
+
+//只有所属线程写入计数槽, 用relaxed读写代替原子加, 汇总线程读到的值不会撕裂
+inline void curve25519_stats_add(curve25519_counter c, uint64_t n) {
+  static thread_local curve25519_stats_slot slot;
+  slot.value[c].store(slot.value[c].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+#define CURVE25519_COUNT(c, n) curve25519_stats_add(c, n)
+#define CURVE25519_COUNT_USM(bytes) \
+  (curve25519_stats_add(C25519_USM_ALLOC, 1), curve25519_stats_add(C25519_USM_BYTES, bytes))
+
+#else
+
+#define CURVE25519_COUNT(c, n) ((void)0)
+#define CURVE25519_COUNT_USM(bytes) ((void)0)
+
+#endif
+
+//汇总所有线程自上次重置以来的计数, 关闭计数的构建中全部为0
+void curve25519_stats_get(curve25519_stats *out);
+void curve25519_stats_reset();
+
+//输出各计数器的总数和每次标量乘法的平均值
+void curve25519_stats_print(FILE *f);
+
+int test7();
@@ -0,0 +1,390 @@
+#include "curve25519_stream.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include <sodium.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STREAM_ABYTES crypto_secretstream_xchacha20poly1305_ABYTES
+#define STREAM_EMPTY SIZE_MAX
+
+static void store_le32(u8 *p, uint32_t v) {
+  for (int i = 0; i < 4; ++i) p[i] = u8(v >> (8 * i));
+}
+
+static uint32_t load_le32(const u8 *p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+/* 两个帧缓冲的流水线: 调用线程填充一个缓冲的同时, 写出线程把另一个交给sink
+ * 写出顺序与提交顺序相同; sink失败后acquire返回空指针 */
+class frame_pipe {
+ public:
+  frame_pipe(const curve25519_stream_sink &sink, size_t cap) : sink(sink) {
+    for (int i = 0; i < 2; ++i) {
+      slots[i].resize(cap);
+      lens[i] = STREAM_EMPTY;
+    }
+    writer = std::thread([this] { run(); });
+  }
+
+  ~frame_pipe() {
+    if (writer.joinable()) finish();
+  }
+
+  u8 *acquire() {
+    std::unique_lock<std::mutex> lock(mu);
+    cv.wait(lock, [this] { return lens[produce] == STREAM_EMPTY || failed; });
+    return failed ? nullptr : slots[produce].data();
+  }
+
+  void commit(size_t len) {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      lens[produce] = len;
+      produce ^= 1;
+    }
+    cv.notify_all();
+  }
+
+  //等待已提交的帧全部写出, 成功返回0
+  int finish() {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      done = true;
+    }
+    cv.notify_all();
+    writer.join();
+    return failed ? -1 : 0;
+  }
+
+ private:
+  void run() {
+    for (int consume = 0;; consume ^= 1) {
+      size_t len;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&] { return lens[consume] != STREAM_EMPTY || done; });
+        if (lens[consume] == STREAM_EMPTY) return;
+        len = lens[consume];
+      }
+      const int ret = sink(slots[consume].data(), len);
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        lens[consume] = STREAM_EMPTY;
+        if (ret != 0) failed = true;
+      }
+      cv.notify_all();
+      if (ret != 0) return;
+    }
+  }
+
+  const curve25519_stream_sink &sink;
+  std::vector<u8> slots[2];
+  size_t lens[2];
+  int produce = 0;
+  bool done = false, failed = false;
+  std::mutex mu;
+  std::condition_variable cv;
+  std::thread writer;
+};
+
+//下一帧的明文: 写入指针和长度, 最后一帧last为true; 读取失败返回-1
+typedef std::function<int(const u8 **m, size_t *len, bool *last)> frame_source;
+
+static int stream_encrypt(size_t chunk, const u8 *key, const curve25519_stream_sink &sink, const frame_source &next,
+                          uint64_t *mlen) {
+  if (chunk == 0) chunk = CURVE25519_STREAM_DEFAULT_CHUNK;
+  if (chunk > CURVE25519_STREAM_MAX_CHUNK) {
+    fprintf(stderr, "流式加密的帧长超出范围: %zu\n", chunk);
+    return -1;
+  }
+  curve25519_perf_scope perf("curve25519_stream_encrypt");
+  CURVE25519_TRACE_SCOPE("curve25519_stream_encrypt");
+  crypto_secretstream_xchacha20poly1305_state st;
+  u8 ad[4];
+  store_le32(ad, uint32_t(chunk));
+  frame_pipe pipe(sink, 4 + chunk + STREAM_ABYTES);
+
+  u8 *out = pipe.acquire();
+  crypto_secretstream_xchacha20poly1305_init_push(&st, out, key);
+  memcpy(out + crypto_secretstream_xchacha20poly1305_HEADERBYTES, ad, 4);
+  pipe.commit(CURVE25519_STREAM_PRELUDE_BYTES);
+
+  bool ok = true;
+  uint64_t total = 0, frames = 0;
+  for (bool last = false; !last;) {
+    const u8 *m;
+    size_t len;
+    if (next(&m, &len, &last) != 0 || (out = pipe.acquire()) == nullptr) {
+      ok = false;
+      break;
+    }
+    store_le32(out, uint32_t(len));
+    crypto_secretstream_xchacha20poly1305_push(&st, out + 4, nullptr, m, len, ad, sizeof(ad),
+                                               last ? crypto_secretstream_xchacha20poly1305_TAG_FINAL
+                                                    : crypto_secretstream_xchacha20poly1305_TAG_MESSAGE);
+    pipe.commit(4 + len + STREAM_ABYTES);
+    total += len;
+    ++frames;
+  }
+  sodium_memzero(&st, sizeof(st));
+  ok = pipe.finish() == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "流式加密失败\n");
+    return -1;
+  }
+  perf.ops = frames;   //按帧计数
+  if (mlen != nullptr) *mlen = total;
+  return 0;
+}
+
+int curve25519_stream_key(u8 *key, const u8 *shared) {
+  static const char label[] = "curve25519 stream xchacha20poly1305";
+  if (crypto_generichash(key, crypto_secretstream_xchacha20poly1305_KEYBYTES,
+                         reinterpret_cast<const u8 *>(label), sizeof(label) - 1, shared, 32) != 0) {
+    fprintf(stderr, "流式通道密钥派生失败\n");
+    return -1;
+  }
+  return 0;
+}
+
+int curve25519_stream_encrypt(const u8 *m, size_t mlen, size_t chunk, const u8 *key,
+                              const curve25519_stream_sink &sink) {
+  if (chunk == 0) chunk = CURVE25519_STREAM_DEFAULT_CHUNK;
+  size_t off = 0;
+  return stream_encrypt(chunk, key, sink, [&](const u8 **p, size_t *len, bool *last) {
+    *p = m + off;
+    *len = std::min(chunk, mlen - off);
+    off += *len;
+    *last = off == mlen;
+    return 0;
+  }, nullptr);
+}
+
+//普通文件: 映射整个文件, 预读后面两帧, 已加密的页从映射中释放, 常驻内存与文件大小无关
+static int stream_encrypt_mmap(int fd, size_t size, size_t chunk, const u8 *key, const curve25519_stream_sink &sink,
+                               uint64_t *mlen) {
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) return -2;
+  madvise(map, size, MADV_SEQUENTIAL);
+  const u8 *base = static_cast<const u8 *>(map);
+  const size_t page = size_t(sysconf(_SC_PAGESIZE));
+  size_t off = 0, released = 0;
+  const int ret = stream_encrypt(chunk, key, sink, [&](const u8 **p, size_t *len, bool *last) {
+    //上一帧已经复制进帧缓冲
+    const size_t done = off / page * page;
+    if (done > released) {
+      madvise(const_cast<u8 *>(base) + released, done - released, MADV_DONTNEED);
+      released = done;
+    }
+    *p = base + off;
+    *len = std::min(chunk, size - off);
+    off += *len;
+    *last = off == size;
+    if (!*last) {
+      const size_t ahead = off / page * page;
+      madvise(const_cast<u8 *>(base) + ahead, std::min(2 * chunk + page, size - ahead), MADV_WILLNEED);
+    }
+    return 0;
+  }, mlen);
+  munmap(map, size);
+  return ret;
+}
+
+//读满buf或读到文件末尾, 返回读到的字节数, 出错返回-1
+static ssize_t read_full(int fd, u8 *buf, size_t len) {
+  size_t got = 0;
+  while (got < len) {
+    const ssize_t n = read(fd, buf + got, len - got);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -1;
+    if (n == 0) break;
+    got += size_t(n);
+  }
+  return ssize_t(got);
+}
+
+int curve25519_stream_encrypt_fd(int fd, size_t chunk, const u8 *key, const curve25519_stream_sink &sink,
+                                 uint64_t *mlen) {
+  if (chunk == 0) chunk = CURVE25519_STREAM_DEFAULT_CHUNK;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    const int ret = stream_encrypt_mmap(fd, size_t(st.st_size), chunk, key, sink, mlen);
+    if (ret != -2) return ret;
+  }
+  //管道、套接字或无法映射的文件: 一个帧长的读缓冲
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  std::vector<u8> buf(chunk);
+  return stream_encrypt(chunk, key, sink, [&](const u8 **p, size_t *len, bool *last) {
+    const ssize_t n = read_full(fd, buf.data(), chunk);
+    if (n < 0) {
+      fprintf(stderr, "读取失败: %s\n", strerror(errno));
+      return -1;
+    }
+    //正好读满时还不知道是否结束, 由下一次读到的空帧结束
+    *p = buf.data();
+    *len = size_t(n);
+    *last = size_t(n) < chunk;
+    return 0;
+  }, mlen);
+}
+
+int curve25519_stream_decrypt(const curve25519_stream_source &source, const u8 *key,
+                              const curve25519_stream_sink &sink, uint64_t *mlen) {
+  curve25519_perf_scope perf("curve25519_stream_decrypt");
+  CURVE25519_TRACE_SCOPE("curve25519_stream_decrypt");
+  u8 prelude[CURVE25519_STREAM_PRELUDE_BYTES];
+  crypto_secretstream_xchacha20poly1305_state st;
+  if (source(prelude, sizeof(prelude)) != 0 ||
+      crypto_secretstream_xchacha20poly1305_init_pull(&st, prelude, key) != 0) {
+    fprintf(stderr, "读取流式数据头部失败\n");
+    return -1;
+  }
+  const u8 *ad = prelude + crypto_secretstream_xchacha20poly1305_HEADERBYTES;
+  const size_t chunk = load_le32(ad);
+  if (chunk == 0 || chunk > CURVE25519_STREAM_MAX_CHUNK) {
+    fprintf(stderr, "流式数据的帧长不合法: %zu\n", chunk);
+    return -1;
+  }
+
+  std::vector<u8> in(chunk + STREAM_ABYTES);
+  frame_pipe pipe(sink, chunk);
+  const char *error = nullptr;
+  uint64_t total = 0, frames = 0;
+  for (unsigned char tag = 0; tag != crypto_secretstream_xchacha20poly1305_TAG_FINAL;) {
+    u8 head[4];
+    if (source(head, sizeof(head)) != 0) {
+      error = "流式数据被截断";
+      break;
+    }
+    const size_t len = load_le32(head);
+    if (len > chunk) {
+      error = "流式数据的帧长不合法";
+      break;
+    }
+    if (source(in.data(), len + STREAM_ABYTES) != 0) {
+      error = "流式数据被截断";
+      break;
+    }
+    u8 *out = pipe.acquire();
+    if (out == nullptr) {
+      error = "写出失败";
+      break;
+    }
+    if (crypto_secretstream_xchacha20poly1305_pull(&st, out, nullptr, &tag, in.data(), len + STREAM_ABYTES, ad,
+                                                   4) != 0) {
+      error = "流式数据验证失败";
+      break;
+    }
+    pipe.commit(len);
+    total += len;
+    ++frames;
+  }
+  sodium_memzero(&st, sizeof(st));
+  if (pipe.finish() != 0 && error == nullptr) error = "写出失败";
+  if (error != nullptr) {
+    fprintf(stderr, "%s\n", error);
+    return -1;
+  }
+  perf.ops = frames;   //按帧计数
+  if (mlen != nullptr) *mlen = total;
+  return 0;
+}
+
+//测试样例17: mmap、管道和内存三种输入加密后都能逐帧解密还原, 截断、篡改和超长帧被拒绝
+int test17() {
+  const size_t chunk = 4096;
+  const size_t lens[] = {0, 1, chunk, 3 * chunk + 5};
+  u8 key[32];
+  for (int i = 0; i < 32; ++i) key[i] = static_cast<u8>(i * 11 + 3);
+  bool ok = true;
+  std::vector<u8> m, sealed, plain;
+  const curve25519_stream_sink to_sealed = [&](const u8 *buf, size_t len) {
+    sealed.insert(sealed.end(), buf, buf + len);
+    return 0;
+  };
+  const curve25519_stream_sink to_plain = [&](const u8 *buf, size_t len) {
+    plain.insert(plain.end(), buf, buf + len);
+    return 0;
+  };
+  //从sealed[0, end)读取
+  auto decrypt = [&](size_t end) {
+    size_t pos = 0;
+    plain.clear();
+    uint64_t out_len = 0;
+    const int ret = curve25519_stream_decrypt([&](u8 *buf, size_t len) {
+      if (end - pos < len) return -1;
+      memcpy(buf, sealed.data() + pos, len);
+      pos += len;
+      return 0;
+    }, key, to_plain, &out_len);
+    return ret == 0 && out_len == plain.size() ? 0 : -1;
+  };
+
+  for (size_t len : lens) {
+    m.resize(len);
+    for (size_t i = 0; i < len; ++i) m[i] = static_cast<u8>(i * 29 + len);
+    for (int mode = 0; mode < 3 && ok; ++mode) {
+      sealed.clear();
+      uint64_t in_len = len;
+      if (mode == 0) {
+        ok = curve25519_stream_encrypt(m.data(), len, chunk, key, to_sealed) == 0;
+      } else if (mode == 1) {
+        //普通文件走mmap
+        FILE *f = tmpfile();
+        ok = f != nullptr && fwrite(m.data(), 1, len, f) == len && fflush(f) == 0 &&
+             curve25519_stream_encrypt_fd(fileno(f), chunk, key, to_sealed, &in_len) == 0;
+        if (f != nullptr) fclose(f);
+      } else {
+        //管道走分块read, 数据小于管道缓冲, 可以先写完
+        int fds[2];
+        ok = pipe(fds) == 0;
+        if (!ok) break;
+        ok = write(fds[1], m.data(), len) == ssize_t(len);
+        close(fds[1]);
+        ok = ok && curve25519_stream_encrypt_fd(fds[0], chunk, key, to_sealed, &in_len) == 0;
+        close(fds[0]);
+      }
+      ok = ok && in_len == len && decrypt(sealed.size()) == 0 && plain == m;
+    }
+  }
+
+  //截断最后一帧
+  const size_t last = 4 + 5 + STREAM_ABYTES;
+  ok = ok && decrypt(sealed.size() - last) == -1 && decrypt(sealed.size() - 1) == -1;
+  //篡改一个密文字节
+  sealed[CURVE25519_STREAM_PRELUDE_BYTES + 4 + 100] ^= 1;
+  ok = ok && decrypt(sealed.size()) == -1;
+  sealed[CURVE25519_STREAM_PRELUDE_BYTES + 4 + 100] ^= 1;
+  //交换前两帧
+  const size_t stride = 4 + chunk + STREAM_ABYTES;
+  std::vector<u8> saved = sealed;
+  std::swap_ranges(sealed.begin() + CURVE25519_STREAM_PRELUDE_BYTES,
+                   sealed.begin() + CURVE25519_STREAM_PRELUDE_BYTES + stride,
+                   sealed.begin() + CURVE25519_STREAM_PRELUDE_BYTES + stride);
+  ok = ok && decrypt(sealed.size()) == -1;
+  //头部声明的帧长超出上限
+  sealed = saved;
+  store_le32(sealed.data() + crypto_secretstream_xchacha20poly1305_HEADERBYTES, CURVE25519_STREAM_MAX_CHUNK + 1);
+  ok = ok && decrypt(sealed.size()) == -1;
+  sealed = saved;
+  ok = ok && decrypt(sealed.size()) == 0;
+  if (!ok) {
+    fprintf(stderr, "流式加密结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "流式加密结果正确。\n");
+  return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+typedef uint8_t u8;
+
+/* 流式加解密: 任意长度的文件或数据流按帧用libsodium的 crypto_secretstream_xchacha20poly1305 加密,
+ * 内存占用只与帧长有关, 与数据总长度无关。
+ * 格式: 24字节secretstream头部 || 每帧明文长度上限(4字节小端), 之后依次为各帧:
+ *   明文长度(4字节小端) || secretstream密文(明文长度 + 17字节)
+ * 每帧的附加数据为帧长上限, 最后一帧带FINAL标记(可以为空): 帧的重排、删除和截断都会导致解密失败。
+ * 加密与发送、解密与写出在两个线程上交替进行, 各用两个帧缓冲。                                 */
+
+#define CURVE25519_STREAM_PRELUDE_BYTES 28
+#define CURVE25519_STREAM_DEFAULT_CHUNK (64u << 10)
+#define CURVE25519_STREAM_MAX_CHUNK (16u << 20)   //解密时接受的帧长上限, 限制对端能让我们分配的内存
+
+//输出: 按顺序写出len字节, 成功返回0, 返回非0时停止
+typedef std::function<int(const u8 *buf, size_t len)> curve25519_stream_sink;
+//输入: 读满len字节, 数据不足或出错时返回非0
+typedef std::function<int(u8 *buf, size_t len)> curve25519_stream_source;
+
+//由32字节共享密钥派生流式通道的密钥, 成功返回0
+int curve25519_stream_key(u8 *key, const u8 *shared);
+
+/* 加密文件描述符fd的全部内容并写到sink, chunk为0时使用默认帧长
+ * 普通文件用mmap按顺序读取(预读后面的帧, 释放已加密的部分), 管道等用分块read
+ * mlen不为空时写入明文总长度; 成功返回0 */
+int curve25519_stream_encrypt_fd(int fd, size_t chunk, const u8 *key, const curve25519_stream_sink &sink,
+                                 uint64_t *mlen);
+
+//加密内存中的m(长度mlen), 其余同上
+int curve25519_stream_encrypt(const u8 *m, size_t mlen, size_t chunk, const u8 *key,
+                              const curve25519_stream_sink &sink);
+
+/* 从source逐帧读取并解密, 明文按顺序写到sink, mlen不为空时写入明文总长度
+ * 每帧验证通过后才写出; 返回-1(验证失败、截断、帧长不合法)时已写出的部分应当丢弃 */
+int curve25519_stream_decrypt(const curve25519_stream_source &source, const u8 *key,
+                              const curve25519_stream_sink &sink, uint64_t *mlen);
+
+int test17();
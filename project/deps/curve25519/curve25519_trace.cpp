@@ -0,0 +1,227 @@
+#include "curve25519_trace.h"
+#include "curve25519_host.h"
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+//每个线程最多保留的事件数, 超出后丢弃并计数, 防止长时间运行时内存无限增长
+#define TRACE_MAX_EVENTS (1 << 20)
+
+struct trace_event {
+  const char *name;
+  const char *cat;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+//线程私有的缓冲区, 线程存活期间登记在全局列表中
+struct trace_buffer {
+  long tid;
+  std::mutex lock;        //只在写出时与所属线程竞争
+  std::vector<trace_event> events;
+  uint64_t dropped = 0;
+};
+
+//已退出线程留下的事件, 等待下次写出
+struct trace_retired {
+  long tid;
+  trace_event e;
+};
+
+static std::atomic<bool> trace_on {false};
+static std::mutex trace_mutex;
+static std::string trace_path;
+static bool trace_written = false;     //trace_path 已写过, 之后的写出追加到文件末尾
+static std::vector<trace_buffer *> buffers;
+static std::vector<trace_retired> retired;
+static uint64_t retired_dropped = 0;
+
+//线程退出时把缓冲区中的事件交给全局列表并释放缓冲区
+struct trace_owner {
+  trace_buffer *buf = nullptr;
+  ~trace_owner() {
+    if (buf == nullptr) return;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    for (const trace_event &e : buf->events) retired.push_back({buf->tid, e});
+    retired_dropped += buf->dropped;
+    for (size_t i = 0; i < buffers.size(); i++) {
+      if (buffers[i] == buf) {
+        buffers[i] = buffers.back();
+        buffers.pop_back();
+        break;
+      }
+    }
+    delete buf;
+  }
+};
+
+static trace_buffer *local_buffer() {
+  static thread_local trace_owner owner;
+  if (owner.buf == nullptr) {
+    auto b = std::make_unique<trace_buffer>();
+    b->tid = syscall(SYS_gettid);
+    b->events.reserve(1024);
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    buffers.push_back(b.get());
+    owner.buf = b.release();
+  }
+  return owner.buf;
+}
+
+int curve25519_trace_start(const char *path) {
+  std::string p = path;
+  const size_t pos = p.find("%p");
+  if (pos != std::string::npos) p.replace(pos, 2, std::to_string(getpid()));
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  if (p != trace_path) trace_written = false;
+  trace_path = p;
+  trace_on = true;
+  return 0;
+}
+
+bool curve25519_trace_enabled() {
+  return trace_on.load(std::memory_order_relaxed);
+}
+
+uint64_t curve25519_trace_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void curve25519_trace_span(const char *name, const char *cat, uint64_t begin_ns) {
+  if (!curve25519_trace_enabled()) return;
+  const uint64_t end = curve25519_trace_now();
+  trace_buffer *b = local_buffer();
+  std::lock_guard<std::mutex> lock(b->lock);
+  if (b->events.size() >= TRACE_MAX_EVENTS) {
+    b->dropped++;
+    return;
+  }
+  b->events.push_back({name, cat, begin_ns, end});
+}
+
+static void write_event(FILE *f, int pid, long tid, const trace_event &e) {
+  //Chrome trace的时间单位为微秒, 保留三位小数即纳秒精度
+  fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld}",
+          e.name, e.cat, e.begin_ns / 1e3, (e.end_ns - e.begin_ns) / 1e3, pid, tid);
+}
+
+//写出后清空缓冲区; 同一文件再次写出时去掉结尾的 \n]}\n 继续追加, 文件始终是完整的JSON
+long curve25519_trace_flush() {
+  static const char tail[] = "\n]}\n";
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  if (trace_path.empty()) return -1;
+  FILE *f = fopen(trace_path.c_str(), trace_written ? "r+" : "w");
+  if (f != nullptr && trace_written && fseek(f, -(long)(sizeof(tail) - 1), SEEK_END) != 0) {
+    fclose(f);
+    f = nullptr;
+  }
+  if (f == nullptr) {
+    perror("fopen");
+    return -1;
+  }
+  const int pid = getpid();
+  long count = 0;
+  uint64_t dropped = retired_dropped;
+  if (!trace_written) {
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}", pid,
+            program_invocation_short_name);
+  }
+  for (const trace_retired &r : retired) write_event(f, pid, r.tid, r.e);
+  count += retired.size();
+  std::vector<trace_retired>().swap(retired);
+  retired_dropped = 0;
+  for (trace_buffer *b : buffers) {
+    std::lock_guard<std::mutex> guard(b->lock);
+    for (const trace_event &e : b->events) write_event(f, pid, b->tid, e);
+    count += b->events.size();
+    dropped += b->dropped;
+    b->dropped = 0;
+    //保留初始容量复用, 记录高峰时扩大的部分归还
+    if (b->events.capacity() > 1024) {
+      std::vector<trace_event>().swap(b->events);
+      b->events.reserve(1024);
+    } else {
+      b->events.clear();
+    }
+  }
+  fputs(tail, f);
+  fclose(f);
+  trace_written = true;
+  if (dropped != 0) fprintf(stderr, "追踪缓冲区已满, 丢弃了%lu个事件\n", (unsigned long)dropped);
+  return count;
+}
+
+//CURVE25519_TRACE=文件名 时从静态初始化开始记录, 退出时写出
+static bool trace_from_env() {
+  const char *env = getenv("CURVE25519_TRACE");
+  if (env == nullptr || env[0] == '\0') return false;
+  curve25519_trace_start(env);
+  atexit([] { curve25519_trace_flush(); });
+  return true;
+}
+static const bool trace_env = trace_from_env();
+
+//测试样例9: 时间段都被记录, 已退出线程的记录也能写出, 再次写出追加后文件仍是完整的JSON数组
+int test9() {
+  static const u8 basepoint[32] = {9};
+  u8 secret[32] = {1}, out[32];
+  char path[] = "/tmp/curve25519_trace_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  const bool was_on = curve25519_trace_enabled();
+  std::string old_path;
+  {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    old_path = trace_path;
+  }
+  curve25519_trace_start(path);
+  {
+    curve25519_trace_scope scope("test9", "test");
+    curve25519_donna_host(out, secret, basepoint);
+  }
+  const long n = curve25519_trace_flush();
+  std::thread worker([] { curve25519_trace_scope scope("test9_thread", "test"); });
+  worker.join();
+  const long n2 = curve25519_trace_flush();
+
+  //读回检查包含测试的时间段且以 ]} 结尾
+  std::string text;
+  char chunk[4096];
+  FILE *f = fopen(path, "r");
+  size_t got;
+  while (f != nullptr && (got = fread(chunk, 1, sizeof(chunk), f)) > 0) text.append(chunk, got);
+  if (f != nullptr) fclose(f);
+  unlink(path);
+  if (was_on) {
+    curve25519_trace_start(old_path.c_str());
+  } else {
+    trace_on = false;
+  }
+
+  if (n <= 0 || n2 <= 0 || text.size() < 3 || text.find("\"name\":\"test9\"") == std::string::npos ||
+      text.find("\"name\":\"test9_thread\"") == std::string::npos ||
+      text.compare(text.size() - 3, 3, "]}\n") != 0) {
+    fprintf(stderr, "时间线追踪结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "时间线追踪结果正确。\n");
+  return 0;
+}
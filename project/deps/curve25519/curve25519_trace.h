@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* 时间线追踪: 把握手各阶段和curve25519内部运算的时间段记录到线程私有的缓冲区,
+ * 输出为Chrome trace event格式的JSON, 可以直接用Perfetto或chrome://tracing打开。
+ * 设置环境变量 CURVE25519_TRACE=文件名 时自动开始记录并在退出时写出,
+ * 文件名中的 %p 替换为进程号, Alice和Bob可以各写一个文件后在Perfetto中合并查看。
+ * 时间戳取自CLOCK_MONOTONIC, 同一台机器上不同进程的时间线可以对齐。             */
+
+//开始记录, 记录写到 path; 已在记录时只更换输出文件
+int curve25519_trace_start(const char *path);
+bool curve25519_trace_enabled();
+
+//当前时间(纳秒), 与 curve25519_trace_span 配合记录不在同一作用域内的阶段
+uint64_t curve25519_trace_now();
+
+//记录从 begin_ns 到现在的一段时间, name 和 cat 必须是字符串常量
+void curve25519_trace_span(const char *name, const char *cat, uint64_t begin_ns);
+
+//把所有线程的记录写成JSON, 返回写出的事件数, 失败返回-1
+long curve25519_trace_flush();
+
+//作用域内的时间段, 未开启时只有一次判断的开销
+struct curve25519_trace_scope {
+  const char *name;
+  const char *cat;
+  uint64_t begin;
+  curve25519_trace_scope(const char *name, const char *cat)
+      : name(name), cat(cat), begin(curve25519_trace_enabled() ? curve25519_trace_now() : 0) {}
+  ~curve25519_trace_scope() {
+    if (begin != 0) curve25519_trace_span(name, cat, begin);
+  }
+};
+
+#define CURVE25519_TRACE_SCOPE(name) curve25519_trace_scope trace_scope_(name, "curve25519")
+
+int test9();
@@ -0,0 +1,349 @@
+#include "curve25519_tune.h"
+#include "curve25519_async.h"
+#include "curve25519_runtime.h"
+#include "curve25519_host.h"
+#include "curve25519_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sycl/sycl.hpp>
+
+using namespace sycl;
+
+//参与测量的批量大小
+static const size_t TUNE_SIZES[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+#define TUNE_MAX 256
+#define TUNE_REPEAT 3
+
+//默认值: 单个任务在本线程计算, 其余交给线程池, 不使用SYCL批量内核
+static const curve25519_tuning default_tuning = {1, std::numeric_limits<size_t>::max(), 0, 0};
+/* 当前结果按顺序锁(seqlock)发布: 每次提交内核都无锁读取, 不分配内存。
+ * 写入前后各把序号加一, 读者读到奇数序号或前后序号不同时重读, 不会拿到新旧混合的结果 */
+static std::atomic<uint64_t> published_seq{0};
+static std::atomic<size_t> published[4] = {{default_tuning.host_max}, {default_tuning.sycl_min},
+                                           {default_tuning.work_group}, {default_tuning.sub_group}};
+static std::mutex tuning_lock;
+static bool tuned = false;
+
+//调用者持有tuning_lock, 写者只有一个
+static void publish(const curve25519_tuning &t) {
+  const uint64_t seq = published_seq.load(std::memory_order_relaxed);
+  published_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  published[0].store(t.host_max, std::memory_order_relaxed);
+  published[1].store(t.sycl_min, std::memory_order_relaxed);
+  published[2].store(t.work_group, std::memory_order_relaxed);
+  published[3].store(t.sub_group, std::memory_order_relaxed);
+  published_seq.store(seq + 2, std::memory_order_release);
+}
+
+static std::string cache_path() {
+  if (const char *path = getenv("CURVE25519_TUNE_CACHE")) return path;
+  if (const char *xdg = getenv("XDG_CACHE_HOME")) return std::string(xdg) + "/curve25519_tune";
+  if (const char *home = getenv("HOME")) {
+    mkdir((std::string(home) + "/.cache").c_str(), 0755);
+    return std::string(home) + "/.cache/curve25519_tune";
+  }
+  return "curve25519_tune";
+}
+
+static std::string cpu_model() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      return line.substr(line.find(':') + 2);
+    }
+  }
+  return "unknown";
+}
+
+std::string curve25519_tuning_key() {
+  std::string key = cpu_model();
+  try {
+    const device dev = curve25519_queue().get_device();
+    key += "|" + dev.get_info<info::device::name>();
+    key += "|" + dev.get_info<info::device::driver_version>();
+    key += "|" + dev.get_platform().get_info<info::platform::version>();
+  } catch (const sycl::exception &ex) {
+    key += "|no-sycl";
+  }
+  //键写在一行中, 不能含有换行
+  std::replace(key.begin(), key.end(), '\n', ' ');
+  return key;
+}
+
+//缓存格式: 第一行为键, 之后每行一个"名称 值"
+static bool load_cache(const std::string &key, curve25519_tuning &out) {
+  std::ifstream in(cache_path());
+  std::string line;
+  if (!std::getline(in, line) || line != key) return false;
+  curve25519_tuning t = curve25519_tuning_current();
+  std::string name;
+  size_t value;
+  int fields = 0;
+  while (in >> name >> value) {
+    if (name == "host_max") t.host_max = value, ++fields;
+    else if (name == "sycl_min") t.sycl_min = value, ++fields;
+    else if (name == "work_group") t.work_group = value, ++fields;
+    else if (name == "sub_group") t.sub_group = value, ++fields;
+  }
+  if (fields != 4) return false;
+  out = t;
+  return true;
+}
+
+//先写临时文件再rename, 同时启动的其他进程不会读到写了一半的缓存
+static void save_cache(const std::string &key, const curve25519_tuning &t) {
+  const std::string path = cache_path();
+  const std::string tmp = path + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << key << "\n"
+        << "host_max " << t.host_max << "\n"
+        << "sycl_min " << t.sycl_min << "\n"
+        << "work_group " << t.work_group << "\n"
+        << "sub_group " << t.sub_group << "\n";
+    out.flush();
+    if (!out) {
+      fprintf(stderr, "无法写入调优缓存 %s\n", tmp.c_str());
+      unlink(tmp.c_str());
+      return;
+    }
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    fprintf(stderr, "无法写入调优缓存 %s: %s\n", path.c_str(), strerror(errno));
+    unlink(tmp.c_str());
+  }
+}
+
+//重复测量取最短时间(纳秒), 排除偶发的调度干扰
+template <typename F>
+static double measure(F run) {
+  double best = std::numeric_limits<double>::max();
+  for (int r = 0; r < TUNE_REPEAT; ++r) {
+    const auto start = std::chrono::steady_clock::now();
+    if (!run()) return std::numeric_limits<double>::max();
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    best = std::min(best, ns);
+  }
+  return best;
+}
+
+//在全局队列上运行一次批量内核, 数据已在USM中
+static bool run_sycl(u8 *usm, size_t n, size_t wg, size_t sg) {
+  try {
+    curve25519_donna_batch_submit(curve25519_queue(), usm, usm + 32 * TUNE_MAX, usm + 64 * TUNE_MAX, n, wg, sg).wait();
+  } catch (const sycl::exception &ex) {
+    return false;   //设备不支持该工作组/子组大小
+  }
+  return true;
+}
+
+static curve25519_tuning run_tuning() {
+  curve25519_tuning t = {1, std::numeric_limits<size_t>::max(), 0, 0};
+  std::vector<u8> secret(32 * TUNE_MAX), basepoint(32 * TUNE_MAX), out(32 * TUNE_MAX);
+  for (size_t i = 0; i < secret.size(); ++i) {
+    secret[i] = static_cast<u8>(i * 131 + 7);
+    basepoint[i] = (i % 32 == 0) ? 9 : 0;
+  }
+
+  queue &q = curve25519_queue();
+  u8 *usm = nullptr;
+  try {
+    usm = malloc_shared<u8>(96 * TUNE_MAX, q);
+  } catch (const sycl::exception &ex) {
+    fprintf(stderr, "调优时分配USM内存失败: %s\n", ex.what());
+  }
+  if (usm != nullptr) {
+    memcpy(usm + 32 * TUNE_MAX, secret.data(), secret.size());
+    memcpy(usm + 64 * TUNE_MAX, basepoint.data(), basepoint.size());
+
+    //1. 在最大批量下选择内核的工作组和子组大小
+    double best = std::numeric_limits<double>::max();
+    const size_t sub_groups[] = {0, 8, 16};
+    const size_t work_groups[] = {0, 1, 8, 16, 32, 64};
+    run_sycl(usm, TUNE_MAX, 0, 0);   //预热, 包括即时编译
+    for (size_t sg : sub_groups) {
+      for (size_t wg : work_groups) {
+        if (sg != 0 && wg != 0 && wg % sg != 0) continue;
+        const double ns = measure([&] { return run_sycl(usm, TUNE_MAX, wg, sg); });
+        if (ns < best) {
+          best = ns;
+          t.work_group = wg;
+          t.sub_group = sg;
+        }
+      }
+    }
+  }
+
+  //2. 各批量大小下比较三个引擎
+  host_pool *pool = curve25519_host_pool();
+  bool host_leads = true;
+  for (size_t n : TUNE_SIZES) {
+    const double host = measure([&] {
+      for (size_t i = 0; i < n; ++i) curve25519_donna_host(&out[32 * i], &secret[32 * i], &basepoint[32 * i]);
+      return true;
+    });
+    const double pooled = measure([&] {
+      return curve25519_donna_host_batch(pool, out.data(), secret.data(), basepoint.data(), n) == 0;
+    });
+    const double sycl_ns = usm == nullptr ? std::numeric_limits<double>::max()
+                                          : measure([&] { return run_sycl(usm, n, t.work_group, t.sub_group); });
+
+    //主机单线程从最小批量开始连续领先的范围
+    if (host_leads && host <= pooled && host <= sycl_ns) t.host_max = n;
+    else host_leads = false;
+    //SYCL领先之后的所有更大批量都按SYCL处理
+    if (sycl_ns < host && sycl_ns < pooled) {
+      if (t.sycl_min == std::numeric_limits<size_t>::max()) t.sycl_min = n;
+    } else {
+      t.sycl_min = std::numeric_limits<size_t>::max();
+    }
+  }
+  if (usm != nullptr) free(usm, q);
+  return t;
+}
+
+curve25519_tuning curve25519_autotune() {
+  std::lock_guard<std::mutex> guard(tuning_lock);
+  if (tuned) return curve25519_tuning_current();
+  const std::string key = curve25519_tuning_key();
+  curve25519_tuning t;
+  if (!load_cache(key, t)) {
+    t = run_tuning();
+    save_cache(key, t);
+  }
+  publish(t);
+  tuned = true;
+  return t;
+}
+
+curve25519_tuning curve25519_retune() {
+  std::lock_guard<std::mutex> guard(tuning_lock);
+  const curve25519_tuning t = run_tuning();
+  save_cache(curve25519_tuning_key(), t);
+  publish(t);
+  tuned = true;
+  return t;
+}
+
+curve25519_tuning curve25519_tuning_current() {
+  curve25519_tuning t;
+  uint64_t begin, end;
+  do {
+    begin = published_seq.load(std::memory_order_acquire);
+    t.host_max = published[0].load(std::memory_order_relaxed);
+    t.sycl_min = published[1].load(std::memory_order_relaxed);
+    t.work_group = published[2].load(std::memory_order_relaxed);
+    t.sub_group = published[3].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    end = published_seq.load(std::memory_order_relaxed);
+  } while ((begin & 1) != 0 || begin != end);
+  return t;
+}
+
+int curve25519_donna_dispatch(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n) {
+  const curve25519_tuning t = curve25519_autotune();
+  if (n <= t.host_max) {
+    for (size_t i = 0; i < n; ++i) curve25519_donna_host(mypublic + 32 * i, secret + 32 * i, basepoint + 32 * i);
+    return 0;
+  }
+  if (n >= t.sycl_min) return curve25519_donna_batch_sycl(mypublic, secret, basepoint, n);
+  return curve25519_donna_host_batch(nullptr, mypublic, secret, basepoint, n);
+}
+
+//测试样例20: 调优缓存写入后按同一个键读回, 键不匹配或字段不全时不使用; 分发按分界点选择引擎;
+//重新发布结果时并发读取的调用者只会看到完整的某一份结果
+int test20() {
+  bool ok = true;
+  const char *old_env = getenv("CURVE25519_TUNE_CACHE");
+  const std::string saved_env = old_env != nullptr ? old_env : "";
+  const std::string path = std::string(P_tmpdir) + "/curve25519_tune_test_" + std::to_string(getpid());
+  setenv("CURVE25519_TUNE_CACHE", path.c_str(), 1);
+
+  const curve25519_tuning want = {3, 77, 128, 16};
+  curve25519_tuning got = {0, 0, 0, 0};
+  save_cache("key-a", want);
+  ok = ok && load_cache("key-a", got) && got.host_max == want.host_max && got.sycl_min == want.sycl_min &&
+       got.work_group == want.work_group && got.sub_group == want.sub_group;
+  got = {0, 0, 0, 0};
+  ok = ok && !load_cache("key-b", got) && got.host_max == 0;
+  {
+    std::ofstream partial(path, std::ios::trunc);
+    partial << "key-a\nhost_max 3\nsycl_min 77\n";
+  }
+  ok = ok && !load_cache("key-a", got);
+  unlink(path.c_str());
+  if (old_env != nullptr) setenv("CURVE25519_TUNE_CACHE", saved_env.c_str(), 1);
+  else unsetenv("CURVE25519_TUNE_CACHE");
+
+  //固定分界点: 不超过2个逐个计算, 2到8之间用线程池, 不小于8用SYCL批量内核
+  curve25519_tuning saved;
+  bool saved_tuned;
+  {
+    std::lock_guard<std::mutex> guard(tuning_lock);
+    saved = curve25519_tuning_current();
+    saved_tuned = tuned;
+    publish({2, 8, 0, 0});
+    tuned = true;
+  }
+  const size_t n = 16;
+  u8 secret[32 * n], basepoint[32 * n], out[32 * n], expect[32 * n];
+  for (size_t i = 0; i < 32 * n; ++i) {
+    secret[i] = static_cast<u8>(i * 7 + 3);
+    basepoint[i] = static_cast<u8>(i * 13 + 9);
+  }
+  for (size_t i = 0; i < n; ++i) curve25519_donna(expect + 32 * i, secret + 32 * i, basepoint + 32 * i);
+  for (size_t count : {size_t(1), size_t(4), n}) {
+    curve25519_stats before, after;
+    curve25519_stats_get(&before);
+    memset(out, 0, sizeof(out));
+    ok = ok && curve25519_donna_dispatch(out, secret, basepoint, count) == 0 && memcmp(out, expect, 32 * count) == 0;
+    curve25519_stats_get(&after);
+#ifndef CURVE25519_NO_STATS
+    const bool submitted = after.value[C25519_SUBMIT] > before.value[C25519_SUBMIT];
+    ok = ok && submitted == (count >= 8);
+#endif
+  }
+
+  //一个线程反复读取, 同时交替发布两份结果
+  std::atomic<bool> done{false};
+  std::atomic<int> torn{0};
+  std::thread reader([&] {
+    while (!done.load(std::memory_order_relaxed)) {
+      const curve25519_tuning t = curve25519_tuning_current();
+      if (!(t.host_max == 2 && t.sycl_min == 8) && !(t.host_max == 5 && t.sycl_min == 50)) torn.fetch_add(1);
+    }
+  });
+  for (int i = 0; i < 1000; ++i) {
+    std::lock_guard<std::mutex> guard(tuning_lock);
+    publish(i % 2 == 0 ? curve25519_tuning{5, 50, 0, 0} : curve25519_tuning{2, 8, 0, 0});
+  }
+  done.store(true);
+  reader.join();
+  ok = ok && torn.load() == 0;
+
+  {
+    std::lock_guard<std::mutex> guard(tuning_lock);
+    publish(saved);
+    tuned = saved_tuned;
+  }
+  if (!ok) {
+    fprintf(stderr, "自动调优结果有误\n");
+    return 1;
+  }
+  fprintf(stderr, "自动调优结果正确。\n");
+  return 0;
+}
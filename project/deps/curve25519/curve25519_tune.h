@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "curve25519_donna.h"
+
+/* 启动时自动调优
+ * 测量主机单线程、主机线程池和SYCL批量内核在不同批量大小下的耗时, 得到各引擎的分界点,
+ * 同时测量批量内核的工作组和子组大小。结果以CPU型号和SYCL运行时版本为键写入缓存文件,
+ * 之后启动时直接读取, 换了机器或运行时才重新测量。                             */
+
+struct curve25519_tuning {
+  size_t host_max;     //批量不超过该值时在调用线程上逐个计算
+  size_t sycl_min;     //批量不小于该值时使用SYCL批量内核, 介于两者之间时使用主机线程池
+  size_t work_group;   //批量内核的工作组大小, 0表示由运行时决定
+  size_t sub_group;    //批量内核的子组大小, 0表示由运行时决定
+};
+
+/* 返回调优结果: 优先读取缓存, 缓存不存在或键不匹配时测量并写入缓存
+ * 缓存文件路径依次取 CURVE25519_TUNE_CACHE、$XDG_CACHE_HOME/curve25519_tune、
+ * $HOME/.cache/curve25519_tune */
+curve25519_tuning curve25519_autotune();
+
+//忽略缓存重新测量
+curve25519_tuning curve25519_retune();
+
+//当前使用的调优结果的副本, 尚未调优时返回默认值, 不会触发测量; 无锁, 可以与重新调优并发调用
+curve25519_tuning curve25519_tuning_current();
+
+//缓存键: CPU型号和SYCL运行时版本
+std::string curve25519_tuning_key();
+
+//按调优结果选择引擎的批量接口, 首次调用时触发调优
+int curve25519_donna_dispatch(u8 *mypublic, const u8 *secret, const u8 *basepoint, size_t n);
+
+int test20();
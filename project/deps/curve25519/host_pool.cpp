@@ -0,0 +1,226 @@
+#include "host_pool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+//一次 parallel_for 调用
+struct pool_job {
+  const std::function<void(size_t, size_t, size_t)> *fn;
+  std::atomic<size_t> remaining;   //尚未完成的任务块数
+  std::mutex lock;
+  std::condition_variable done;
+  bool finished = false;           //由完成最后一块的线程在lock内置位, 调用者等它而不是等 remaining
+};
+
+//任务块 [begin, end)
+struct pool_task {
+  pool_job *job;
+  size_t begin, end;
+};
+
+struct pool_worker {
+  std::thread thread;
+  int cpu = -1;
+  void *scratch = nullptr;
+  std::mutex lock;                 //保护 tasks, 窃取者和所有者都很少同时访问
+  std::deque<pool_task> tasks;
+  std::atomic<uint64_t> executed{0};
+  std::atomic<uint64_t> steals{0};
+  std::atomic<uint64_t> busy_ns{0};
+};
+
+struct host_pool {
+  std::vector<pool_worker *> workers;
+  size_t scratch_bytes;
+  std::mutex lock;                 //配合 wake 使用
+  std::condition_variable wake;
+  std::atomic<size_t> pending{0};  //所有队列中的任务块数
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> next{0};     //下一次分发任务的起始线程
+  std::chrono::steady_clock::time_point since;
+};
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//先取自己队列尾部(缓存最热)的任务, 再从其他线程队列头部窃取
+static bool take_task(host_pool *pool, size_t self, pool_task &task) {
+  pool_worker *w = pool->workers[self];
+  {
+    std::lock_guard<std::mutex> guard(w->lock);
+    if (!w->tasks.empty()) {
+      task = w->tasks.back();
+      w->tasks.pop_back();
+      return true;
+    }
+  }
+  const size_t n = pool->workers.size();
+  for (size_t i = 1; i < n; ++i) {
+    pool_worker *victim = pool->workers[(self + i) % n];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (!victim->tasks.empty()) {
+      task = victim->tasks.front();
+      victim->tasks.pop_front();
+      w->steals.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void worker_main(host_pool *pool, size_t self) {
+  pool_worker *w = pool->workers[self];
+  if (w->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+  //绑定之后再分配并写入暂存内存, 按首次访问原则页面分配在本线程所在的NUMA节点
+  if (pool->scratch_bytes > 0) {
+    w->scratch = std::malloc(pool->scratch_bytes);
+    if (w->scratch != nullptr) memset(w->scratch, 0, pool->scratch_bytes);
+  }
+
+  pool_task task;
+  while (true) {
+    if (!take_task(pool, self, task)) {
+      std::unique_lock<std::mutex> guard(pool->lock);
+      pool->wake.wait(guard, [pool] { return pool->stop.load() || pool->pending.load() > 0; });
+      if (pool->stop.load() && pool->pending.load() == 0) break;
+      continue;
+    }
+    pool->pending.fetch_sub(1);
+
+    const uint64_t start = now_ns();
+    (*task.job->fn)(task.begin, task.end, self);
+    w->busy_ns.fetch_add(now_ns() - start, std::memory_order_relaxed);
+    w->executed.fetch_add(1, std::memory_order_relaxed);
+
+    //job在调用者的栈上: 调用者只有在持锁看到finished后才会返回, 通知完成前job不会被销毁
+    if (task.job->remaining.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> guard(task.job->lock);
+      task.job->finished = true;
+      task.job->done.notify_all();
+    }
+  }
+  std::free(w->scratch);
+}
+
+host_pool *host_pool_create(size_t workers, size_t scratch_bytes, bool pin) {
+  //进程允许运行的CPU集合
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &set)) cpus.push_back(i);
+    }
+  }
+  if (workers == 0) workers = cpus.empty() ? 1 : cpus.size();
+
+  auto *pool = new host_pool;
+  pool->scratch_bytes = scratch_bytes;
+  pool->since = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < workers; ++i) {
+    auto *w = new pool_worker;
+    if (pin && !cpus.empty()) w->cpu = cpus[i % cpus.size()];
+    pool->workers.push_back(w);
+  }
+  for (size_t i = 0; i < workers; ++i) {
+    pool->workers[i]->thread = std::thread(worker_main, pool, i);
+  }
+  return pool;
+}
+
+void host_pool_destroy(host_pool *pool) {
+  if (pool == nullptr) return;
+  {
+    std::lock_guard<std::mutex> guard(pool->lock);
+    pool->stop.store(true);
+  }
+  pool->wake.notify_all();
+  for (pool_worker *w : pool->workers) {
+    w->thread.join();
+    delete w;
+  }
+  delete pool;
+}
+
+size_t host_pool_size(const host_pool *pool) { return pool->workers.size(); }
+
+void *host_pool_scratch(host_pool *pool, size_t worker) { return pool->workers[worker]->scratch; }
+
+void host_pool_parallel_for(host_pool *pool, size_t n, size_t chunk,
+                            const std::function<void(size_t, size_t, size_t)> &fn) {
+  if (n == 0) return;
+  if (chunk == 0) chunk = 1;
+  pool_job job;
+  job.fn = &fn;
+  job.remaining.store((n + chunk - 1) / chunk);
+
+  //先登记任务数再入队, 保证 pending 不会被提前减为负数
+  {
+    std::lock_guard<std::mutex> guard(pool->lock);
+    pool->pending.fetch_add(job.remaining.load());
+  }
+  //任务块轮流分发到各个线程的队列, 负载不均时由窃取来平衡
+  const size_t workers = pool->workers.size();
+  size_t target = pool->next.fetch_add(1) % workers;
+  for (size_t begin = 0; begin < n; begin += chunk) {
+    pool_worker *w = pool->workers[target];
+    {
+      std::lock_guard<std::mutex> guard(w->lock);
+      w->tasks.push_back({&job, begin, begin + chunk < n ? begin + chunk : n});
+    }
+    target = (target + 1) % workers;
+  }
+  pool->wake.notify_all();
+
+  std::unique_lock<std::mutex> guard(job.lock);
+  job.done.wait(guard, [&job] { return job.finished; });
+}
+
+std::vector<pool_worker_stats> host_pool_stats(host_pool *pool) {
+  const double wall = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - pool->since).count();
+  std::vector<pool_worker_stats> stats;
+  for (pool_worker *w : pool->workers) {
+    pool_worker_stats s;
+    s.cpu = w->cpu;
+    s.tasks = w->executed.load();
+    s.steals = w->steals.load();
+    s.busy_ns = w->busy_ns.load();
+    s.utilization = wall > 0 ? s.busy_ns / wall : 0.0;
+    stats.push_back(s);
+  }
+  return stats;
+}
+
+void host_pool_reset_stats(host_pool *pool) {
+  for (pool_worker *w : pool->workers) {
+    w->executed.store(0);
+    w->steals.store(0);
+    w->busy_ns.store(0);
+  }
+  pool->since = std::chrono::steady_clock::now();
+}
+
+void host_pool_print_stats(host_pool *pool, FILE *out) {
+  std::vector<pool_worker_stats> stats = host_pool_stats(pool);
+  fprintf(out, "线程  CPU  任务块  窃取  忙碌(ms)  利用率\n");
+  for (size_t i = 0; i < stats.size(); ++i) {
+    fprintf(out, "%4zu %4d %7lu %5lu %9.3f %6.1f%%\n", i, stats[i].cpu,
+            static_cast<unsigned long>(stats[i].tasks), static_cast<unsigned long>(stats[i].steals),
+            stats[i].busy_ns / 1e6, stats[i].utilization * 100);
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+/* 主机端工作窃取线程池
+ * 每个工作线程绑定到一个CPU核心, 拥有自己的任务双端队列和在绑定后分配的(NUMA本地)暂存内存。
+ * 工作线程优先从自己队列的尾部取任务, 空闲时从其他线程队列的头部窃取任务。          */
+
+struct host_pool;
+
+//单个工作线程的统计信息
+struct pool_worker_stats {
+  int cpu;             //绑定的CPU编号, 未绑定时为-1
+  uint64_t tasks;      //执行的任务块数
+  uint64_t steals;     //从其他线程窃取的任务块数
+  uint64_t busy_ns;    //执行任务的时间
+  double utilization;  //busy_ns 占统计区间的比例
+};
+
+/* 创建线程池
+ *   workers: 工作线程数, 0表示使用进程可用的全部CPU
+ *   scratch_bytes: 每个工作线程的暂存内存大小
+ *   pin: 是否把工作线程绑定到CPU核心 */
+host_pool *host_pool_create(size_t workers, size_t scratch_bytes, bool pin);
+
+void host_pool_destroy(host_pool *pool);
+
+size_t host_pool_size(const host_pool *pool);
+
+//工作线程 worker 的暂存内存, 只能在该线程执行的任务中使用
+void *host_pool_scratch(host_pool *pool, size_t worker);
+
+/* 把 [0, n) 按 chunk 大小切分后并行执行 fn(begin, end, worker), 全部完成后返回
+ * 可以从多个线程同时调用, 不能在任务内部嵌套调用 */
+void host_pool_parallel_for(host_pool *pool, size_t n, size_t chunk,
+                            const std::function<void(size_t, size_t, size_t)> &fn);
+
+//获取每个工作线程自上次重置以来的统计信息
+std::vector<pool_worker_stats> host_pool_stats(host_pool *pool);
+void host_pool_reset_stats(host_pool *pool);
+void host_pool_print_stats(host_pool *pool, FILE *out);
@@ -1,4 +1,20 @@
 #include "curve25519_donna.h"
+#include "curve25519_async.h"
+#include "curve25519_resident.h"
+#include "curve25519_host.h"
+#include "curve25519_stats.h"
+#include "curve25519_perf.h"
+#include "curve25519_trace.h"
+#include "curve25519_metrics.h"
+#include "curve25519_log.h"
+#include "curve25519_ed25519.h"
+#include "curve25519_box.h"
+#include "curve25519_aead.h"
+#include "curve25519_bulk.h"
+#include "curve25519_stream.h"
+#include "curve25519_session.h"
+#include "curve25519_keypool.h"
+#include "curve25519_tune.h"
 #include <iostream>
 
 //测试代码
@@ -13,6 +29,95 @@ int main(){
      return -1;
    }
 
-   test3();     //测试运行速度
-   return 0;
+   if(test4()==1){    //测试批量及异步接口
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test5()==1){    //测试常驻内核
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test6()==1){    //测试主机端引擎
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test7()==1){    //测试运算计数
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test8()==1){    //测试硬件性能计数器
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test9()==1){    //测试时间线追踪
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test10()==1){    //测试指标直方图
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test11()==1){    //测试异步日志
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test12()==1){    //测试Ed25519签名
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test13()==1){    //测试Ed25519批量验证
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test14()==1){    //测试批量认证加密
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test15()==1){    //测试ChaCha20-Poly1305批量数据通道
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test16()==1){    //测试大数据分块并行加解密
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test17()==1){    //测试流式加解密
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test18()==1){    //测试会话密钥缓存
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test19()==1){    //测试临时密钥对池
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test20()==1){    //测试自动调优
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   if(test21()==1){    //测试标量乘法与libsodium一致
+     std::cerr<<"椭圆曲线加密算法有误"<<std::endl;
+     return -1;
+   }
+
+   return 0;     //运行速度由curve25519_bench测量
 }
\ No newline at end of file
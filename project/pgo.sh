@@ -0,0 +1,90 @@
+#!/bin/bash
+
+# 基于剖析的优化(PGO)构建流程, 只用于普通版本:
+#   1. 以发布预设(LTO)构建未使用剖析数据的版本作为对照
+#   2. 构建插桩版本, 运行训练负载(curve25519_bench + 本机回环握手)收集剖析数据
+#   3. 合并剖析数据, 重新构建curve25519/Alice/Bob
+#   4. 在对照版本和PGO版本上各运行若干次curve25519_bench, 比较其JSON中每项的中位数并报告加速比
+#      (只比较基准测试自己计时的部分, 不含进程启动、JIT编译和握手中Bob的重试等待)
+# $1 训练和测量时负载的重复次数, 默认5次
+RUNS=${1:-5}
+PRESET=Linux-DPCplusplus-clang-release
+BASE=./build/build/$PRESET
+GEN=./build/build/$PRESET-pgo-gen
+USE=./build/build/$PRESET-pgo
+PGO_DIR=$(pwd)/build/pgo
+
+export PATH=$DPCPP_CPDIR/build/bin:$PATH
+export LD_LIBRARY_PATH=$DPCPP_CPDIR/build/lib:$LD_LIBRARY_PATH
+
+# 构建 $1 目录, 其余参数传给cmake配置
+build() {
+    local dir=$1
+    shift
+    cmake --preset $PRESET -B $dir -DCURVE25519_PGO_DIR=$PGO_DIR "$@" > /dev/null || exit 1
+    cmake --build $dir --target curve25519 curve25519_bench Alice Bob > /dev/null || exit 1
+}
+
+# 在 $1 构建目录上运行一轮负载
+workload() {
+    $1/deps/curve25519/curve25519_bench --quick > /dev/null 2>&1
+    $1/Bob/Bob 127.0.0.1 1000 > /dev/null &
+    $1/Alice/Alice > /dev/null
+    wait
+}
+
+# 运行 RUNS 轮训练负载
+train() {
+    for ((i = 0; i < RUNS; i++))
+    do
+        workload $1
+    done
+}
+
+# 在 $1 构建目录上运行 RUNS 次基准测试, 输出每项在各次运行中的中位数: "名称<TAB>中位数ns"
+measure() {
+    local out=$(mktemp -d)
+    for ((i = 0; i < RUNS; i++))
+    do
+        $1/deps/curve25519/curve25519_bench --quick --json $out/$i.json 2> /dev/null || exit 1
+    done
+    awk -F'"' '/"median_ns"/ {
+        match($0, /"median_ns": [0-9.]+/)
+        printf "%s\t%s\n", $4, substr($0, RSTART + 13, RLENGTH - 13)
+    }' $out/*.json | sort -t$'\t' -k1,1 -k2,2g | awk -F'\t' '
+        $1 != name { if (n) print name "\t" v[int((n + 1) / 2)]; name = $1; n = 0 }
+        { v[++n] = $2 }
+        END { if (n) print name "\t" v[int((n + 1) / 2)] }'
+    rm -rf $out
+}
+
+echo "构建对照版本"
+build $BASE -DCURVE25519_PGO=
+
+echo "构建插桩版本并收集剖析数据"
+rm -rf $PGO_DIR
+mkdir -p $PGO_DIR
+build $GEN -DCURVE25519_PGO=GEN
+train $GEN
+llvm-profdata merge -o $PGO_DIR/curve25519.profdata $PGO_DIR/*.profraw || exit 1
+
+echo "使用剖析数据重新构建"
+build $USE -DCURVE25519_PGO=USE
+
+# 先各运行一轮排除首次运行的缓存影响
+workload $BASE
+workload $USE
+M_BASE=$(mktemp)
+M_USE=$(mktemp)
+measure $BASE > $M_BASE
+measure $USE > $M_USE
+# 逐项报告, 汇总只统计本库的curve25519_*项(libsodium不参与PGO), 取几何平均
+awk -F'\t' '
+    NR == FNR { base[$1] = $2; next }
+    ($1 in base) && $2 > 0 {
+        printf "%-48s 对照 %12.0fns  PGO %12.0fns  加速比 %.3f\n", $1, base[$1], $2, base[$1] / $2
+        if ($1 ~ /^curve25519_/) { sum += log(base[$1] / $2); n++ }
+    }
+    END { if (n) printf "curve25519_*共%d项, 几何平均加速比: %.3f\n", n, exp(sum / n) }' $M_BASE $M_USE
+rm -f $M_BASE $M_USE
+exit 0
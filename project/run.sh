@@ -1,17 +1,18 @@
 
 # $1 传入的第一个参数,即使用./run.sh simple 或 ./run.sh cuda调用不同代码
+# 其余参数原样传给基准程序, 例如 ./run.sh simple --json result.json
 if [ "$1" == "simple" ]
 then
     echo "普通版本"
     export PATH=$DPCPP_CPDIR/build/bin:$PATH
     export LD_LIBRARY_PATH=$DPCPP_CPDIR/build/lib:$LD_LIBRARY_PATH
-    ./build/build/Linux-DPCplusplus-clang/MyProject
+    ./build/build/Linux-DPCplusplus-clang/MyProject "${@:2}"
 elif [ "$1" == "cuda" ]
 then
     echo "cuda版本"
     export PATH=$DPCPP_CUDA_CPDIR/build/bin:$PATH
     export LD_LIBRARY_PATH=$DPCPP_CUDA_CPDIR/build/lib:$LD_LIBRARY_PATH
-    ./build/build/Linux-DPCplusplus-clang-cuda/MyProject
+    ./build/build/Linux-DPCplusplus-clang-cuda/MyProject "${@:2}"
 else
     exit 1
 fi
@@ -1,45 +1,272 @@
 #include <sycl/sycl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
 
-int main() {
-  // Creating buffer of 4 elements to be used inside the kernel code
-  sycl::buffer<size_t, 1> Buffer(4);
-
-  // Creating SYCL queue
-  sycl::queue Queue;
-
-  // Size of index space for kernel
-  sycl::range<1> NumOfWorkItems{Buffer.size()};
-
-  // Submitting command group(work) to queue
-  Queue.submit([&](sycl::handler &cgh) {
-    // Getting write only access to the buffer on a device.
-    sycl::accessor Accessor{Buffer, cgh, sycl::write_only};
-    // Executing kernel
-    cgh.parallel_for<class FillBuffer>(
-        NumOfWorkItems, [=](sycl::id<1> WIid) {
-          // Fill buffer with indexes.
-          Accessor[WIid] = WIid.get(0);
-        });
+/* SYCL运行时开销基准, curve25519各引擎的设计取舍依赖这些数据
+ *   用法: MyProject [--json 文件] [--samples 次数] [--quick]
+ * 全部在CPU设备上测量:
+ *   1. 空内核提交+等待的延迟, 顺序队列与乱序队列, 以及16个相互依赖的内核组成的链
+ *   2. buffer与USM(device/shared/host)在不同数据量下的一次完整往返: 主机写入, 内核读写, 主机读回
+ *   3. host_accessor的同步开销, 与同样工作量的USM+wait对比
+ *   4. parallel_for的范围大小与吞吐量的关系
+ * 人类可读的结果写到stderr, JSON写到stdout或--json指定的文件。        */
+
+using namespace sycl;
+
+struct bench_result {
+  std::string group;
+  std::string name;
+  size_t size;              //数据量(字节)或工作项个数, 不适用时为0
+  size_t samples;
+  double median_ns, p99_ns, mean_ns, min_ns;
+  double throughput;        //GB/s或每秒工作项数, 不适用时为0
+};
+
+static std::vector<bench_result> results;
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//先预热再逐次计时, 结果按中位数报告
+static bench_result &run(const char *group, const std::string &name, size_t size, size_t samples,
+                         const std::function<void()> &op) {
+  for (size_t i = 0; i < std::max<size_t>(1, samples / 10); ++i) op();
+  std::vector<double> t(samples);
+  for (size_t i = 0; i < samples; ++i) {
+    const uint64_t begin = now_ns();
+    op();
+    t[i] = double(now_ns() - begin);
+  }
+  std::sort(t.begin(), t.end());
+  bench_result r;
+  r.group = group;
+  r.name = name;
+  r.size = size;
+  r.samples = samples;
+  r.min_ns = t.front();
+  r.median_ns = samples % 2 ? t[samples / 2] : (t[samples / 2 - 1] + t[samples / 2]) / 2;
+  r.p99_ns = t[std::min(samples - 1, size_t(std::ceil(samples * 0.99)) - 1)];
+  double sum = 0;
+  for (double x : t) sum += x;
+  r.mean_ns = sum / samples;
+  r.throughput = 0;
+  results.push_back(r);
+  return results.back();
+}
+
+static void print(const bench_result &r, const char *unit) {
+  fprintf(stderr, "%-14s %-28s %10zu %12.0f %12.0f %12.0f", r.group.c_str(), r.name.c_str(), r.size,
+          r.median_ns, r.p99_ns, r.mean_ns);
+  if (r.throughput > 0) fprintf(stderr, " %12.3g %s", r.throughput, unit);
+  fprintf(stderr, "\n");
+}
+
+//原示例的正确性检查: 用下标填充buffer后在主机端核对
+static bool check_fill(queue &q) {
+  buffer<size_t, 1> buf(4);
+  q.submit([&](handler &cgh) {
+    accessor acc{buf, cgh, write_only};
+    cgh.parallel_for(range<1>{buf.size()}, [=](id<1> i) { acc[i] = i.get(0); });
   });
+  host_accessor host{buf, read_only};
+  for (size_t i = 0; i < buf.size(); ++i) {
+    if (host[i] != i) {
+      fprintf(stderr, "元素%zu的结果有误, 期望%zu, 实际%zu\n", i, i, size_t(host[i]));
+      return false;
+    }
+  }
+  return true;
+}
 
-  // Getting read only access to the buffer on the host.
-  // Implicit barrier waiting for queue to complete the work.
-  sycl::host_accessor HostAccessor{Buffer, sycl::read_only};
-
-  // Check the results
-  bool MismatchFound = false;
-  for (size_t I = 0; I < Buffer.size(); ++I) {
-    if (HostAccessor[I] != I) {
-      std::cout << "The result is incorrect for element: " << I
-                << " , expected: " << I << " , got: " << HostAccessor[I]
-                << std::endl;
-      MismatchFound = true;
+//1. 空内核的提交+等待, 以及依赖链
+static void bench_launch(queue &ooo, queue &ino, size_t samples) {
+  const size_t chain = 16;
+  print(run("launch", "single_task+wait 乱序队列", 0, samples,
+            [&] { ooo.single_task([] {}).wait(); }), "");
+  print(run("launch", "single_task+wait 顺序队列", 0, samples,
+            [&] { ino.single_task([] {}).wait(); }), "");
+  //乱序队列需要显式依赖, 顺序队列由运行时按提交顺序串联; 结果为链上每个内核的平均耗时
+  bench_result &a = run("launch", "依赖链/16 乱序队列", chain, samples, [&] {
+    event e = ooo.single_task([] {});
+    for (size_t i = 1; i < chain; ++i) {
+      e = ooo.submit([&](handler &h) {
+        h.depends_on(e);
+        h.single_task([] {});
+      });
     }
+    e.wait();
+  });
+  a.median_ns /= chain, a.p99_ns /= chain, a.mean_ns /= chain, a.min_ns /= chain;
+  print(a, "");
+  bench_result &b = run("launch", "依赖链/16 顺序队列", chain, samples, [&] {
+    for (size_t i = 0; i < chain; ++i) ino.single_task([] {});
+    ino.wait();
+  });
+  b.median_ns /= chain, b.p99_ns /= chain, b.mean_ns /= chain, b.min_ns /= chain;
+  print(b, "");
+}
+
+//2. 一次完整往返: 主机写入输入, 内核 a[i] = a[i]*3+1, 主机读回并求和
+static void bench_transfer(queue &q, size_t samples, size_t max_bytes) {
+  for (size_t bytes = 4096; bytes <= max_bytes; bytes *= 16) {
+    const size_t n = bytes / sizeof(uint32_t);
+    const size_t s = std::max<size_t>(3, std::min(samples, samples * 65536 / bytes));
+    std::vector<uint32_t> host(n);
+    volatile uint64_t sink = 0;
+    auto host_read = [&](const uint32_t *p) {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < n; ++i) sum += p[i];
+      sink = sink + sum;
+    };
+
+    bench_result *r = &run("transfer", "buffer+host_accessor", bytes, s, [&] {
+      std::fill(host.begin(), host.end(), 1u);
+      buffer<uint32_t, 1> buf(host.data(), range<1>{n});
+      q.submit([&](handler &h) {
+        accessor a{buf, h, read_write};
+        h.parallel_for(range<1>{n}, [=](id<1> i) { a[i] = a[i] * 3 + 1; });
+      });
+      host_accessor back{buf, read_only};
+      host_read(&back[0]);
+    });
+    r->throughput = 2.0 * bytes / r->median_ns;
+    print(*r, "GB/s");
+
+    uint32_t *dev = malloc_device<uint32_t>(n, q);
+    r = &run("transfer", "usm_device+memcpy", bytes, s, [&] {
+      std::fill(host.begin(), host.end(), 1u);
+      event e = q.memcpy(dev, host.data(), bytes);
+      e = q.submit([&](handler &h) {
+        h.depends_on(e);
+        h.parallel_for(range<1>{n}, [=](id<1> i) { dev[i] = dev[i] * 3 + 1; });
+      });
+      q.submit([&](handler &h) {
+        h.depends_on(e);
+        h.memcpy(host.data(), dev, bytes);
+      }).wait();
+      host_read(host.data());
+    });
+    r->throughput = 2.0 * bytes / r->median_ns;
+    print(*r, "GB/s");
+    free(dev, q);
+
+    const char *names[] = {"usm_shared", "usm_host"};
+    for (int kind = 0; kind < 2; ++kind) {
+      uint32_t *p = kind == 0 ? malloc_shared<uint32_t>(n, q) : malloc_host<uint32_t>(n, q);
+      r = &run("transfer", names[kind], bytes, s, [&] {
+        std::fill(p, p + n, 1u);
+        q.parallel_for(range<1>{n}, [=](id<1> i) { p[i] = p[i] * 3 + 1; }).wait();
+        host_read(p);
+      });
+      r->throughput = 2.0 * bytes / r->median_ns;
+      print(*r, "GB/s");
+      free(p, q);
+    }
+  }
+}
+
+//3. host_accessor的同步开销
+static void bench_accessor(queue &q, size_t samples) {
+  buffer<uint32_t, 1> buf(range<1>{4});
+  {
+    host_accessor init{buf, write_only};
+    for (size_t i = 0; i < 4; ++i) init[i] = 0;
+  }
+  print(run("sync", "host_accessor(无待完成内核)", 0, samples, [&] {
+    host_accessor a{buf, read_only};
+    (void)a[0];
+  }), "");
+  print(run("sync", "内核+host_accessor", 0, samples, [&] {
+    q.submit([&](handler &h) {
+      accessor a{buf, h, read_write};
+      h.single_task([=] { a[0] += 1; });
+    });
+    host_accessor a{buf, read_only};
+    (void)a[0];
+  }), "");
+  //同样的工作量改用USM和event::wait, 差值即buffer依赖跟踪和访问器的开销
+  uint32_t *p = malloc_shared<uint32_t>(4, q);
+  print(run("sync", "内核+wait(USM)", 0, samples, [&] {
+    q.single_task([=] { p[0] += 1; }).wait();
+    (void)p[0];
+  }), "");
+  free(p, q);
+}
+
+//4. parallel_for的范围大小与吞吐量
+static void bench_range(queue &q, size_t samples, size_t max_items) {
+  uint32_t *out = malloc_device<uint32_t>(max_items, q);
+  for (size_t n = 1; n <= max_items; n *= 16) {
+    const size_t s = std::max<size_t>(3, std::min(samples, samples * 65536 / n));
+    bench_result &r = run("parallel_for", "range", n, s, [&] {
+      q.parallel_for(range<1>{n}, [=](id<1> i) {
+        const uint32_t x = static_cast<uint32_t>(i.get(0));
+        out[i] = x * x + 7;
+      }).wait();
+    });
+    r.throughput = n * 1e9 / r.median_ns;
+    print(r, "项/秒");
   }
+  free(out, q);
+}
 
-  if (!MismatchFound) {
-    std::cout << "The results are correct!" << std::endl;
+static void write_json(FILE *f, const queue &q) {
+  fprintf(f, "{\n  \"device\": \"%s\",\n  \"results\": [\n",
+          q.get_device().get_info<info::device::name>().c_str());
+  for (size_t i = 0; i < results.size(); ++i) {
+    const bench_result &r = results[i];
+    fprintf(f,
+            "    {\"group\": \"%s\", \"name\": \"%s\", \"size\": %zu, \"samples\": %zu, \"median_ns\": %.1f, "
+            "\"p99_ns\": %.1f, \"mean_ns\": %.1f, \"min_ns\": %.1f, \"throughput\": %.4g}%s\n",
+            r.group.c_str(), r.name.c_str(), r.size, r.samples, r.median_ns, r.p99_ns, r.mean_ns, r.min_ns,
+            r.throughput, i + 1 < results.size() ? "," : "");
   }
+  fprintf(f, "  ]\n}\n");
+}
 
-  return MismatchFound;
-}
\ No newline at end of file
+int main(int argc, char *argv[]) {
+  const char *json = nullptr;
+  size_t samples = 200;
+  bool quick = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--json" && i + 1 < argc) json = argv[++i];
+    else if (a == "--samples" && i + 1 < argc) samples = strtoul(argv[++i], nullptr, 10);
+    else if (a == "--quick") quick = true;
+    else {
+      fprintf(stderr, "用法: %s [--json 文件] [--samples 次数] [--quick]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (quick) samples = std::min<size_t>(samples, 10);
+  if (samples == 0) samples = 1;
+
+  //与curve25519引擎相同, 使用CPU设备
+  queue ooo{cpu_selector_v};
+  queue ino{cpu_selector_v, property::queue::in_order()};
+  if (!check_fill(ooo)) return 1;
+
+  fprintf(stderr, "%-14s %-28s %10s %12s %12s %12s %12s\n", "分组", "测试项", "规模", "中位数ns",
+          "p99 ns", "均值ns", "吞吐量");
+  bench_launch(ooo, ino, samples);
+  bench_transfer(ooo, samples, quick ? (1 << 16) : (1 << 24));
+  bench_accessor(ooo, samples);
+  bench_range(ooo, samples, quick ? (1 << 12) : (1 << 20));
+
+  FILE *f = stdout;
+  if (json != nullptr && (f = fopen(json, "w")) == nullptr) {
+    perror("fopen");
+    return -1;
+  }
+  write_json(f, ooo);
+  if (f != stdout) fclose(f);
+  return 0;
+}